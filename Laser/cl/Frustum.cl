@@ -0,0 +1,225 @@
+#ifndef FRUSTUM_CL
+#define FRUSTUM_CL
+
+#include "BVH.cl"
+#include "Bounds.cl"
+#include "Camera.cl"
+#include "Image.cl"
+
+// Most subtrees a work-group's camera rays start from, and most BVH levels
+// walked by the group before handing the remaining subtrees to the rays
+#define FRUSTUM_MAX_CANDIDATES 64
+#define FRUSTUM_MAX_DEPTH 16
+
+// Relative padding of the frustum for rounding in the rays' own directions
+__constant float FRUSTUM_PADDING = 0.0001f;
+
+// Bounds of the origins and inverse directions of every camera ray through a
+// rectangle of pixels. Directions are not normalized, which doesn't change
+// which boxes a ray hits.
+typedef struct Frustum
+{
+	float3 OriginMin;
+	float3 OriginMax;
+	float3 InvDirMin;
+	float3 InvDirMax;
+} Frustum;
+
+// Returns false if the rays' directions don't share signs, as the frustum
+// can't bound their inverse directions then
+bool calcPixelFrustum(__global ImageProps *image, __global CameraProps *camera,
+	uint xMin, uint xMax, uint yMin, uint yMax, Frustum *frustum)
+{
+	// Pixel samples lie in [x, x + 1) and lens samples in a disk of radius
+	// LensRadius spanned by u and v, as in generateCameraRay
+	float fxMin = (float)xMin / (float)(image->Width - 1);
+	float fxMax = (float)(xMax + 1) / (float)(image->Width - 1);
+	float fyMin = (float)yMin / (float)(image->Height - 1);
+	float fyMax = (float)(yMax + 1) / (float)(image->Height - 1);
+	float3 lens =
+		camera->LensRadius * (fabs(camera->u) + fabs(camera->v)) + 0.00001f;
+
+	float3 horizontalMin = fmin(fxMin * camera->ViewportHorizontal,
+		fxMax * camera->ViewportHorizontal);
+	float3 horizontalMax = fmax(fxMin * camera->ViewportHorizontal,
+		fxMax * camera->ViewportHorizontal);
+	float3 verticalMin = fmin(-fyMin * camera->ViewportVertical,
+		-fyMax * camera->ViewportVertical);
+	float3 verticalMax = fmax(-fyMin * camera->ViewportVertical,
+		-fyMax * camera->ViewportVertical);
+
+	float3 base = camera->UpperLeftCorner - camera->Position;
+	float3 dirMin = base + horizontalMin + verticalMin - lens;
+	float3 dirMax = base + horizontalMax + verticalMax + lens;
+	float3 padding = FRUSTUM_PADDING * (fabs(dirMin) + fabs(dirMax));
+	dirMin -= padding;
+	dirMax += padding;
+
+	for (int i = 0; i < 3; i++)
+		if (dirMin[i] <= 0.0f && dirMax[i] >= 0.0f)
+			return false;
+
+	frustum->OriginMin = camera->Position - lens;
+	frustum->OriginMax = camera->Position + lens;
+	frustum->InvDirMin = 1.0f / dirMax;
+	frustum->InvDirMax = 1.0f / dirMin;
+	return true;
+}
+
+// Conservative slab test, bounding the slab distances of all rays of the
+// frustum with interval arithmetic
+bool intersectFrustumBounds(Frustum *frustum, Bounds *bounds)
+{
+	float t0 = 0;
+	float t1 = INFINITY;
+
+	for (int i = 0; i < 3; i++)
+	{
+		float d[4] = {bounds->pMin[i] - frustum->OriginMax[i],
+			bounds->pMin[i] - frustum->OriginMin[i],
+			bounds->pMax[i] - frustum->OriginMax[i],
+			bounds->pMax[i] - frustum->OriginMin[i]};
+
+		float tNear = INFINITY;
+		float tFar = -INFINITY;
+		for (int j = 0; j < 4; j++)
+		{
+			float tMin = d[j] * frustum->InvDirMin[i];
+			float tMax = d[j] * frustum->InvDirMax[i];
+			tNear = fmin(tNear, fmin(tMin, tMax));
+			tFar = fmax(tFar, fmax(tMin, tMax));
+		}
+
+		t0 = fmax(t0, tNear);
+		t1 = fmin(t1, tFar);
+		if (t0 > t1)
+			return false;
+	}
+	return true;
+}
+
+// Walk the top of the BVH cooperatively against the frustum of the group's
+// pixels, a level at a time with one node per work item, and write the roots
+// of the subtrees its rays can hit to candidates. Every work item must call
+// this, and all get the same count. If the frustum isn't valid, the only
+// candidate is the root.
+uint cullBVHFrustum(Frustum *frustum, bool valid, __global BVHLinearNode *bvh,
+	__local uint *candidates, __local uint *frontier,
+	__local uint *frontierHits, __local uint *counts)
+{
+	const uint localID = get_local_id(0);
+	const uint localSize = get_local_size(0);
+
+	// counts[0] is the size of the frontier and counts[1] of the candidates
+	if (localID == 0)
+	{
+		frontier[0] = 0;
+		counts[0] = valid ? 1 : 0;
+		counts[1] = valid ? 0 : 1;
+		candidates[0] = 0;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	bool dirIsNeg[3] = {frustum->InvDirMax.x < 0, frustum->InvDirMax.y < 0,
+		frustum->InvDirMax.z < 0};
+
+	for (uint depth = 0; depth < FRUSTUM_MAX_DEPTH; depth++)
+	{
+		uint nFrontier = counts[0];
+		if (nFrontier == 0)
+			break;
+
+		for (uint i = localID; i < nFrontier; i += localSize)
+		{
+			BVHLinearNode node = bvh[frontier[i]];
+			frontierHits[i] = intersectFrustumBounds(frustum, &node.Bounds);
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		// One work item compacts the hit nodes in frontier order, so
+		// candidates keep a deterministic BVH order and renders don't depend
+		// on scheduling. That order isn't near to far, a far leaf can come
+		// before deeper nodes that are closer. Nodes are split while the
+		// frontier and candidates still fit.
+		if (localID == 0)
+		{
+			uint next[FRUSTUM_MAX_CANDIDATES];
+			uint nNext = 0;
+			uint nCandidates = counts[1];
+			for (uint i = 0; i < nFrontier; i++)
+			{
+				if (!frontierHits[i])
+					continue;
+
+				uint current = frontier[i];
+				BVHLinearNode node = bvh[current];
+				uint nPending = nCandidates + nNext + (nFrontier - i - 1);
+				if (node.nTriangles == 0 && depth + 1 < FRUSTUM_MAX_DEPTH &&
+					nPending + 2 <= FRUSTUM_MAX_CANDIDATES)
+				{
+					if (dirIsNeg[node.SplitAxis])
+					{
+						next[nNext++] = node.SecondChildOffset;
+						next[nNext++] = current + 1;
+					}
+					else
+					{
+						next[nNext++] = current + 1;
+						next[nNext++] = node.SecondChildOffset;
+					}
+				}
+				else
+					candidates[nCandidates++] = current;
+			}
+
+			for (uint i = 0; i < nNext; i++)
+				frontier[i] = next[i];
+			counts[0] = nNext;
+			counts[1] = nCandidates;
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+	return counts[1];
+}
+
+// Candidate subtrees of the camera rays of a work-group of the Laser kernel.
+// The rectangle bounding the group's pixels is found with local atomics, so
+// it holds for any mapping of work items to pixels.
+uint cullGroupFrustum(__global ImageProps *image, __global CameraProps *camera,
+	__global BVHLinearNode *bvh, uint x, uint y, __local uint *pixelBounds,
+	__local uint *candidates, __local uint *frontier,
+	__local uint *frontierHits, __local uint *counts)
+{
+	if (get_local_id(0) == 0)
+	{
+		pixelBounds[0] = UINT_MAX;
+		pixelBounds[1] = 0;
+		pixelBounds[2] = UINT_MAX;
+		pixelBounds[3] = 0;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// Work items past the edge of the image have no pixel to trace
+	if (x < image->Width && y < image->Height)
+	{
+		atomic_min(&pixelBounds[0], x);
+		atomic_max(&pixelBounds[1], x);
+		atomic_min(&pixelBounds[2], y);
+		atomic_max(&pixelBounds[3], y);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	uint xMin = pixelBounds[0];
+	uint xMax = pixelBounds[1];
+	uint yMin = pixelBounds[2];
+	uint yMax = pixelBounds[3];
+
+	Frustum frustum;
+	bool valid = xMin <= xMax && yMin <= yMax &&
+		calcPixelFrustum(image, camera, xMin, xMax, yMin, yMax, &frustum);
+
+	return cullBVHFrustum(&frustum, valid, bvh, candidates, frontier,
+		frontierHits, counts);
+}
+
+#endif // FRUSTUM_CL
@@ -1,16 +1,85 @@
-#ifndef IMAGE_CL
-#define IMAGE_CL
-
-typedef struct ImageProps
-{
-	uint Width;
-	uint Height;
-	float AspectRatio;
-	uint TileWidth;
-	uint TileHeight;
-	uint nRows;
-	uint nColumns;
-	int Dummy; // "Format" in host program
-} ImageProps;
-
-#endif // IMAGE_CL
+#ifndef IMAGE_CL
+#define IMAGE_CL
+
+typedef struct ImageProps
+{
+	uint Width;
+	uint Height;
+	float AspectRatio;
+	uint TileWidth;
+	uint TileHeight;
+	uint nRows;
+	uint nColumns;
+	int Dummy; // "Format" in host program
+} ImageProps;
+
+// Order of a tile's pixels over the work items rendering it
+#define PIXEL_MAPPING_ROWS 0
+#define PIXEL_MAPPING_BLOCKS 1
+#define PIXEL_MAPPING_MORTON 2
+
+// Width of the pixel blocks of PIXEL_MAPPING_BLOCKS
+#define PIXEL_BLOCK_WIDTH 8
+
+// Every other bit of x, from bit 0
+uint compactBits(uint x)
+{
+	x &= 0x55555555u;
+	x = (x | (x >> 1)) & 0x33333333u;
+	x = (x | (x >> 2)) & 0x0F0F0F0Fu;
+	x = (x | (x >> 4)) & 0x00FF00FFu;
+	x = (x | (x >> 8)) & 0x0000FFFFu;
+	return x;
+}
+
+// Position in its tile of the index-th pixel. Rows leave a work-group a thin
+// strip of pixels, while blocks give each work-group a 2D block of 8 pixel
+// wide rows and the Morton curve keeps every aligned power of two run of
+// pixels close to square. Tiles the mapping doesn't divide evenly use rows.
+void mapTilePixel(__global ImageProps *image, uint index, uint mapping,
+	uint *x, uint *y)
+{
+	uint width = image->TileWidth;
+	uint height = image->TileHeight;
+
+	if (mapping == PIXEL_MAPPING_BLOCKS)
+	{
+		uint blockSize = get_local_size(0);
+		uint blockHeight = blockSize / PIXEL_BLOCK_WIDTH;
+		if (blockSize % PIXEL_BLOCK_WIDTH == 0 &&
+			width % PIXEL_BLOCK_WIDTH == 0 && height % blockHeight == 0)
+		{
+			uint block = index / blockSize;
+			uint pixel = index % blockSize;
+			uint blocksPerRow = width / PIXEL_BLOCK_WIDTH;
+			*x = (block % blocksPerRow) * PIXEL_BLOCK_WIDTH +
+				pixel % PIXEL_BLOCK_WIDTH;
+			*y = (block / blocksPerRow) * blockHeight +
+				pixel / PIXEL_BLOCK_WIDTH;
+			return;
+		}
+	}
+	else if (mapping == PIXEL_MAPPING_MORTON)
+	{
+		// Power of two tiles are covered by squares of the smaller side, each
+		// along its own Morton curve
+		if ((width & (width - 1)) == 0 && (height & (height - 1)) == 0)
+		{
+			uint side = min(width, height);
+			uint square = index / (side * side);
+			uint pixel = index % (side * side);
+			*x = compactBits(pixel);
+			*y = compactBits(pixel >> 1);
+			if (width > height)
+				*x += square * side;
+			else
+				*y += square * side;
+			return;
+		}
+	}
+
+	*x = index % width;
+	*y = index / width;
+}
+
+#endif // IMAGE_CL
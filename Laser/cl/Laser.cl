@@ -1,19 +1,38 @@
 __constant float EPSILON = 0.00001f;
+__constant float SHADOW_EPSILON = 0.001f;
 __constant float PI = 3.14159265359f;
-__constant unsigned int SAMPLES = 64;
 __constant unsigned int MAX_DEPTH = 16;
 
+// Light selection for next event estimation: 0 = proportional to area,
+// 1 = proportional to power (alias table), 2 = light BVH (estimated
+// contribution at the shading point)
+__constant unsigned int LIGHT_SAMPLING = 2;
+
+// Spatiotemporal reservoir resampling (ReSTIR) of direct lighting
+__constant unsigned int RESTIR_CANDIDATES = 32;
+__constant unsigned int RESTIR_SPATIAL_SAMPLES = 5;
+__constant float RESTIR_SPATIAL_RADIUS = 30.0f; // Pixels
+__constant float RESTIR_MAX_HISTORY = 20.0f;	// Temporal M clamp
+__constant float RESTIR_NORMAL_THRESHOLD = 0.906f; // cos(25 degrees)
+__constant float RESTIR_DEPTH_THRESHOLD = 0.1f;
+
 #include "BVH.cl"
 #include "Camera.cl"
+#include "Frustum.cl"
 #include "Image.cl"
 #include "Intersection.cl"
+#include "Light.cl"
 #include "Material.cl"
 #include "Random.cl"
 #include "Ray.cl"
+#include "Reservoir.cl"
 #include "RenderStats.cl"
+#include "Sampler.cl"
+#include "Tonemap.cl"
 #include "Transform.cl"
 #include "Triangle.cl"
 #include "Vertex.cl"
+#include "Wavefront.cl"
 
 float3 traceDebug(Ray *primaryRay, __global Vertex *vertices,
 	__global Triangle *triangles, __global Material *materials,
@@ -55,91 +74,767 @@ float3 traceDebug(Ray *primaryRay, __global Vertex *vertices,
 float3 trace(Ray *primaryRay, __global Vertex *vertices,
 	__global Triangle *triangles, __global Material *materials,
 	__global mat4 *transforms, __global BVHLinearNode *bvh,
-	__global RenderStats *renderStats, uint *seed)
+	__global Light *lights, uint nLights, float totalLightArea,
+	__global LightBVHNode *lightBVH, __global LightAliasEntry *lightAliasTable,
+	__global uint *triangleLights, bool skipFirstEmission,
+	__local uint *primaryRoots, uint nPrimaryRoots,
+	__global RenderStats *renderStats, Sampler *sampler)
 {
 	float3 color = (float3)(0.0f, 0.0f, 0.0f);
 	float3 mask = (float3)(1.0f, 1.0f, 1.0f);
 
+	// Previous diffuse vertex and pdf of its bounce for weighting emission
+	// found by BSDF sampling against light sampling
+	float3 prevP = (float3)(0.0f, 0.0f, 0.0f);
+	float3 prevN = (float3)(0.0f, 0.0f, 0.0f);
+	float bsdfPdf = 0.0f;
+	bool specularBounce = true;
+
 	// Create local copy of primary ray for this sample as it will be modified
 	// at each depth level
 	Ray ray = *primaryRay;
 
 	for (int depth = 0; depth < MAX_DEPTH; depth++)
 	{
-		// Adjust seed for ray depth
-		*seed += depth;
-
 		float t = INFINITY;
 		float3 n;
 		Intersection isect;
 
-		if (!intersectBVH(&ray, vertices, triangles, materials, transforms, bvh,
-				&t, &n, &isect, renderStats))
-			// Return background color
-			return (float3)(0.2f, 0.2f, 0.2f);
+		// Camera rays may start from the subtrees found by their work-group,
+		// none of which might be hit
+		bool hit = depth == 0 && primaryRoots != 0
+			? intersectBVHRoots(&ray, vertices, triangles, materials,
+				  transforms, bvh, primaryRoots, nPrimaryRoots, &t, &n, &isect,
+				  renderStats)
+			: intersectBVH(&ray, vertices, triangles, materials, transforms,
+				  bvh, &t, &n, &isect, renderStats);
+		if (!hit)
+		{
+			// Add background color
+			color += mask * (float3)(0.2f, 0.2f, 0.2f);
+			break;
+		}
 
 		// Local copy of material
 		Material material = materials[triangles[isect.TriangleIndex].Material];
 
+		// Accumulate emission, weighted with MIS if the light could also have
+		// been reached by light sampling from the previous vertex
+		uint lightIndex = triangleLights[isect.TriangleIndex];
+		if (depth == 0 && skipFirstEmission)
+		{
+			// Direct lighting of the previous vertex was computed by the
+			// caller
+		}
+		else if (specularBounce || lightIndex == NO_LIGHT)
+			color += mask * material.Emission;
+		else
+		{
+			float cosLight = fabs(dot(isect.N, ray.dir));
+			if (cosLight > 0.0f)
+			{
+				float pmf = calcLightSelectionPmf(prevP, prevN, lightIndex,
+					lights, totalLightArea, lightBVH, lightAliasTable);
+				float lightPdf =
+					calcLightPdf(pmf, lights[lightIndex].Area, t * t, cosLight);
+				color += mask * material.Emission *
+					powerHeuristic(bsdfPdf, lightPdf);
+			}
+		}
+
+		startBounceDimensions(sampler, depth, SAMPLE_DIMENSION_BSDF);
 		bounceRay(&ray, &isect, vertices, triangles, &material, transforms,
-			seed);
+			sampler);
+
+		specularBounce = material.IsTransparent || material.IsMetal;
+		if (!specularBounce)
+		{
+			// Next event estimation
+			startBounceDimensions(sampler, depth, SAMPLE_DIMENSION_LIGHT);
+			color += mask *
+				sampleDirectLight(&isect, &material, vertices, triangles,
+					materials, transforms, bvh, lights, nLights,
+					totalLightArea, lightBVH, lightAliasTable, renderStats,
+					sampler);
 
-		// Accumulate color
-		color += mask * material.Emission;
+			// Cosine-weighted importance sampling for diffuse cancels the
+			// cosine term and 1/PI of the BSDF, leaving only albedo
+			bsdfPdf = dot(ray.dir, isect.N) / PI;
+			prevP = isect.P;
+			prevN = isect.N;
+		}
 		mask *= material.Albedo;
+	}
+	return color;
+}
 
-		// Cosine-weighted importance sampling for diffuse
-		if (!material.IsTransparent && !material.IsMetal)
-			mask *= dot(ray.dir, isect.N);
+// Primary ray through a jittered point in the pixel and a point on the lens
+Ray generateCameraRay(__global ImageProps *image, __global CameraProps *camera,
+	unsigned int x, unsigned int y, Sampler *sampler)
+{
+	setSampleDimension(sampler, SAMPLE_DIMENSION_PIXEL);
+	float2 pixelSample = sample2D(sampler);
+	float fx = ((float)x + pixelSample.x) / (float)(image->Width - 1);
+	float fy = ((float)y + pixelSample.y) / (float)(image->Height - 1);
+
+	setSampleDimension(sampler, SAMPLE_DIMENSION_LENS);
+	return generateRay(camera, fx, fy, sample2D(sampler));
+}
+
+// Add nSamples samples of a pixel, starting at sampleOffset, to color. Camera
+// rays are traced from the subtrees in primaryRoots unless it is null.
+float3 samplePixel(float3 color, unsigned int x, unsigned int y,
+	__global ImageProps *image, __global CameraProps *camera,
+	__global Vertex *vertices, __global Triangle *triangles,
+	__global Material *materials, __global mat4 *transforms,
+	__global BVHLinearNode *bvh, __global Light *lights, unsigned int nLights,
+	float totalLightArea, __global LightBVHNode *lightBVH,
+	__global LightAliasEntry *lightAliasTable, __global uint *triangleLights,
+	__global RenderStats *renderStats, __global float *blueNoise,
+	unsigned int samplerType, unsigned int nSamples, unsigned int sampleOffset,
+	__local uint *primaryRoots, uint nPrimaryRoots)
+{
+	for (unsigned int i = 0; i < nSamples; i++)
+	{
+		Sampler sampler;
+		initSampler(&sampler, samplerType, x, y, image->Width,
+			sampleOffset + i, blueNoise);
+
+		// Generate primary ray
+		// atomic_inc(&(renderStats->n_PrimaryRays));
+		Ray primaryRay = generateCameraRay(image, camera, x, y, &sampler);
+
+		color += trace(&primaryRay, vertices, triangles, materials, transforms,
+			bvh, lights, nLights, totalLightArea, lightBVH, lightAliasTable,
+			triangleLights, false, primaryRoots, nPrimaryRoots, renderStats,
+			&sampler);
 	}
 	return color;
 }
 
+// Add samples of a pixel to its running sum and return the pixel's average
+float3 renderPixel(unsigned int x, unsigned int y, __global ImageProps *image,
+	__global CameraProps *camera, __global Vertex *vertices,
+	__global Triangle *triangles, __global Material *materials,
+	__global mat4 *transforms, __global BVHLinearNode *bvh,
+	__global Light *lights, unsigned int nLights, float totalLightArea,
+	__global LightBVHNode *lightBVH, __global LightAliasEntry *lightAliasTable,
+	__global uint *triangleLights, __global RenderStats *renderStats,
+	__global float *blueNoise, unsigned int samplerType, unsigned int nSamples,
+	unsigned int sampleOffset, unsigned int nAccumulatedSamples,
+	__global float3 *accumulation, unsigned int pixel,
+	__local uint *primaryRoots, uint nPrimaryRoots)
+{
+	// Continue the running sum of previous passes, adding samples in the same
+	// order as a single pass so split renders are bit-identical
+	float3 color = nAccumulatedSamples > 0 ? accumulation[pixel]
+										   : (float3)(0.0f, 0.0f, 0.0f);
+
+	color = samplePixel(color, x, y, image, camera, vertices, triangles,
+		materials, transforms, bvh, lights, nLights, totalLightArea, lightBVH,
+		lightAliasTable, triangleLights, renderStats, blueNoise, samplerType,
+		nSamples, sampleOffset, primaryRoots, nPrimaryRoots);
+
+	accumulation[pixel] = color;
+	return color * (1.0f / (nAccumulatedSamples + nSamples));
+}
+
 __kernel void Laser(__global float3 *output, __global ImageProps *image,
 	__global CameraProps *camera, __global Vertex *vertices,
 	__global Triangle *triangles, __global Material *materials,
 	__global mat4 *transforms, __global BVHLinearNode *bvh,
-	__global RenderStats *renderStats, unsigned int xOffset,
-	unsigned int yOffset)
+	__global Light *lights, unsigned int nLights, float totalLightArea,
+	__global LightBVHNode *lightBVH, __global LightAliasEntry *lightAliasTable,
+	__global uint *triangleLights, __global RenderStats *renderStats,
+	__global float *blueNoise, unsigned int samplerType, unsigned int xOffset,
+	unsigned int yOffset, unsigned int nSamples, unsigned int sampleOffset,
+	unsigned int nAccumulatedSamples, __global float3 *accumulation,
+	unsigned int frustumPrimaryRays, unsigned int pixelMapping,
+	unsigned int itemsPerPixel, __local float3 *samplePartials,
+	unsigned int tileAccumulation)
 {
-	// Calculate pixel coordinates
+	// Calculate pixel coordinates. When the tile has too few pixels to fill
+	// the device, itemsPerPixel consecutive work items share each pixel.
 	const unsigned int workItemID = get_global_id(0);
-	unsigned int x = xOffset + (workItemID % image->TileWidth);
-	unsigned int y = yOffset + (workItemID / image->TileWidth);
+	const unsigned int pixelID = workItemID / itemsPerPixel;
+	const unsigned int part = workItemID % itemsPerPixel;
+	unsigned int tileX, tileY;
+	mapTilePixel(image, pixelID, pixelMapping, &tileX, &tileY);
+	unsigned int x = xOffset + tileX;
+	unsigned int y = yOffset + tileY;
+
+	// Optionally walk the top of the BVH once for the camera rays of the whole
+	// group, before any work item leaves
+	__local uint frustumCandidates[FRUSTUM_MAX_CANDIDATES];
+	__local uint frustumFrontier[FRUSTUM_MAX_CANDIDATES];
+	__local uint frustumHits[FRUSTUM_MAX_CANDIDATES];
+	__local uint frustumCounts[2];
+	__local uint frustumPixels[4];
+	uint nFrustumCandidates = 0;
+	if (frustumPrimaryRays)
+		nFrustumCandidates = cullGroupFrustum(image, camera, bvh, x, y,
+			frustumPixels, frustumCandidates, frustumFrontier, frustumHits,
+			frustumCounts);
 
 	// Don't trace ray if pixel is not in image bounds
 	// This happens in right column and bottom row of tiles
-	if (x >= image->Width || y >= image->Height)
-		return;
-
-	// Initial value of RNG seed
-	uint seed = x + y * image->Width;
+	bool inImage = x < image->Width && y < image->Height;
+	__local uint *primaryRoots = frustumPrimaryRays ? frustumCandidates : 0;
 
 	// START DEBUG
-	// float fx = ((float)x + randomFloat(&seed)) / (float)(image->Width - 1);
-	// float fy = ((float)y + randomFloat(&seed)) / (float)(image->Height - 1);
-	// Ray primaryRay = generateRay(camera, fx, fy);
+	// float fx = ((float)x + 0.5f) / (float)(image->Width - 1);
+	// float fy = ((float)y + 0.5f) / (float)(image->Height - 1);
+	// Ray primaryRay = generateRay(camera, fx, fy, (float2)(0.5f, 0.5f));
 	// output[workItemID] = traceDebug(&primaryRay, vertices, triangles,
 	// materials, transforms, bvh, renderStats); return;
 	// END DEBUG
 
+	// Output is in row order whatever the pixel mapping. Streamed renders
+	// keep the running sums of only the tile being rendered.
+	unsigned int outputIndex = tileX + tileY * image->TileWidth;
+	unsigned int pixel = tileAccumulation ? outputIndex : x + y * image->Width;
+	if (itemsPerPixel == 1)
+	{
+		if (!inImage)
+			return;
+
+		output[outputIndex] = renderPixel(x, y, image, camera, vertices,
+			triangles, materials, transforms, bvh, lights, nLights,
+			totalLightArea, lightBVH, lightAliasTable, triangleLights,
+			renderStats, blueNoise, samplerType, nSamples, sampleOffset,
+			nAccumulatedSamples, accumulation, pixel, primaryRoots,
+			nFrustumCandidates);
+		return;
+	}
+
+	// Each work item of a pixel sums a contiguous range of its samples, then
+	// the first adds the ranges in order to the running sum. Items of a pixel
+	// are in the same work-group, as itemsPerPixel divides the group size.
+	unsigned int first = nSamples * part / itemsPerPixel;
+	unsigned int end = nSamples * (part + 1) / itemsPerPixel;
+	float3 partial = (float3)(0.0f, 0.0f, 0.0f);
+	if (inImage)
+		partial = samplePixel(partial, x, y, image, camera, vertices, triangles,
+			materials, transforms, bvh, lights, nLights, totalLightArea,
+			lightBVH, lightAliasTable, triangleLights, renderStats, blueNoise,
+			samplerType, end - first, sampleOffset + first, primaryRoots,
+			nFrustumCandidates);
+	samplePartials[get_local_id(0)] = partial;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (!inImage || part != 0)
+		return;
+
+	float3 color = nAccumulatedSamples > 0 ? accumulation[pixel]
+										   : (float3)(0.0f, 0.0f, 0.0f);
+	for (unsigned int i = 0; i < itemsPerPixel; i++)
+		color += samplePartials[get_local_id(0) + i];
+
+	accumulation[pixel] = color;
+	output[outputIndex] = color * (1.0f / (nAccumulatedSamples + nSamples));
+}
+
+// Persistent-threads variant of Laser: launch only enough work-groups to fill
+// the device, each taking tiles from a global counter until none are left,
+// which avoids a launch per tile and idle groups behind slow tiles
+__kernel void LaserPersistent(__global ImageProps *image,
+	__global CameraProps *camera, __global Vertex *vertices,
+	__global Triangle *triangles, __global Material *materials,
+	__global mat4 *transforms, __global BVHLinearNode *bvh,
+	__global Light *lights, unsigned int nLights, float totalLightArea,
+	__global LightBVHNode *lightBVH, __global LightAliasEntry *lightAliasTable,
+	__global uint *triangleLights, __global RenderStats *renderStats,
+	__global float *blueNoise, unsigned int samplerType, unsigned int nSamples,
+	unsigned int sampleOffset, unsigned int nAccumulatedSamples,
+	__global float3 *accumulation, __global uint *tileCounter,
+	unsigned int pixelMapping)
+{
+	__local uint tile;
+	const unsigned int nTiles = image->nRows * image->nColumns;
+	const unsigned int tilePixels = image->TileWidth * image->TileHeight;
+
+	while (true)
+	{
+		// One work item takes the next tile for the whole group
+		if (get_local_id(0) == 0)
+			tile = atomic_inc(tileCounter);
+		barrier(CLK_LOCAL_MEM_FENCE);
+		unsigned int currentTile = tile;
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		if (currentTile >= nTiles)
+			return;
+
+		unsigned int xOffset = (currentTile % image->nRows) * image->TileWidth;
+		unsigned int yOffset =
+			(currentTile / image->nRows) * image->TileHeight;
+
+		for (unsigned int i = get_local_id(0); i < tilePixels;
+			 i += get_local_size(0))
+		{
+			unsigned int tileX, tileY;
+			mapTilePixel(image, i, pixelMapping, &tileX, &tileY);
+			unsigned int x = xOffset + tileX;
+			unsigned int y = yOffset + tileY;
+			if (x >= image->Width || y >= image->Height)
+				continue;
+
+			renderPixel(x, y, image, camera, vertices, triangles, materials,
+				transforms, bvh, lights, nLights, totalLightArea, lightBVH,
+				lightAliasTable, triangleLights, renderStats, blueNoise,
+				samplerType, nSamples, sampleOffset, nAccumulatedSamples,
+				accumulation, x + y * image->Width, 0, 0);
+		}
+	}
+}
+
+// ReSTIR pass 1: generate primary hits and initial light candidates, then
+// reuse the previous frame's reservoir at the same pixel
+__kernel void restirCandidates(__global ImageProps *image,
+	__global CameraProps *camera, __global Vertex *vertices,
+	__global Triangle *triangles, __global Material *materials,
+	__global mat4 *transforms, __global BVHLinearNode *bvh,
+	__global Light *lights, unsigned int nLights, float totalLightArea,
+	__global LightBVHNode *lightBVH, __global LightAliasEntry *lightAliasTable,
+	__global uint *triangleLights, __global RenderStats *renderStats,
+	__global float *blueNoise, unsigned int samplerType,
+	__global ReservoirSurface *surfaces, __global Reservoir *reservoirs,
+	__global Reservoir *previousReservoirs, unsigned int frame)
+{
+	const unsigned int pixel = get_global_id(0);
+	if (pixel >= image->Width * image->Height)
+		return;
+	unsigned int x = pixel % image->Width;
+	unsigned int y = pixel / image->Width;
+
+	// RNG seed distinct for each pixel, frame and pass, used for resampling
+	uint seed = PCGHash(pixel + PCGHash(frame * 3 + 0));
+
+	// Primary ray and its bounce use the sampler so they match the shading
+	// pass, which generates the same sample for the frame
+	Sampler sampler;
+	initSampler(&sampler, samplerType, x, y, image->Width, frame, blueNoise);
+	Ray ray = generateCameraRay(image, camera, x, y, &sampler);
+
+	ReservoirSurface surface;
+	surface.IsValid = false;
+	Reservoir r;
+	initReservoir(&r);
+
+	float t = INFINITY;
+	float3 n;
+	Intersection isect;
+	if (intersectBVH(&ray, vertices, triangles, materials, transforms, bvh, &t,
+			&n, &isect, renderStats))
+	{
+		uint materialIndex = triangles[isect.TriangleIndex].Material;
+		Material material = materials[materialIndex];
+		if (!material.IsTransparent && !material.IsMetal)
+		{
+			// Compute shading normal, the bounced ray itself is not used
+			Ray bounced = ray;
+			startBounceDimensions(&sampler, 0, SAMPLE_DIMENSION_BSDF);
+			bounceRay(&bounced, &isect, vertices, triangles, &material,
+				transforms, &sampler);
+
+			surface.P = isect.P;
+			surface.N = isect.N;
+			surface.Material = materialIndex;
+			surface.Depth = t;
+			surface.IsValid = true;
+		}
+	}
+
+	if (surface.IsValid)
+	{
+		// Resample initial candidates from the light sampling strategy
+		for (int i = 0; i < RESTIR_CANDIDATES; i++)
+		{
+			uint lightIndex;
+			float pmf;
+			if (!chooseLight(surface.P, surface.N, randomFloat(&seed), lights,
+					nLights, totalLightArea, lightBVH, lightAliasTable,
+					&lightIndex, &pmf))
+			{
+				r.M += 1.0f;
+				continue;
+			}
+
+			float3 v0, v1, v2;
+			getTriangleVertices(vertices, triangles, transforms,
+				lights[lightIndex].TriangleIndex, &v0, &v1, &v2);
+			float3 lightPoint = samplePointOnTriangle(v0, v1, v2,
+				randomFloat(&seed), randomFloat(&seed));
+			float3 lightNormal = normalize(cross(v1 - v0, v2 - v0));
+
+			// Source pdf is in area measure, as is the target function
+			float sourcePdf = pmf / lights[lightIndex].Area;
+			float targetPdf = calcTargetPdf(&surface, materials, triangles,
+				lights, lightPoint, lightNormal, lightIndex);
+			updateReservoir(&r, lightPoint, lightNormal, lightIndex,
+				targetPdf / sourcePdf, 1.0f, &seed);
+		}
+		finalizeReservoir(&r, &surface, materials, triangles, lights);
+
+		// Don't reuse occluded samples
+		if (r.W > 0.0f &&
+			!isReservoirSampleVisible(&surface, &r, vertices, triangles,
+				transforms, bvh, renderStats))
+			r.W = 0.0f;
+
+		// Temporal reuse, clamping history to limit correlation
+		if (frame > 0)
+		{
+			Reservoir previous = previousReservoirs[pixel];
+			float previousM = min(previous.M, RESTIR_MAX_HISTORY * r.M);
+
+			Reservoir temporal;
+			initReservoir(&temporal);
+			combineReservoir(&temporal, &r, r.M, &surface, materials,
+				triangles, lights, &seed);
+			combineReservoir(&temporal, &previous, previousM, &surface,
+				materials, triangles, lights, &seed);
+			finalizeReservoir(&temporal, &surface, materials, triangles,
+				lights);
+			r = temporal;
+		}
+	}
+
+	surfaces[pixel] = surface;
+	reservoirs[pixel] = r;
+}
+
+// ReSTIR pass 2: reuse reservoirs of neighbouring pixels with similar surfaces
+__kernel void restirSpatial(__global ImageProps *image,
+	__global CameraProps *camera, __global Vertex *vertices,
+	__global Triangle *triangles, __global Material *materials,
+	__global mat4 *transforms, __global BVHLinearNode *bvh,
+	__global Light *lights, unsigned int nLights, float totalLightArea,
+	__global LightBVHNode *lightBVH, __global LightAliasEntry *lightAliasTable,
+	__global uint *triangleLights, __global RenderStats *renderStats,
+	__global float *blueNoise, unsigned int samplerType,
+	__global ReservoirSurface *surfaces, __global Reservoir *reservoirs,
+	__global Reservoir *spatialReservoirs, unsigned int frame)
+{
+	const unsigned int pixel = get_global_id(0);
+	if (pixel >= image->Width * image->Height)
+		return;
+	int x = pixel % image->Width;
+	int y = pixel / image->Width;
+
+	uint seed = PCGHash(pixel + PCGHash(frame * 3 + 1));
+
+	ReservoirSurface surface = surfaces[pixel];
+	Reservoir r = reservoirs[pixel];
+	if (!surface.IsValid)
+	{
+		spatialReservoirs[pixel] = r;
+		return;
+	}
+
+	Reservoir spatial;
+	initReservoir(&spatial);
+	combineReservoir(&spatial, &r, r.M, &surface, materials, triangles, lights,
+		&seed);
+
+	for (int i = 0; i < RESTIR_SPATIAL_SAMPLES; i++)
+	{
+		// Random neighbour in a disk around the pixel
+		float angle = 2.0f * PI * randomFloat(&seed);
+		float radius = RESTIR_SPATIAL_RADIUS * sqrt(randomFloat(&seed));
+		int nx = x + (int)(radius * cos(angle));
+		int ny = y + (int)(radius * sin(angle));
+		if (nx < 0 || ny < 0 || nx >= (int)image->Width ||
+			ny >= (int)image->Height)
+			continue;
+
+		uint neighbour = nx + ny * image->Width;
+		if (neighbour == pixel)
+			continue;
+
+		// Only reuse from geometrically similar surfaces
+		ReservoirSurface neighbourSurface = surfaces[neighbour];
+		if (!neighbourSurface.IsValid ||
+			dot(neighbourSurface.N, surface.N) < RESTIR_NORMAL_THRESHOLD ||
+			fabs(neighbourSurface.Depth - surface.Depth) >
+				RESTIR_DEPTH_THRESHOLD * surface.Depth)
+			continue;
+
+		Reservoir neighbourReservoir = reservoirs[neighbour];
+		combineReservoir(&spatial, &neighbourReservoir, neighbourReservoir.M,
+			&surface, materials, triangles, lights, &seed);
+	}
+	finalizeReservoir(&spatial, &surface, materials, triangles, lights);
+
+	spatialReservoirs[pixel] = spatial;
+}
+
+// ReSTIR pass 3: shade with the resampled light sample, continue the path for
+// indirect lighting and accumulate
+__kernel void restirShade(__global ImageProps *image,
+	__global CameraProps *camera, __global Vertex *vertices,
+	__global Triangle *triangles, __global Material *materials,
+	__global mat4 *transforms, __global BVHLinearNode *bvh,
+	__global Light *lights, unsigned int nLights, float totalLightArea,
+	__global LightBVHNode *lightBVH, __global LightAliasEntry *lightAliasTable,
+	__global uint *triangleLights, __global RenderStats *renderStats,
+	__global float *blueNoise, unsigned int samplerType,
+	__global ReservoirSurface *surfaces, __global Reservoir *reservoirs,
+	__global float3 *accumulation, unsigned int frame)
+{
+	const unsigned int pixel = get_global_id(0);
+	if (pixel >= image->Width * image->Height)
+		return;
+	unsigned int x = pixel % image->Width;
+	unsigned int y = pixel / image->Width;
+
+	Sampler sampler;
+	initSampler(&sampler, samplerType, x, y, image->Width, frame, blueNoise);
+
+	ReservoirSurface surface = surfaces[pixel];
 	float3 color = (float3)(0.0f, 0.0f, 0.0f);
-	float invSamples = 1.0f / SAMPLES;
 
-	for (int i = 0; i < SAMPLES; i++)
+	// No diffuse primary hit, path trace as usual
+	if (!surface.IsValid)
 	{
-		// Adjust seed for sample number
-		seed *= (i + 1);
+		Ray primaryRay = generateCameraRay(image, camera, x, y, &sampler);
+		color = trace(&primaryRay, vertices, triangles, materials, transforms,
+			bvh, lights, nLights, totalLightArea, lightBVH, lightAliasTable,
+			triangleLights, false, 0, 0, renderStats, &sampler);
+	}
+	else
+	{
+		Material material = materials[surface.Material];
+		Reservoir r = reservoirs[pixel];
 
-		float fx = ((float)x + randomFloat(&seed)) / (float)(image->Width - 1);
-		float fy = ((float)y + randomFloat(&seed)) / (float)(image->Height - 1);
+		// Emission seen directly and resampled direct lighting
+		color = material.Emission;
+		if (r.W > 0.0f &&
+			isReservoirSampleVisible(&surface, &r, vertices, triangles,
+				transforms, bvh, renderStats))
+			color += r.W *
+				calcUnshadowedContribution(&surface, materials, triangles,
+					lights, r.LightPoint, r.LightNormal, r.LightIndex);
 
-		// Generate primary ray
-		// atomic_inc(&(renderStats->n_PrimaryRays));
-		Ray primaryRay = generateRay(camera, fx, fy, &seed);
+		// Indirect lighting, skipping emission at the next vertex which was
+		// accounted for by direct lighting
+		Intersection isect;
+		isect.P = surface.P;
+		isect.N = surface.N;
+		Ray ray;
+		startBounceDimensions(&sampler, 0, SAMPLE_DIMENSION_BSDF);
+		reflectDiffuse(&ray, &isect, sample2D(&sampler));
 
-		color += trace(&primaryRay, vertices, triangles, materials, transforms,
-			bvh, renderStats, &seed);
+		// Continue the path's dimensions from the second bounce
+		sampler.FirstBounce = 1;
+		color += material.Albedo *
+			trace(&ray, vertices, triangles, materials, transforms, bvh,
+				lights, nLights, totalLightArea, lightBVH, lightAliasTable,
+				triangleLights, true, 0, 0, renderStats, &sampler);
 	}
-	output[workItemID] = color * invSamples;
+
+	if (frame == 0)
+		accumulation[pixel] = color;
+	else
+		accumulation[pixel] += color;
+}
+
+// Wavefront pass 1: start a path at every pixel for one sample index
+__kernel void wavefrontGenerate(__global ImageProps *image,
+	__global CameraProps *camera, __global Vertex *vertices,
+	__global Triangle *triangles, __global Material *materials,
+	__global mat4 *transforms, __global BVHLinearNode *bvh,
+	__global Light *lights, unsigned int nLights, float totalLightArea,
+	__global LightBVHNode *lightBVH, __global LightAliasEntry *lightAliasTable,
+	__global uint *triangleLights, __global RenderStats *renderStats,
+	__global float *blueNoise, unsigned int samplerType,
+	__global PathState *paths, __global uint *rayQueue,
+	unsigned int sampleIndex)
+{
+	const unsigned int pixel = get_global_id(0);
+	if (pixel >= image->Width * image->Height)
+		return;
+	unsigned int x = pixel % image->Width;
+	unsigned int y = pixel / image->Width;
+
+	Sampler sampler;
+	initSampler(&sampler, samplerType, x, y, image->Width, sampleIndex,
+		blueNoise);
+
+	PathState path;
+	path.Ray = generateCameraRay(image, camera, x, y, &sampler);
+	path.Throughput = (float3)(1.0f, 1.0f, 1.0f);
+	path.Radiance = (float3)(0.0f, 0.0f, 0.0f);
+	path.PrevP = (float3)(0.0f, 0.0f, 0.0f);
+	path.PrevN = (float3)(0.0f, 0.0f, 0.0f);
+	path.BsdfPdf = 0.0f;
+	path.Depth = 0;
+	path.SpecularBounce = true;
+
+	paths[pixel] = path;
+	rayQueue[pixel] = pixel;
+}
+
+// Wavefront pass 2: find closest hits of queued rays and sort paths into
+// queues by material so each shading launch runs a single branch
+__kernel void wavefrontExtend(__global ImageProps *image,
+	__global CameraProps *camera, __global Vertex *vertices,
+	__global Triangle *triangles, __global Material *materials,
+	__global mat4 *transforms, __global BVHLinearNode *bvh,
+	__global Light *lights, unsigned int nLights, float totalLightArea,
+	__global LightBVHNode *lightBVH, __global LightAliasEntry *lightAliasTable,
+	__global uint *triangleLights, __global RenderStats *renderStats,
+	__global float *blueNoise, unsigned int samplerType,
+	__global PathState *paths, __global uint *rayQueue,
+	__global uint *queueCounts, __global uint *materialQueues)
+{
+	const unsigned int i = get_global_id(0);
+	if (i >= queueCounts[QUEUE_RAYS])
+		return;
+	uint pathIndex = rayQueue[i];
+	Ray ray = paths[pathIndex].Ray;
+
+	float t = INFINITY;
+	float3 n;
+	Intersection isect;
+
+	if (!intersectBVH(&ray, vertices, triangles, materials, transforms, bvh,
+			&t, &n, &isect, renderStats))
+	{
+		// Add background color, path is complete
+		paths[pathIndex].Radiance +=
+			paths[pathIndex].Throughput * (float3)(0.2f, 0.2f, 0.2f);
+		return;
+	}
+	paths[pathIndex].Isect = isect;
+	paths[pathIndex].T = t;
+
+	Material material = materials[triangles[isect.TriangleIndex].Material];
+	uint queue = material.IsTransparent || material.IsMetal ? QUEUE_SPECULAR
+															: QUEUE_DIFFUSE;
+	uint slot = atomic_inc(&queueCounts[queue]);
+	uint queueOffset = (queue - QUEUE_DIFFUSE) * image->Width * image->Height;
+	materialQueues[queueOffset + slot] = pathIndex;
+}
+
+// Wavefront pass 3: shade hits of one material queue, the same as a bounce of
+// trace, and queue continuing paths for the next bounce
+__kernel void wavefrontShade(__global ImageProps *image,
+	__global CameraProps *camera, __global Vertex *vertices,
+	__global Triangle *triangles, __global Material *materials,
+	__global mat4 *transforms, __global BVHLinearNode *bvh,
+	__global Light *lights, unsigned int nLights, float totalLightArea,
+	__global LightBVHNode *lightBVH, __global LightAliasEntry *lightAliasTable,
+	__global uint *triangleLights, __global RenderStats *renderStats,
+	__global float *blueNoise, unsigned int samplerType,
+	__global PathState *paths, __global uint *materialQueues,
+	__global uint *queueCounts, __global uint *nextRayQueue,
+	unsigned int queue, unsigned int sampleIndex)
+{
+	const unsigned int i = get_global_id(0);
+	if (i >= queueCounts[queue])
+		return;
+	uint queueOffset = (queue - QUEUE_DIFFUSE) * image->Width * image->Height;
+	uint pathIndex = materialQueues[queueOffset + i];
+	PathState path = paths[pathIndex];
+
+	Sampler sampler;
+	initSampler(&sampler, samplerType, pathIndex % image->Width,
+		pathIndex / image->Width, image->Width, sampleIndex, blueNoise);
+
+	Intersection isect = path.Isect;
+	Material material = materials[triangles[isect.TriangleIndex].Material];
+
+	// Accumulate emission, weighted with MIS if the light could also have
+	// been reached by light sampling from the previous vertex
+	uint lightIndex = triangleLights[isect.TriangleIndex];
+	if (path.SpecularBounce || lightIndex == NO_LIGHT)
+		path.Radiance += path.Throughput * material.Emission;
+	else
+	{
+		float cosLight = fabs(dot(isect.N, path.Ray.dir));
+		if (cosLight > 0.0f)
+		{
+			float pmf = calcLightSelectionPmf(path.PrevP, path.PrevN,
+				lightIndex, lights, totalLightArea, lightBVH, lightAliasTable);
+			float lightPdf = calcLightPdf(pmf, lights[lightIndex].Area,
+				path.T * path.T, cosLight);
+			path.Radiance += path.Throughput * material.Emission *
+				powerHeuristic(path.BsdfPdf, lightPdf);
+		}
+	}
+
+	startBounceDimensions(&sampler, path.Depth, SAMPLE_DIMENSION_BSDF);
+	bounceRay(&path.Ray, &isect, vertices, triangles, &material, transforms,
+		&sampler);
+
+	path.SpecularBounce = material.IsTransparent || material.IsMetal;
+	if (!path.SpecularBounce)
+	{
+		// Next event estimation
+		startBounceDimensions(&sampler, path.Depth, SAMPLE_DIMENSION_LIGHT);
+		path.Radiance += path.Throughput *
+			sampleDirectLight(&isect, &material, vertices, triangles,
+				materials, transforms, bvh, lights, nLights, totalLightArea,
+				lightBVH, lightAliasTable, renderStats, &sampler);
+
+		path.BsdfPdf = dot(path.Ray.dir, isect.N) / PI;
+		path.PrevP = isect.P;
+		path.PrevN = isect.N;
+	}
+	path.Throughput *= material.Albedo;
+	path.Depth++;
+	paths[pathIndex] = path;
+
+	// Compact continuing paths into the next ray queue
+	if (path.Depth < MAX_DEPTH)
+		nextRayQueue[atomic_inc(&queueCounts[QUEUE_NEXT_RAYS])] = pathIndex;
+}
+
+// Between wavefront bounces: the next ray queue becomes the ray queue and the
+// material queues are emptied, run by a single work item
+__kernel void wavefrontAdvance(__global uint *queueCounts)
+{
+	queueCounts[QUEUE_RAYS] = queueCounts[QUEUE_NEXT_RAYS];
+	queueCounts[QUEUE_DIFFUSE] = 0;
+	queueCounts[QUEUE_SPECULAR] = 0;
+	queueCounts[QUEUE_NEXT_RAYS] = 0;
+}
+
+// Wavefront pass 4: add the completed sample of every pixel to its running
+// sum, in sample order so the result matches the megakernel
+__kernel void wavefrontAccumulate(__global ImageProps *image,
+	__global CameraProps *camera, __global Vertex *vertices,
+	__global Triangle *triangles, __global Material *materials,
+	__global mat4 *transforms, __global BVHLinearNode *bvh,
+	__global Light *lights, unsigned int nLights, float totalLightArea,
+	__global LightBVHNode *lightBVH, __global LightAliasEntry *lightAliasTable,
+	__global uint *triangleLights, __global RenderStats *renderStats,
+	__global float *blueNoise, unsigned int samplerType,
+	__global PathState *paths, __global float3 *accumulation,
+	unsigned int nAccumulatedSamples)
+{
+	const unsigned int pixel = get_global_id(0);
+	if (pixel >= image->Width * image->Height)
+		return;
+
+	float3 color = nAccumulatedSamples > 0 ? accumulation[pixel]
+										   : (float3)(0.0f, 0.0f, 0.0f);
+	color += paths[pixel].Radiance;
+	accumulation[pixel] = color;
+}
+
+// Post-process for LDR output: average the running sum of every pixel, then
+// expose, tonemap and quantize it to 8-bit RGBA, so a quarter of the bytes of
+// the radiance are read back
+__kernel void tonemap(__global ImageProps *image,
+	__global float3 *accumulation, __global uchar4 *ldrOutput, float scale,
+	float exposure, unsigned int tonemapOperator, unsigned int srgb)
+{
+	const unsigned int pixel = get_global_id(0);
+	if (pixel >= image->Width * image->Height)
+		return;
+
+	ldrOutput[pixel] = tonemapPixel(accumulation[pixel] * scale, exposure,
+		tonemapOperator, srgb);
 }
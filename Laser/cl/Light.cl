@@ -0,0 +1,343 @@
+#ifndef LIGHT_CL
+#define LIGHT_CL
+
+#include "BVH.cl"
+#include "Bounds.cl"
+#include "Intersection.cl"
+#include "Material.cl"
+#include "Random.cl"
+#include "Ray.cl"
+#include "RenderStats.cl"
+#include "Sampler.cl"
+#include "Transform.cl"
+#include "Triangle.cl"
+#include "Vertex.cl"
+
+#define LIGHT_SAMPLING_AREA 0
+#define LIGHT_SAMPLING_POWER 1
+#define LIGHT_SAMPLING_BVH 2
+
+#define NO_LIGHT 0xFFFFFFFF
+
+typedef struct Light
+{
+	uint TriangleIndex; // Index into BVH-ordered triangles
+	float Area;			// World space area
+	float CDF;			// Cumulative selection probability
+	uint BitTrail;		// Path from light BVH root to leaf (0 = left)
+} Light;
+
+typedef struct LightAliasEntry
+{
+	float Probability; // Probability of keeping this entry
+	uint Alias;		   // Light chosen otherwise
+	float Pmf;		   // Power-proportional selection probability
+	float dummy;
+} LightAliasEntry;
+
+typedef struct LightBVHNode
+{
+	Bounds Bounds;
+	float3 Axis; // Axis of cone of normal lines (lights are two-sided)
+	float CosThetaO;
+	float CosThetaE;
+	float Power;
+	uint SecondChildOffset; // First child is next node in array
+	uint LightIndex;
+	uint IsLeaf;
+	uint dummy[2];
+} LightBVHNode;
+
+// Get world space vertices of a triangle
+void getTriangleVertices(__global Vertex *vertices,
+	__global Triangle *triangles, __global mat4 *transforms, uint triIndex,
+	float3 *v0, float3 *v1, float3 *v2)
+{
+	// Local copy of transformation matrix
+	mat4 transform;
+	transform[0] = transforms[triangles[triIndex].Transform][0];
+	transform[1] = transforms[triangles[triIndex].Transform][1];
+	transform[2] = transforms[triangles[triIndex].Transform][2];
+	transform[3] = transforms[triangles[triIndex].Transform][3];
+
+	*v0 = vertices[triangles[triIndex].v0].Position;
+	*v1 = vertices[triangles[triIndex].v1].Position;
+	*v2 = vertices[triangles[triIndex].v2].Position;
+
+	*v0 = multMat4Point(&transform, v0);
+	*v1 = multMat4Point(&transform, v1);
+	*v2 = multMat4Point(&transform, v2);
+}
+
+// Select a light with probability proportional to its area using binary
+// search over the CDF
+uint selectLight(__global Light *lights, uint nLights, float u)
+{
+	uint low = 0;
+	uint high = nLights - 1;
+	while (low < high)
+	{
+		uint mid = (low + high) / 2;
+		if (lights[mid].CDF < u)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+// Select a light with probability proportional to its power in constant time
+uint selectLightAlias(__global LightAliasEntry *lightAliasTable, uint nLights,
+	float u)
+{
+	float scaled = u * nLights;
+	uint entry = min((uint)scaled, nLights - 1);
+	float remainder = scaled - entry;
+	return remainder < lightAliasTable[entry].Probability
+		? entry
+		: lightAliasTable[entry].Alias;
+}
+
+// cos(max(0, a - b)) and sin(max(0, a - b)) from sines and cosines of angles
+float cosSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	if (cosA > cosB)
+		return 1.0f;
+	return cosA * cosB + sinA * sinB;
+}
+
+float sinSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	if (cosA > cosB)
+		return 0.0f;
+	return sinA * cosB - cosA * sinB;
+}
+
+// Conservative estimate of the contribution of the lights in a light BVH node
+// to shading point p with normal n
+float calcLightBVHImportance(__global LightBVHNode *node, float3 p, float3 n)
+{
+	float3 center = (node->Bounds.pMin + node->Bounds.pMax) * 0.5f;
+	float3 diagonal = node->Bounds.pMax - node->Bounds.pMin;
+
+	float3 wi = p - center;
+	float dist2 = dot(wi, wi);
+	wi = dist2 > 0.0f ? wi / sqrt(dist2) : n;
+
+	// Angle between cone axis and direction to the shading point
+	float cosThetaW = fabs(dot(node->Axis, wi));
+	float sinThetaW = sqrt(max(0.0f, 1.0f - cosThetaW * cosThetaW));
+
+	// Angle subtended by the node's bounding sphere
+	float radius2 = dot(diagonal, diagonal) * 0.25f;
+	float cosThetaB = -1.0f;
+	float sinThetaB = 0.0f;
+	if (dist2 > radius2)
+	{
+		float sin2ThetaB = radius2 / dist2;
+		cosThetaB = sqrt(max(0.0f, 1.0f - sin2ThetaB));
+		sinThetaB = sqrt(sin2ThetaB);
+	}
+
+	// Minimum angle between any emitter normal and the shading point
+	float sinThetaO =
+		sqrt(max(0.0f, 1.0f - node->CosThetaO * node->CosThetaO));
+	float cosThetaX =
+		cosSubClamped(sinThetaW, cosThetaW, sinThetaO, node->CosThetaO);
+	float sinThetaX =
+		sinSubClamped(sinThetaW, cosThetaW, sinThetaO, node->CosThetaO);
+	float cosThetaP =
+		cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP <= node->CosThetaE)
+		return 0.0f;
+
+	// Maximum cosine at the shading point towards the node
+	float cosThetaI = dot(n, -wi);
+	float sinThetaI = sqrt(max(0.0f, 1.0f - cosThetaI * cosThetaI));
+	float cosThetaIP =
+		cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+	if (cosThetaIP <= 0.0f)
+		return 0.0f;
+
+	// Avoid the singularity when the point is inside or very close to the
+	// node by clamping the distance to the bounding sphere's radius
+	dist2 = max(dist2, radius2);
+	return node->Power * cosThetaP * cosThetaIP / dist2;
+}
+
+// Choose a light for shading point p with normal n, returning false if no
+// light can contribute
+bool chooseLight(float3 p, float3 n, float u, __global Light *lights,
+	uint nLights, float totalLightArea, __global LightBVHNode *lightBVH,
+	__global LightAliasEntry *lightAliasTable, uint *lightIndex, float *pmf)
+{
+	if (nLights == 0)
+		return false;
+
+	if (LIGHT_SAMPLING == LIGHT_SAMPLING_AREA)
+	{
+		*lightIndex = selectLight(lights, nLights, u);
+		*pmf = lights[*lightIndex].Area / totalLightArea;
+		return true;
+	}
+
+	if (LIGHT_SAMPLING == LIGHT_SAMPLING_POWER)
+	{
+		*lightIndex = selectLightAlias(lightAliasTable, nLights, u);
+		*pmf = lightAliasTable[*lightIndex].Pmf;
+		return *pmf > 0.0f;
+	}
+
+	// Descend light BVH, choosing children in proportion to their importance
+	// and reusing the remaining range of u at each level
+	uint current = 0;
+	*pmf = 1.0f;
+	while (!lightBVH[current].IsLeaf)
+	{
+		uint child0 = current + 1;
+		uint child1 = lightBVH[current].SecondChildOffset;
+		float importance0 = calcLightBVHImportance(&lightBVH[child0], p, n);
+		float importance1 = calcLightBVHImportance(&lightBVH[child1], p, n);
+		if (importance0 == 0.0f && importance1 == 0.0f)
+			return false;
+
+		float p0 = importance0 / (importance0 + importance1);
+		if (u < p0)
+		{
+			current = child0;
+			u = min(u / p0, 0.99999994f);
+			*pmf *= p0;
+		}
+		else
+		{
+			current = child1;
+			u = min((u - p0) / (1.0f - p0), 0.99999994f);
+			*pmf *= 1.0f - p0;
+		}
+	}
+	*lightIndex = lightBVH[current].LightIndex;
+	return true;
+}
+
+// Probability that chooseLight selects a given light from shading point p
+// with normal n
+float calcLightSelectionPmf(float3 p, float3 n, uint lightIndex,
+	__global Light *lights, float totalLightArea,
+	__global LightBVHNode *lightBVH, __global LightAliasEntry *lightAliasTable)
+{
+	if (LIGHT_SAMPLING == LIGHT_SAMPLING_AREA)
+		return lights[lightIndex].Area / totalLightArea;
+
+	if (LIGHT_SAMPLING == LIGHT_SAMPLING_POWER)
+		return lightAliasTable[lightIndex].Pmf;
+
+	// Follow the light's bit trail from the root
+	uint bitTrail = lights[lightIndex].BitTrail;
+	uint current = 0;
+	float pmf = 1.0f;
+	while (!lightBVH[current].IsLeaf)
+	{
+		uint child0 = current + 1;
+		uint child1 = lightBVH[current].SecondChildOffset;
+		float importance0 = calcLightBVHImportance(&lightBVH[child0], p, n);
+		float importance1 = calcLightBVHImportance(&lightBVH[child1], p, n);
+		if (importance0 == 0.0f && importance1 == 0.0f)
+			return 0.0f;
+
+		if (bitTrail & 1)
+		{
+			pmf *= importance1 / (importance0 + importance1);
+			current = child1;
+		}
+		else
+		{
+			pmf *= importance0 / (importance0 + importance1);
+			current = child0;
+		}
+		bitTrail >>= 1;
+	}
+	return pmf;
+}
+
+// Uniformly sample a point on a triangle
+float3 samplePointOnTriangle(float3 v0, float3 v1, float3 v2, float u1,
+	float u2)
+{
+	float su1 = sqrt(u1);
+	float b0 = 1.0f - su1;
+	float b1 = u2 * su1;
+	return b0 * v0 + b1 * v1 + (1.0f - b0 - b1) * v2;
+}
+
+// Solid angle pdf of sampling a light point given the light's selection pmf
+float calcLightPdf(float pmf, float area, float dist2, float cosLight)
+{
+	return pmf * dist2 / (cosLight * area);
+}
+
+// Multiple importance sampling weight for strategy with pdf a
+float powerHeuristic(float a, float b)
+{
+	float a2 = a * a;
+	return a2 / (a2 + b * b);
+}
+
+// Estimate direct lighting at a diffuse vertex by connecting a shadow ray to
+// a point on an emissive triangle, weighted against BSDF sampling with MIS
+float3 sampleDirectLight(Intersection *isect, Material *material,
+	__global Vertex *vertices, __global Triangle *triangles,
+	__global Material *materials, __global mat4 *transforms,
+	__global BVHLinearNode *bvh, __global Light *lights, uint nLights,
+	float totalLightArea, __global LightBVHNode *lightBVH,
+	__global LightAliasEntry *lightAliasTable,
+	__global RenderStats *renderStats, Sampler *sampler)
+{
+	float3 black = (float3)(0.0f, 0.0f, 0.0f);
+
+	// Choose light and point on light
+	uint lightIndex;
+	float pmf;
+	if (!chooseLight(isect->P, isect->N, sample1D(sampler), lights, nLights,
+			totalLightArea, lightBVH, lightAliasTable, &lightIndex, &pmf))
+		return black;
+	uint triIndex = lights[lightIndex].TriangleIndex;
+
+	float3 v0, v1, v2;
+	getTriangleVertices(vertices, triangles, transforms, triIndex, &v0, &v1,
+		&v2);
+	float2 u = sample2D(sampler);
+	float3 lightPoint = samplePointOnTriangle(v0, v1, v2, u.x, u.y);
+	float3 lightNormal = normalize(cross(v1 - v0, v2 - v0));
+
+	// Geometry terms
+	float3 toLight = lightPoint - isect->P;
+	float dist2 = dot(toLight, toLight);
+	float dist = sqrt(dist2);
+	float3 wi = toLight / dist;
+
+	float cosSurface = dot(isect->N, wi);
+	float cosLight = fabs(dot(lightNormal, wi)); // Lights are two-sided
+	if (cosSurface <= 0.0f || cosLight <= 0.0f)
+		return black;
+
+	// Shadow ray
+	Ray shadowRay;
+	shadowRay.orig = isect->P + isect->N * EPSILON;
+	shadowRay.dir = wi;
+	if (occludedBVH(&shadowRay, dist * (1.0f - SHADOW_EPSILON), vertices,
+			triangles, transforms, bvh, renderStats))
+		return black;
+
+	// Weight against the pdf of cosine-weighted BSDF sampling
+	float lightPdf =
+		calcLightPdf(pmf, lights[lightIndex].Area, dist2, cosLight);
+	float bsdfPdf = cosSurface / PI;
+	float weight = powerHeuristic(lightPdf, bsdfPdf);
+
+	float3 emission = materials[triangles[triIndex].Material].Emission;
+	float3 bsdf = material->Albedo / PI;
+
+	return bsdf * emission * cosSurface * weight / lightPdf;
+}
+
+#endif // LIGHT_CL
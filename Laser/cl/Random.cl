@@ -1,30 +1,59 @@
-#ifndef RANDOM_CL
-#define RANDOM_CL
-
-uint PCGHash(uint seed)
-{
-	uint state = seed * 747796405u + 2891336453u;
-	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
-	return (word >> 22u) ^ word;
-}
-
-float randomFloat(uint *seed)
-{
-	*seed = PCGHash(*seed);
-	return (float)*seed / (float)0xFFFFFFFFu;
-}
-
-float3 randomFloat3InUnitDisk(uint *seed)
-{
-	float3 point;
-	while (true)
-	{
-		point = (float3)(randomFloat(seed) * 2.0f - 1.0f,
-			randomFloat(seed) * 2.0f - 1.0f, 0.0f);
-		if (length(point) < 1.0f)
-			break;
-	}
-	return point;
-}
-
-#endif // RANDOM_CL
+#ifndef RANDOM_CL
+#define RANDOM_CL
+
+uint PCGHash(uint seed)
+{
+	uint state = seed * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+// Philox4x32-10 counter-based generator (Salmon et al. 2011), the output is a
+// pure function of counter and key so any random number can be generated
+// independently of how work is split into passes, tiles or devices
+uint4 philox4x32(uint4 counter, uint2 key)
+{
+	for (int i = 0; i < 10; i++)
+	{
+		if (i > 0)
+			key += (uint2)(0x9E3779B9u, 0xBB67AE85u);
+
+		uint hi0 = mul_hi(0xD2511F53u, counter.x);
+		uint lo0 = 0xD2511F53u * counter.x;
+		uint hi1 = mul_hi(0xCD9E8D57u, counter.z);
+		uint lo1 = 0xCD9E8D57u * counter.z;
+		counter = (uint4)(hi1 ^ counter.y ^ key.x, lo1,
+			hi0 ^ counter.w ^ key.y, lo0);
+	}
+	return counter;
+}
+
+float randomFloat(uint *seed)
+{
+	*seed = PCGHash(*seed);
+	return (float)*seed / (float)0xFFFFFFFFu;
+}
+
+// Concentric mapping of a 2D sample to the unit disk, which unlike rejection
+// sampling consumes a fixed number of dimensions and preserves stratification
+float3 sampleUnitDisk(float2 u)
+{
+	float2 offset = u * 2.0f - 1.0f;
+	if (offset.x == 0.0f && offset.y == 0.0f)
+		return (float3)(0.0f, 0.0f, 0.0f);
+
+	float r, theta;
+	if (fabs(offset.x) > fabs(offset.y))
+	{
+		r = offset.x;
+		theta = (PI / 4.0f) * (offset.y / offset.x);
+	}
+	else
+	{
+		r = offset.y;
+		theta = (PI / 2.0f) - (PI / 4.0f) * (offset.x / offset.y);
+	}
+	return (float3)(r * cos(theta), r * sin(theta), 0.0f);
+}
+
+#endif // RANDOM_CL
@@ -1,10 +1,10 @@
-#ifndef RAY_CL
-#define RAY_CL
-
-typedef struct Ray
-{
-	float3 orig;
-	float3 dir;
-} Ray;
-
-#endif // RAY_CL
+#ifndef RAY_CL
+#define RAY_CL
+
+typedef struct Ray
+{
+	float3 orig;
+	float3 dir;
+} Ray;
+
+#endif // RAY_CL
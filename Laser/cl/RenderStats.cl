@@ -1,12 +1,12 @@
-#ifndef RENDERSTATS_CL
-#define RENDERSTATS_CL
-
-typedef struct RenderStats
-{
-	unsigned int n_PrimaryRays;
-	unsigned int n_RayTriangleTests;
-	unsigned int n_RayTriangleIsects;
-	float RenderTime;
-} RenderStats;
-
-#endif // RENDERSTATS_CL
+#ifndef RENDERSTATS_CL
+#define RENDERSTATS_CL
+
+typedef struct RenderStats
+{
+	unsigned int n_PrimaryRays;
+	unsigned int n_RayTriangleTests;
+	unsigned int n_RayTriangleIsects;
+	float RenderTime;
+} RenderStats;
+
+#endif // RENDERSTATS_CL
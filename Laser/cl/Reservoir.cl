@@ -0,0 +1,133 @@
+#ifndef RESERVOIR_CL
+#define RESERVOIR_CL
+
+#include "BVH.cl"
+#include "Light.cl"
+#include "Material.cl"
+#include "Random.cl"
+#include "Triangle.cl"
+
+// Weighted reservoir holding one light sample selected by resampled
+// importance sampling (RIS) from a stream of candidates
+typedef struct Reservoir
+{
+	float3 LightPoint;
+	float3 LightNormal;
+	uint LightIndex;
+	float WeightSum; // Sum of resampling weights of all candidates
+	float M;		 // Number of candidates seen
+	float W;		 // Unbiased contribution weight of selected sample
+} Reservoir;
+
+// Primary hit of a pixel, used to evaluate reused light samples
+typedef struct ReservoirSurface
+{
+	float3 P;
+	float3 N;
+	uint Material;
+	float Depth;
+	uint IsValid; // False if the primary ray missed or hit a specular surface
+	uint dummy;
+} ReservoirSurface;
+
+void initReservoir(Reservoir *r)
+{
+	r->LightIndex = NO_LIGHT;
+	r->WeightSum = 0.0f;
+	r->M = 0.0f;
+	r->W = 0.0f;
+}
+
+// Stream a candidate (or another reservoir representing m candidates) through
+// the reservoir
+void updateReservoir(Reservoir *r, float3 lightPoint, float3 lightNormal,
+	uint lightIndex, float weight, float m, uint *seed)
+{
+	r->WeightSum += weight;
+	r->M += m;
+	if (weight > 0.0f && randomFloat(seed) * r->WeightSum < weight)
+	{
+		r->LightPoint = lightPoint;
+		r->LightNormal = lightNormal;
+		r->LightIndex = lightIndex;
+	}
+}
+
+float calcLuminance(float3 color)
+{
+	return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+// Unshadowed contribution of a light point to a diffuse surface
+float3 calcUnshadowedContribution(ReservoirSurface *surface,
+	__global Material *materials, __global Triangle *triangles,
+	__global Light *lights, float3 lightPoint, float3 lightNormal,
+	uint lightIndex)
+{
+	float3 black = (float3)(0.0f, 0.0f, 0.0f);
+	if (lightIndex == NO_LIGHT)
+		return black;
+
+	float3 toLight = lightPoint - surface->P;
+	float dist2 = dot(toLight, toLight);
+	float3 wi = toLight / sqrt(dist2);
+
+	float cosSurface = dot(surface->N, wi);
+	float cosLight = fabs(dot(lightNormal, wi));
+	if (cosSurface <= 0.0f || cosLight <= 0.0f)
+		return black;
+
+	uint triIndex = lights[lightIndex].TriangleIndex;
+	float3 emission = materials[triangles[triIndex].Material].Emission;
+	float3 bsdf = materials[surface->Material].Albedo / PI;
+
+	return bsdf * emission * cosSurface * cosLight / dist2;
+}
+
+// Target function of resampling
+float calcTargetPdf(ReservoirSurface *surface, __global Material *materials,
+	__global Triangle *triangles, __global Light *lights, float3 lightPoint,
+	float3 lightNormal, uint lightIndex)
+{
+	return calcLuminance(calcUnshadowedContribution(surface, materials,
+		triangles, lights, lightPoint, lightNormal, lightIndex));
+}
+
+// Merge reservoir b into a, re-evaluating b's sample at a's surface
+void combineReservoir(Reservoir *a, Reservoir *b, float bM,
+	ReservoirSurface *surface, __global Material *materials,
+	__global Triangle *triangles, __global Light *lights, uint *seed)
+{
+	float targetPdf = calcTargetPdf(surface, materials, triangles, lights,
+		b->LightPoint, b->LightNormal, b->LightIndex);
+	updateReservoir(a, b->LightPoint, b->LightNormal, b->LightIndex,
+		targetPdf * b->W * bM, bM, seed);
+}
+
+// Compute the contribution weight of the selected sample
+void finalizeReservoir(Reservoir *r, ReservoirSurface *surface,
+	__global Material *materials, __global Triangle *triangles,
+	__global Light *lights)
+{
+	float targetPdf = calcTargetPdf(surface, materials, triangles, lights,
+		r->LightPoint, r->LightNormal, r->LightIndex);
+	r->W = targetPdf > 0.0f ? r->WeightSum / (r->M * targetPdf) : 0.0f;
+}
+
+// Test if the selected light point is visible from the surface
+bool isReservoirSampleVisible(ReservoirSurface *surface, Reservoir *r,
+	__global Vertex *vertices, __global Triangle *triangles,
+	__global mat4 *transforms, __global BVHLinearNode *bvh,
+	__global RenderStats *renderStats)
+{
+	float3 toLight = r->LightPoint - surface->P;
+	float dist = length(toLight);
+
+	Ray shadowRay;
+	shadowRay.orig = surface->P + surface->N * EPSILON;
+	shadowRay.dir = toLight / dist;
+	return !occludedBVH(&shadowRay, dist * (1.0f - SHADOW_EPSILON), vertices,
+		triangles, transforms, bvh, renderStats);
+}
+
+#endif // RESERVOIR_CL
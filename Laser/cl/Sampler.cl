@@ -0,0 +1,202 @@
+#ifndef SAMPLER_CL
+#define SAMPLER_CL
+
+#include "Random.cl"
+
+#define SAMPLER_RANDOM 0
+#define SAMPLER_SOBOL 1
+#define SAMPLER_BLUE_NOISE 2
+
+// Dimensions of a path sample, each bounce starts at a fixed dimension so
+// samples stay stratified against the same sample at other pixels regardless
+// of how many dimensions the previous bounce consumed
+#define SAMPLE_DIMENSION_PIXEL 0 // 2D
+#define SAMPLE_DIMENSION_LENS 2	 // 2D
+#define SAMPLE_DIMENSION_BOUNCE 4
+#define SAMPLE_DIMENSION_BSDF 0	 // 2D (1D for choosing Fresnel lobe)
+#define SAMPLE_DIMENSION_LIGHT 2 // 1D light choice, 2D point on light
+#define SAMPLE_DIMENSIONS_PER_BOUNCE 5
+
+#define BLUE_NOISE_SIZE 64
+
+// Generates the sample values of one pixel sample, addressed by pixel, sample
+// index and dimension
+typedef struct Sampler
+{
+	uint Type;
+	uint x;
+	uint y;
+	uint Pixel;
+	uint PixelSeed;
+	uint Index;
+	uint Dimension;
+	uint FirstBounce; // Bounces already sampled by the caller of a path
+	__global float *BlueNoise; // BLUE_NOISE_SIZE^2 void-and-cluster mask
+} Sampler;
+
+uint reverseBits(uint x)
+{
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00FF00FFu) << 8) | ((x & 0xFF00FF00u) >> 8);
+	x = ((x & 0x0F0F0F0Fu) << 4) | ((x & 0xF0F0F0F0u) >> 4);
+	x = ((x & 0x33333333u) << 2) | ((x & 0xCCCCCCCCu) >> 2);
+	x = ((x & 0x55555555u) << 1) | ((x & 0xAAAAAAAAu) >> 1);
+	return x;
+}
+
+uint hashCombine(uint seed, uint v)
+{
+	return seed ^ (v + 0x9E3779B9u + (seed << 6) + (seed >> 2));
+}
+
+// Second dimension of the Sobol sequence, the first is the bit reversed index
+uint sobolSecondDimension(uint index)
+{
+	uint result = 0;
+	for (uint v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+		if (index & 1)
+			result ^= v;
+	return result;
+}
+
+// Hash-based Owen scrambling (Burley 2020), permutes bits so that each bit is
+// only affected by the bits above it
+uint laineKarrasPermutation(uint x, uint seed)
+{
+	x += seed;
+	x ^= x * 0x6C50B47Cu;
+	x ^= x * 0xB82F1E52u;
+	x ^= x * 0xC7AFE638u;
+	x ^= x * 0x8D22F6E6u;
+	return x;
+}
+
+uint nestedUniformScramble(uint x, uint seed)
+{
+	return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+float toUnitFloat(uint x)
+{
+	// Use the top 24 bits so the result is never rounded up to 1
+	return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+// Owen-scrambled Sobol point, with the index shuffled by the same scrambling
+// so that padding dimensions with independent seeds decorrelates them
+float2 owenSobol2D(uint index, uint seed)
+{
+	index = nestedUniformScramble(index, seed);
+	uint x = nestedUniformScramble(reverseBits(index), hashCombine(seed, 0));
+	uint y = nestedUniformScramble(sobolSecondDimension(index),
+		hashCombine(seed, 1));
+	return (float2)(toUnitFloat(x), toUnitFloat(y));
+}
+
+float owenSobol1D(uint index, uint seed)
+{
+	index = nestedUniformScramble(index, seed);
+	return toUnitFloat(
+		nestedUniformScramble(reverseBits(index), hashCombine(seed, 0)));
+}
+
+// Per-pixel toroidal shift from the blue noise mask, offset per dimension so
+// dimensions use uncorrelated parts of the mask
+float blueNoiseShift(Sampler *sampler, uint dimension)
+{
+	uint offset = PCGHash(dimension);
+	uint mx = (sampler->x + offset) % BLUE_NOISE_SIZE;
+	uint my = (sampler->y + (offset >> 16)) % BLUE_NOISE_SIZE;
+	return sampler->BlueNoise[mx + my * BLUE_NOISE_SIZE];
+}
+
+// Independent random numbers addressed by pixel, sample index and dimension
+uint2 randomSample2D(Sampler *sampler, uint dimension)
+{
+	uint4 counter = (uint4)(sampler->Pixel, sampler->Index, dimension, 0);
+	uint4 random = philox4x32(counter, (uint2)(0xA511E9B3u, 0x63D83595u));
+	return (uint2)(random.x, random.y);
+}
+
+void initSampler(Sampler *sampler, uint type, uint x, uint y, uint width,
+	uint index, __global float *blueNoise)
+{
+	sampler->Type = type;
+	sampler->x = x;
+	sampler->y = y;
+	sampler->Pixel = x + y * width;
+	sampler->PixelSeed = PCGHash(sampler->Pixel);
+	sampler->Index = index;
+	sampler->Dimension = 0;
+	sampler->FirstBounce = 0;
+	sampler->BlueNoise = blueNoise;
+}
+
+void setSampleDimension(Sampler *sampler, uint dimension)
+{
+	sampler->Dimension = dimension;
+}
+
+float sample1D(Sampler *sampler)
+{
+	uint dimension = sampler->Dimension++;
+	switch (sampler->Type)
+	{
+	case SAMPLER_SOBOL:
+		// Independent scrambling per pixel and dimension
+		return owenSobol1D(sampler->Index,
+			hashCombine(sampler->PixelSeed, dimension));
+
+	case SAMPLER_BLUE_NOISE:
+	{
+		// Same scrambling for every pixel, decorrelated across pixels by a
+		// blue noise shift so error is distributed as blue noise
+		float u = owenSobol1D(sampler->Index, PCGHash(dimension)) +
+			blueNoiseShift(sampler, dimension);
+		return u >= 1.0f ? u - 1.0f : u;
+	}
+
+	case SAMPLER_RANDOM:
+	default:
+		return toUnitFloat(randomSample2D(sampler, dimension).x);
+	}
+}
+
+float2 sample2D(Sampler *sampler)
+{
+	uint dimension = sampler->Dimension;
+	sampler->Dimension += 2;
+	switch (sampler->Type)
+	{
+	case SAMPLER_SOBOL:
+		return owenSobol2D(sampler->Index,
+			hashCombine(sampler->PixelSeed, dimension));
+
+	case SAMPLER_BLUE_NOISE:
+	{
+		float2 u = owenSobol2D(sampler->Index, PCGHash(dimension));
+		u.x += blueNoiseShift(sampler, dimension);
+		u.y += blueNoiseShift(sampler, dimension + 1);
+		return (float2)(u.x >= 1.0f ? u.x - 1.0f : u.x,
+			u.y >= 1.0f ? u.y - 1.0f : u.y);
+	}
+
+	case SAMPLER_RANDOM:
+	default:
+	{
+		uint2 u = randomSample2D(sampler, dimension);
+		return (float2)(toUnitFloat(u.x), toUnitFloat(u.y));
+	}
+	}
+}
+
+// Set dimension to the start of a bounce's dimensions
+void startBounceDimensions(Sampler *sampler, uint depth, uint offset)
+{
+	setSampleDimension(sampler,
+		SAMPLE_DIMENSION_BOUNCE +
+			(sampler->FirstBounce + depth) * SAMPLE_DIMENSIONS_PER_BOUNCE +
+			offset);
+}
+
+#endif // SAMPLER_CL
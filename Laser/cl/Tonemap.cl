@@ -0,0 +1,44 @@
+#ifndef TONEMAP_CL
+#define TONEMAP_CL
+
+// Tonemapping operators of the tonemap kernel
+#define TONEMAP_CLAMP 0
+#define TONEMAP_REINHARD 1
+#define TONEMAP_ACES 2
+
+float3 applyTonemap(float3 color, uint tonemapOperator)
+{
+	if (tonemapOperator == TONEMAP_REINHARD)
+		return color / (1.0f + color);
+
+	// Narkowicz's fit of the ACES filmic curve
+	if (tonemapOperator == TONEMAP_ACES)
+		return (color * (2.51f * color + 0.03f)) /
+			(color * (2.43f * color + 0.59f) + 0.14f);
+
+	return color;
+}
+
+// sRGB transfer function of a linear value in [0, 1]
+float encodeSRGB(float x)
+{
+	return x <= 0.0031308f ? 12.92f * x : 1.055f * pow(x, 1.0f / 2.4f) - 0.055f;
+}
+
+// Exposed, tonemapped and optionally sRGB encoded 8-bit pixel. Values are
+// truncated like the host's image writer, so clamping without sRGB matches it.
+uchar4 tonemapPixel(float3 radiance, float exposure, uint tonemapOperator,
+	uint srgb)
+{
+	float3 color =
+		clamp(applyTonemap(radiance * exposure, tonemapOperator), 0.0f, 1.0f);
+	if (srgb)
+		color = (float3)(encodeSRGB(color.x), encodeSRGB(color.y),
+			encodeSRGB(color.z));
+
+	uint3 quantized = convert_uint3(color * 255.0f);
+	return (uchar4)((uchar)quantized.x, (uchar)quantized.y, (uchar)quantized.z,
+		(uchar)255);
+}
+
+#endif // TONEMAP_CL
@@ -1,10 +1,10 @@
-#ifndef VERTEX_CL
-#define VERTEX_CL
-
-typedef struct Vertex
-{
-	float3 Position;
-	float3 Normal;
-} Vertex;
-
-#endif // VERTEX_CL
+#ifndef VERTEX_CL
+#define VERTEX_CL
+
+typedef struct Vertex
+{
+	float3 Position;
+	float3 Normal;
+} Vertex;
+
+#endif // VERTEX_CL
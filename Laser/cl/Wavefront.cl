@@ -0,0 +1,35 @@
+#ifndef WAVEFRONT_CL
+#define WAVEFRONT_CL
+
+#include "Intersection.cl"
+#include "Ray.cl"
+
+// Counters of queueCounts buffer
+#define QUEUE_RAYS 0
+#define QUEUE_DIFFUSE 1
+#define QUEUE_SPECULAR 2
+#define QUEUE_NEXT_RAYS 3
+
+// State of a path between wavefront kernels, there is one path per pixel for
+// the sample being rendered so the path index is the pixel index
+typedef struct PathState
+{
+	Ray Ray;
+	float3 Throughput;
+	float3 Radiance;
+
+	// Previous diffuse vertex and pdf of its bounce for weighting emission
+	// found by BSDF sampling against light sampling
+	float3 PrevP;
+	float3 PrevN;
+
+	// Closest hit found by the extend kernel
+	Intersection Isect;
+	float T;
+
+	float BsdfPdf;
+	uint Depth;
+	uint SpecularBounce;
+} PathState;
+
+#endif // WAVEFRONT_CL
@@ -1,6 +1,15 @@
 #include "Application.h"
 
+#include <array>
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #include <glm/glm.hpp>
 
@@ -8,10 +17,21 @@
 #include "ModelLoader.h"
 #include "Transform.h"
 #include "BVH.h"
+#include "Reservoir.h"
+#include "Wavefront.h"
+#include "TuningCache.h"
+#include "CPURenderer.h"
+#include "TileFileWriter.h"
+#include "JobQueue.h"
+#include "RenderJob.h"
 
-#define VERIFY(x) \
-	if (!x)       \
-	return false
+// Wrapped in a statement so an else after it can't bind to its if
+#define VERIFY(x)         \
+	do                    \
+	{                     \
+		if (!(x))         \
+			return false; \
+	} while (0)
 
 glm::vec3 cameraPosition = {1.00f, 1.00f, 1.00f};
 glm::vec3 cameraTarget = {0.50f, 0.50f, 0.50f};
@@ -21,22 +41,207 @@ float aperture = 0.0f;
 cl_float3 position = {cameraPosition.x, cameraPosition.y, cameraPosition.z};
 cl_float3 target = {cameraTarget.x, cameraTarget.y, cameraTarget.z};
 
+// Format of output.<extension>: binary PPM, float PFM of the radiance or PNG
+// compressed on every core
+Image::Format outputFormat = Image::Format::ppm;
+
+// Write each finished tile straight into output.ppm or output.pfm instead of
+// holding the image in memory, so host and device memory are bounded by a few
+// tiles at any resolution. Every pass of a tile is rendered before the next.
+// Can't be combined with wavefront, ReSTIR or the other render modes.
+bool streamOutput = false;
+
+// Save the running sums of tile and persistent renders to checkpointFile
+// after the first pass ending checkpointSeconds after the last save, written
+// in the background while rendering continues. A render of the same scene and
+// settings resumes from the checkpoint, which is deleted once it completes.
+// Saves only happen between passes, so checkpointed renders lower
+// samplesPerPass to checkpointSamplesPerPass, and at most a pass more than
+// checkpointSeconds of work is lost. A render of a single pass can't be
+// checkpointed.
+bool checkpointRenders = false;
+cl_float checkpointSeconds = 600.0f;
+cl_uint checkpointSamplesPerPass = 4;
+const std::string checkpointFile = "render.checkpoint";
+
+// Render only the tiles overlapping a crop of cropWidth by cropHeight pixels
+// at (cropX, cropY), unless 0 by 0, out of nJobTiles tiles from firstJobTile
+// along rows, unless 0, e.g. to re-render a region after a fix or to split a
+// frame into jobs. The output covers the job's pixels, with its offset in the
+// PPM or PNG header, or with patchOutput only the job's pixels are written
+// into place in an existing full image PPM or PFM, created if missing. Tile
+// indices depend on the tile size, which tuning may change per device.
+cl_uint cropX = 0;
+cl_uint cropY = 0;
+cl_uint cropWidth = 0;
+cl_uint cropHeight = 0;
+cl_uint firstJobTile = 0;
+cl_uint nJobTiles = 0;
+bool patchOutput = false;
+
+bool IsRenderJob()
+{
+	return (cropWidth > 0 && cropHeight > 0) || firstJobTile > 0 ||
+		nJobTiles > 0;
+}
+
+// Split the frame between Laser processes sharing jobDirectory, e.g. on
+// several hosts through a network share. The coordinator queues tasks of
+// tilesPerTask tiles, renders tasks itself while merging the pixels workers
+// publish into its image, and requeues tasks whose worker hasn't published
+// them stallSeconds after claiming them. Workers render the same scene and
+// settings, wait for a frame to be queued and leave once it's complete.
+std::string jobDirectory = "";
+bool coordinateJobs = false;
+cl_uint tilesPerTask = 4;
+cl_float stallSeconds = 60.0f;
+
+// Render with spatiotemporal reservoir resampling (ReSTIR) of direct lighting
+// over progressive frames instead of tiled path tracing, and optionally
+// compare its error against tiled path tracing given the same time
+bool useReSTIR = false;
+bool compareReSTIR = false;
+cl_uint restirFrames = 4;
+
+// Sample generation: 0 = independent random, 1 = Owen-scrambled Sobol, 2 =
+// Sobol decorrelated between pixels by a blue noise mask
+cl_uint samplerType = 1;
+cl_uint samplesPerPixel = 64;
+
+// Samples per pixel of each kernel launch, renders split into passes are
+// bit-identical to a single pass
+cl_uint samplesPerPass = 64;
+
+// Render tiles into alternating output buffers, reading back into the image
+// on a separate queue while the next tile renders, instead of a blocking read
+// after each tile. Optionally time both.
+bool asyncTiles = true;
+cl_uint tileBuffers = 2;
+bool compareTilePipelines = false;
+
+// Launch only enough work-groups to fill the device, each taking tiles from a
+// device-side counter until the frame is done, instead of one launch per tile.
+// Optionally time both schedulers at each tile size up to the image's.
+bool persistentTiles = false;
+cl_uint groupsPerComputeUnit = 4;
+bool benchmarkTileScheduling = false;
+
+// Order of a tile's pixels over work items: 0 = rows, 1 = blocks of 8 pixel
+// wide rows, one per work-group, 2 = Morton (Z-order) curve. 2D groups of
+// pixels trace more coherent rays. Optionally time each mapping.
+cl_uint pixelMapping = 2;
+bool benchmarkPixelMappings = false;
+
+// Let each work-group of the Laser kernel walk the top of the BVH once against
+// a frustum bounding its camera rays, so the rays start from the subtrees they
+// can hit instead of each fetching the top nodes from the root
+bool frustumPrimaryRays = false;
+
+// On the first run on a device, time each local work size and tile size of
+// the tile kernel in use for a few samples per pixel and cache the fastest for
+// later runs
+bool autoTune = true;
+cl_uint tuningSamples = 4;
+const cl_uint tuningTileSizes[] = {32, 64, 128, 256};
+const size_t maxTuningLocalSize = 512;
+const std::string tuningCacheFile = "tuning.cfg";
+
+// Share each pixel between up to maxItemsPerPixel work items, each adding a
+// range of its samples, when a tile has too few pixels to give every compute
+// unit itemsPerComputeUnit work items, as for thumbnails and small tiles
+bool sampleParallel = true;
+cl_uint itemsPerComputeUnit = 1024;
+cl_uint maxItemsPerPixel = 16;
+
+// Render tiles on every device of every platform, each device taking the next
+// tile when it finishes one so faster devices render more of the image. CPU
+// devices are split into sub-devices, so this also runs on a CPU-only machine.
+bool multiDevice = false;
+cl_uint cpuSubDevices = 2;
+
+// Kernel rendering tiles, tuned configurations are stored per kernel
+const char *TileKernelName()
+{
+	return persistentTiles ? "LaserPersistent" : "Laser";
+}
+
+// Instead of a single image, measure RMSE of each sampler at increasing sample
+// counts against a high sample count reference and write it to a CSV file
+bool runConvergenceStudy = false;
+cl_uint referenceSamples = 4096;
+cl_uint maxStudySamples = 256;
+
+// Render with separate generate, extend, shade and accumulate kernels
+// communicating through path queues instead of the megakernel, and optionally
+// compare the throughput and output of both
+bool useWavefront = false;
+bool compareWavefront = false;
+
+// Render with both the OpenCL and CPU backends and compare time and output
+bool compareBackends = false;
+
+// Find first hits of the CPU backend's camera rays in packets of neighbouring
+// pixels, and optionally time them against single rays before rendering
+bool cpuPacketTraversal = true;
+bool benchmarkPrimaryRays = false;
+cl_uint primaryRayBenchmarkSamples = 16;
+
+// For LDR output, average, expose, tonemap (0 = clamp, 1 = Reinhard, 2 = ACES
+// filmic), optionally sRGB encode and quantize pixels to 8-bit RGBA on the
+// device after a single render, reading back 4 bytes per pixel instead of 16.
+// The defaults give the same image as the host's image writer.
+bool deviceTonemap = false;
+cl_float exposure = 1.0f;
+cl_uint tonemapOperator = 0;
+bool encodeSRGB = false;
+
+// Whether a mode other than the tile loops renders the image
+bool UsesOtherRenderMode()
+{
+	return runConvergenceStudy || benchmarkTileScheduling ||
+		benchmarkPixelMappings || compareTilePipelines || compareWavefront ||
+		compareBackends || useWavefront || useReSTIR || compareReSTIR ||
+		multiDevice || persistentTiles;
+}
+
 Application::Application()
-	: m_GlobalWorkSize(0), m_LocalWorkSize(64),
-	  m_Image(600, 600, 128, 128, Image::Format::ppm),
+	: m_Backend(Backend::Auto), m_GlobalWorkSize(0), m_LocalWorkSize(64),
+	  m_ItemsPerPixel(1), m_OutputSize(0), m_TuningPending(false),
+	  m_TonemapOnDevice(false),
+	  m_Checkpointing(false), m_FirstPass(0), m_ClaimQueue(nullptr),
+	  m_ClaimedTask(0),
+	  m_Image(600, 600, 128, 128, outputFormat, !streamOutput),
 	  m_Camera(position, target, 75.0f, m_Image.GetProps().AspectRatio,
 		  aperture, focusDistance)
 {
 	m_GlobalWorkSize =
 		m_Image.GetProps().TileHeight * m_Image.GetProps().TileWidth;
+	m_Crop = {0, 0, m_Image.GetProps().Width, m_Image.GetProps().Height};
+	m_OutputFile = std::string("output.") + m_Image.GetFileExtension();
 	m_AppStart = clock();
 }
 
+void Application::SetBackend(Backend backend)
+{
+	m_Backend = backend;
+}
+
 bool Application::Init()
 {
-	// Initialize OpenCL
-	VERIFY(m_OCL.Init());
-	VERIFY(m_OCL.LoadKernel("cl/Laser.cl", "Laser"));
+	// Fall back to the CPU backend if no OpenCL device is usable, unless
+	// OpenCL was requested
+	if (m_Backend != Backend::CPU)
+	{
+		if (InitOpenCL())
+			m_Backend = Backend::OpenCL;
+		else if (m_Backend == Backend::Auto)
+		{
+			std::cout << "Falling back to CPU backend." << std::endl;
+			m_Backend = Backend::CPU;
+		}
+		else
+			return false;
+	}
 
 	// Set image tile rows and columns
 	cl_uint nRows = 0;
@@ -44,6 +249,10 @@ bool Application::Init()
 	m_Image.CalcTileRowsAndColumns(nRows, nColumns);
 	m_Image.SetTileRowsAndColumns(nRows, nColumns);
 
+	// Replace default work-group and tile sizes with tuned ones, if any
+	if (m_Backend == Backend::OpenCL)
+		VERIFY(LoadTuning());
+
 	// Load geometry
 	std::vector<TriangleMesh> meshes;
 	VERIFY(LoadModel("res/models/utah-teapot.obj", meshes, 6, 1));
@@ -87,43 +296,281 @@ bool Application::Init()
 	// Construct BVH
 	m_BVH = BVH(vertices, triangles, transforms);
 
+	// Collect emissive triangles and build light hierarchy for light sampling
+	m_LightList = LightList(m_BVH, m_Materials);
+	m_LightBVH = LightBVH(m_BVH, m_Materials, m_LightList);
+	std::cout << "Emissive triangles: " << m_LightList.m_Lights.size()
+			  << std::endl;
+
+	// Dither mask for blue noise sampling, size must match BLUE_NOISE_SIZE in
+	// cl/Sampler.cl
+	m_BlueNoise = BlueNoise(64, 0);
+
+	if (m_Backend == Backend::CPU || compareBackends)
+	{
+		m_CPURenderer = std::make_unique<CPURenderer>(m_BVH, m_Materials,
+			m_LightList, m_LightBVH, m_BlueNoise, samplerType);
+		m_CPURenderer->SetPacketTraversal(cpuPacketTraversal);
+	}
+
+	return true;
+}
+
+bool Application::InitOpenCL()
+{
+	if (multiDevice)
+	{
+		std::vector<cl::Device> devices;
+		VERIFY(OpenCLContext::GetDevices(devices, cpuSubDevices));
+		VERIFY(m_OCL.Init(devices[0]));
+
+		// Other devices only need the tile kernel
+		m_ExtraOCL.resize(devices.size() - 1);
+		for (size_t i = 1; i < devices.size(); i++)
+		{
+			OpenCLContext &ocl = m_ExtraOCL[i - 1];
+			VERIFY(ocl.Init(devices[i]));
+			VERIFY(ocl.LoadProgram("Laser", "cl/Laser.cl"));
+			VERIFY(ocl.CreateKernels("Laser", {"Laser"}));
+			VERIFY(ocl.AddQueue("transfer", true));
+		}
+	}
+	else
+		VERIFY(m_OCL.Init());
+	VERIFY(m_OCL.LoadProgram("Laser", "cl/Laser.cl"));
+	VERIFY(m_OCL.CreateKernels("Laser",
+		{"Laser", "restirCandidates", "restirSpatial", "restirShade",
+			"wavefrontGenerate", "wavefrontExtend", "wavefrontShade",
+			"wavefrontAccumulate", "wavefrontAdvance", "LaserPersistent",
+			"tonemap"}));
+	VERIFY(m_OCL.AddQueue("transfer", true));
+	VERIFY(m_OCL.AddQueue("readback", false));
+
 	return true;
 }
 
 bool Application::GenBuffers()
 {
-	VERIFY(m_OCL.AddBuffer("output", CL_MEM_WRITE_ONLY,
-		m_GlobalWorkSize * sizeof(cl_float3)));
+	// The CPU backend renders from host memory
+	if (m_Backend == Backend::CPU)
+		return true;
+
+	// The other modes need full frame buffers, which streaming avoids
+	if (streamOutput && UsesOtherRenderMode())
+	{
+		std::cout << "Streamed output only renders with the tile kernel, one "
+					 "tile at a time."
+				  << std::endl;
+		return false;
+	}
+
+	// Output buffers must fit the largest tile tried while tuning
+	size_t outputSize = m_GlobalWorkSize;
+	if (m_TuningPending)
+	{
+		for (cl_uint tileSize : tuningTileSizes)
+			outputSize = std::max<size_t>(outputSize, tileSize * tileSize);
+	}
+	m_OutputSize = outputSize;
+	for (cl_uint i = 1; i < tileBuffers; i++)
+		VERIFY(m_OCL.AddBuffer("output" + std::to_string(i), CL_MEM_WRITE_ONLY,
+			outputSize * sizeof(cl_float3)));
+	VERIFY(GenSceneBuffers(m_OCL, outputSize));
+	for (OpenCLContext &ocl : m_ExtraOCL)
+		VERIFY(GenSceneBuffers(ocl, outputSize));
+
+	// Index of the next tile taken by persistent work-groups
+	VERIFY(m_OCL.AddBuffer("tileCounter", CL_MEM_READ_WRITE, sizeof(cl_uint)));
+
+	size_t nPixels = m_Image.GetProps().Width * m_Image.GetProps().Height;
+
+	// Tonemapped 8-bit pixels for LDR output
+	if (deviceTonemap && !streamOutput)
+		VERIFY(m_OCL.AddBuffer("ldrOutput", CL_MEM_WRITE_ONLY,
+			nPixels * sizeof(cl_uchar4)));
+
+	// Path state and queues for wavefront rendering
+	if (useWavefront || compareWavefront)
+	{
+		VERIFY(m_OCL.AddBuffer("paths", CL_MEM_READ_WRITE,
+			nPixels * sizeof(PathState)));
+		VERIFY(m_OCL.AddBuffer("rayQueue", CL_MEM_READ_WRITE,
+			nPixels * sizeof(cl_uint)));
+		VERIFY(m_OCL.AddBuffer("nextRayQueue", CL_MEM_READ_WRITE,
+			nPixels * sizeof(cl_uint)));
+		VERIFY(m_OCL.AddBuffer("materialQueues", CL_MEM_READ_WRITE,
+			2 * nPixels * sizeof(cl_uint)));
+		VERIFY(m_OCL.AddBuffer("queueCounts", CL_MEM_READ_WRITE,
+			QUEUE_COUNT * sizeof(cl_uint)));
+	}
+
+	// Full frame buffers for ReSTIR
+	if (useReSTIR || compareReSTIR)
+	{
+		VERIFY(m_OCL.AddBuffer("surfaces", CL_MEM_READ_WRITE,
+			nPixels * sizeof(ReservoirSurface)));
+		VERIFY(m_OCL.AddBuffer("reservoirs", CL_MEM_READ_WRITE,
+			nPixels * sizeof(Reservoir)));
+		VERIFY(m_OCL.AddBuffer("spatialReservoirs", CL_MEM_READ_WRITE,
+			nPixels * sizeof(Reservoir)));
+	}
+
+	return true;
+}
+
+// Buffers used by the Laser kernel, created on every device
+bool Application::GenSceneBuffers(OpenCLContext &ocl, size_t outputSize)
+{
+	VERIFY(ocl.AddBuffer("output0", CL_MEM_WRITE_ONLY,
+		outputSize * sizeof(cl_float3)));
 	VERIFY(
-		m_OCL.AddBuffer("imageProps", CL_MEM_READ_ONLY, sizeof(Image::Props)));
-	VERIFY(m_OCL.AddBuffer("cameraProps", CL_MEM_READ_ONLY,
-		sizeof(Camera::Props)));
-	VERIFY(m_OCL.AddBuffer("vertices", CL_MEM_READ_ONLY,
+		ocl.AddBuffer("imageProps", CL_MEM_READ_ONLY, sizeof(Image::Props)));
+	VERIFY(
+		ocl.AddBuffer("cameraProps", CL_MEM_READ_ONLY, sizeof(Camera::Props)));
+	VERIFY(ocl.AddBuffer("vertices", CL_MEM_READ_ONLY,
 		m_BVH.m_Vertices.size() * sizeof(Vertex)));
-	VERIFY(m_OCL.AddBuffer("triangles", CL_MEM_READ_ONLY,
+	VERIFY(ocl.AddBuffer("triangles", CL_MEM_READ_ONLY,
 		m_BVH.m_Triangles.size() * sizeof(Triangle)));
-	VERIFY(m_OCL.AddBuffer("materials", CL_MEM_READ_ONLY,
+	VERIFY(ocl.AddBuffer("materials", CL_MEM_READ_ONLY,
 		m_Materials.size() * sizeof(Material)));
-	VERIFY(m_OCL.AddBuffer("transforms", CL_MEM_READ_ONLY,
+	VERIFY(ocl.AddBuffer("transforms", CL_MEM_READ_ONLY,
 		m_BVH.m_Transforms.size() * sizeof(glm::mat4)));
-	VERIFY(m_OCL.AddBuffer("bvh", CL_MEM_READ_ONLY,
+	VERIFY(ocl.AddBuffer("bvh", CL_MEM_READ_ONLY,
 		m_BVH.m_BVHLinearNodes.size() * sizeof(BVH::BVHLinearNode)));
-	VERIFY(m_OCL.AddBuffer("stats", CL_MEM_READ_WRITE, sizeof(m_RenderStats)));
+	// Buffers can't be empty, so allocate at least one light
+	VERIFY(ocl.AddBuffer("lights", CL_MEM_READ_ONLY,
+		std::max<size_t>(m_LightList.m_Lights.size(), 1) * sizeof(Light)));
+	VERIFY(ocl.AddBuffer("lightBVH", CL_MEM_READ_ONLY,
+		std::max<size_t>(m_LightBVH.m_Nodes.size(), 1) *
+			sizeof(LightBVH::LightBVHNode)));
+	VERIFY(ocl.AddBuffer("lightAliasTable", CL_MEM_READ_ONLY,
+		std::max<size_t>(m_LightList.m_AliasTable.size(), 1) *
+			sizeof(LightAliasEntry)));
+	VERIFY(ocl.AddBuffer("triangleLights", CL_MEM_READ_ONLY,
+		m_LightList.m_TriangleLights.size() * sizeof(cl_uint)));
+	VERIFY(ocl.AddBuffer("stats", CL_MEM_READ_WRITE, sizeof(m_RenderStats)));
+	VERIFY(ocl.AddBuffer("blueNoise", CL_MEM_READ_ONLY,
+		m_BlueNoise.m_Mask.size() * sizeof(cl_float)));
+
+	// Running sum of samples of each pixel, or of each pixel of the tile being
+	// rendered when streaming
+	size_t nPixels = m_Image.GetProps().Width * m_Image.GetProps().Height;
+	VERIFY(ocl.AddBuffer("accumulation", CL_MEM_READ_WRITE,
+		(streamOutput ? outputSize : nPixels) * sizeof(cl_float3)));
 
 	return true;
 }
 
 bool Application::SetKernelArgs()
 {
-	VERIFY(m_OCL.SetKernelArg(0, "output"));
-	VERIFY(m_OCL.SetKernelArg(1, "imageProps"));
-	VERIFY(m_OCL.SetKernelArg(2, "cameraProps"));
-	VERIFY(m_OCL.SetKernelArg(3, "vertices"));
-	VERIFY(m_OCL.SetKernelArg(4, "triangles"));
-	VERIFY(m_OCL.SetKernelArg(5, "materials"));
-	VERIFY(m_OCL.SetKernelArg(6, "transforms"));
-	VERIFY(m_OCL.SetKernelArg(7, "bvh"));
-	VERIFY(m_OCL.SetKernelArg(8, "stats"));
+	if (m_Backend == Backend::CPU)
+		return true;
+
+	VERIFY(SetLaserKernelArgs(m_OCL));
+	for (OpenCLContext &ocl : m_ExtraOCL)
+		VERIFY(SetLaserKernelArgs(ocl));
+
+	VERIFY(m_OCL.SetKernelArg("LaserPersistent", 0, "imageProps"));
+	VERIFY(m_OCL.SetKernelArg("LaserPersistent", 1, "cameraProps"));
+	VERIFY(SetSceneKernelArgs(m_OCL, "LaserPersistent", 2));
+	VERIFY(m_OCL.SetKernelArg("LaserPersistent", 19, "accumulation"));
+	VERIFY(m_OCL.SetKernelArg("LaserPersistent", 20, "tileCounter"));
+	VERIFY(m_OCL.SetKernelArg("LaserPersistent", 21, pixelMapping));
+
+	if (deviceTonemap && !streamOutput)
+	{
+		VERIFY(m_OCL.SetKernelArg("tonemap", 0, "imageProps"));
+		VERIFY(m_OCL.SetKernelArg("tonemap", 1, "accumulation"));
+		VERIFY(m_OCL.SetKernelArg("tonemap", 2, "ldrOutput"));
+		VERIFY(m_OCL.SetKernelArg("tonemap", 4, exposure));
+		VERIFY(m_OCL.SetKernelArg("tonemap", 5, tonemapOperator));
+		VERIFY(m_OCL.SetKernelArg("tonemap", 6, (cl_uint)encodeSRGB));
+	}
+
+	if (useReSTIR || compareReSTIR)
+	{
+		// ReSTIR passes share image, camera, scene and surface arguments
+		for (const char *kernelName :
+			{"restirCandidates", "restirSpatial", "restirShade"})
+		{
+			VERIFY(m_OCL.SetKernelArg(kernelName, 0, "imageProps"));
+			VERIFY(m_OCL.SetKernelArg(kernelName, 1, "cameraProps"));
+			VERIFY(SetSceneKernelArgs(m_OCL, kernelName, 2));
+			VERIFY(m_OCL.SetKernelArg(kernelName, 16, "surfaces"));
+		}
+
+		// Candidates are written to "reservoirs" and reuse the previous
+		// frame's final "spatialReservoirs", which are shaded
+		VERIFY(m_OCL.SetKernelArg("restirCandidates", 17, "reservoirs"));
+		VERIFY(
+			m_OCL.SetKernelArg("restirCandidates", 18, "spatialReservoirs"));
+		VERIFY(m_OCL.SetKernelArg("restirSpatial", 17, "reservoirs"));
+		VERIFY(m_OCL.SetKernelArg("restirSpatial", 18, "spatialReservoirs"));
+		VERIFY(m_OCL.SetKernelArg("restirShade", 17, "spatialReservoirs"));
+		VERIFY(m_OCL.SetKernelArg("restirShade", 18, "accumulation"));
+	}
+
+	if (useWavefront || compareWavefront)
+	{
+		// Wavefront passes share image, camera, scene and path arguments
+		for (const char *kernelName :
+			{"wavefrontGenerate", "wavefrontExtend", "wavefrontShade",
+				"wavefrontAccumulate"})
+		{
+			VERIFY(m_OCL.SetKernelArg(kernelName, 0, "imageProps"));
+			VERIFY(m_OCL.SetKernelArg(kernelName, 1, "cameraProps"));
+			VERIFY(SetSceneKernelArgs(m_OCL, kernelName, 2));
+			VERIFY(m_OCL.SetKernelArg(kernelName, 16, "paths"));
+		}
+
+		// Ray queues are swapped each bounce in RenderWavefront
+		VERIFY(m_OCL.SetKernelArg("wavefrontGenerate", 17, "rayQueue"));
+		VERIFY(m_OCL.SetKernelArg("wavefrontExtend", 18, "queueCounts"));
+		VERIFY(m_OCL.SetKernelArg("wavefrontExtend", 19, "materialQueues"));
+		VERIFY(m_OCL.SetKernelArg("wavefrontShade", 17, "materialQueues"));
+		VERIFY(m_OCL.SetKernelArg("wavefrontShade", 18, "queueCounts"));
+		VERIFY(m_OCL.SetKernelArg("wavefrontAdvance", 0, "queueCounts"));
+		VERIFY(m_OCL.SetKernelArg("wavefrontAccumulate", 17, "accumulation"));
+	}
+
+	return true;
+}
+
+bool Application::SetLaserKernelArgs(OpenCLContext &ocl)
+{
+	VERIFY(ocl.SetKernelArg("Laser", 0, "output0"));
+	VERIFY(ocl.SetKernelArg("Laser", 1, "imageProps"));
+	VERIFY(ocl.SetKernelArg("Laser", 2, "cameraProps"));
+	VERIFY(SetSceneKernelArgs(ocl, "Laser", 3));
+	VERIFY(ocl.SetKernelArg("Laser", 22, "accumulation"));
+	VERIFY(ocl.SetKernelArg("Laser", 23, (cl_uint)frustumPrimaryRays));
+	VERIFY(ocl.SetKernelArg("Laser", 24, pixelMapping));
+	VERIFY(ocl.SetKernelArg("Laser", 25, (cl_uint)1));
+	VERIFY(ocl.SetLocalKernelArg("Laser", 26, sizeof(cl_float3)));
+	VERIFY(ocl.SetKernelArg("Laser", 27, (cl_uint)streamOutput));
+
+	return true;
+}
+
+bool Application::SetSceneKernelArgs(OpenCLContext &ocl,
+	const std::string &kernelName, cl_uint firstIndex)
+{
+	cl_uint i = firstIndex;
+	VERIFY(ocl.SetKernelArg(kernelName, i++, "vertices"));
+	VERIFY(ocl.SetKernelArg(kernelName, i++, "triangles"));
+	VERIFY(ocl.SetKernelArg(kernelName, i++, "materials"));
+	VERIFY(ocl.SetKernelArg(kernelName, i++, "transforms"));
+	VERIFY(ocl.SetKernelArg(kernelName, i++, "bvh"));
+	VERIFY(ocl.SetKernelArg(kernelName, i++, "lights"));
+	VERIFY(ocl.SetKernelArg(kernelName, i++,
+		(cl_uint)m_LightList.m_Lights.size()));
+	VERIFY(ocl.SetKernelArg(kernelName, i++, m_LightList.m_TotalArea));
+	VERIFY(ocl.SetKernelArg(kernelName, i++, "lightBVH"));
+	VERIFY(ocl.SetKernelArg(kernelName, i++, "lightAliasTable"));
+	VERIFY(ocl.SetKernelArg(kernelName, i++, "triangleLights"));
+	VERIFY(ocl.SetKernelArg(kernelName, i++, "stats"));
+	VERIFY(ocl.SetKernelArg(kernelName, i++, "blueNoise"));
+	VERIFY(ocl.SetKernelArg(kernelName, i++, samplerType));
 
 	return true;
 }
@@ -134,68 +581,107 @@ bool Application::Render()
 	// clock_t timeStart = clock();
 	m_RenderStart = clock();
 
-	Image::Props imageProps = m_Image.GetProps();
-	Camera::Props cameraProps = m_Camera.GetProps();
+	if (m_Backend == Backend::CPU)
+	{
+		if (streamOutput)
+		{
+			std::cout << "Streamed output needs the OpenCL backend."
+					  << std::endl;
+			return false;
+		}
+		if (IsRenderJob() || !jobDirectory.empty())
+		{
+			std::cout << "Crop, tile-range and shared frame jobs need the "
+						 "OpenCL backend."
+					  << std::endl;
+			return false;
+		}
 
-	// Write scene data to OpenCL buffers
-	VERIFY(m_OCL.QueueWrite("imageProps", CL_TRUE, 0, sizeof(Image::Props),
-		&imageProps));
-	VERIFY(m_OCL.QueueWrite("cameraProps", CL_TRUE, 0, sizeof(Camera::Props),
-		&cameraProps));
-	VERIFY(m_OCL.QueueWrite("vertices", CL_TRUE, 0,
-		m_BVH.m_Vertices.size() * sizeof(Vertex), m_BVH.m_Vertices.data()));
-	VERIFY(m_OCL.QueueWrite("triangles", CL_TRUE, 0,
-		m_BVH.m_Triangles.size() * sizeof(Triangle), m_BVH.m_Triangles.data()));
-	VERIFY(m_OCL.QueueWrite("materials", CL_TRUE, 0,
-		m_Materials.size() * sizeof(Material), m_Materials.data()));
-	VERIFY(m_OCL.QueueWrite("transforms", CL_TRUE, 0,
-		m_BVH.m_Transforms.size() * sizeof(glm::mat4),
-		m_BVH.m_Transforms.data()));
-	VERIFY(m_OCL.QueueWrite("bvh", CL_TRUE, 0,
-		m_BVH.m_BVHLinearNodes.size() * sizeof(BVH::BVHLinearNode),
-		m_BVH.m_BVHLinearNodes.data()));
+		if (benchmarkPrimaryRays)
+			m_CPURenderer->BenchmarkPrimaryRays(m_Image, m_Camera.GetProps(),
+				primaryRayBenchmarkSamples);
 
-	Image::Props props = m_Image.GetProps();
-	// Execute kernel for each tile
-	for (int k = 0; k < props.nRows * props.nColumns; k++)
+		m_CPURenderer->Render(m_Image, m_Camera.GetProps(), samplesPerPixel,
+			0);
+		m_RenderEnd = clock();
+		return true;
+	}
+
+	VERIFY(UploadScene(m_OCL));
+
+	// Checkpoints are saved between passes, which are shortened before the
+	// work items sharing each pass's samples are chosen
+	m_Checkpointing = checkpointRenders && !runConvergenceStudy &&
+		!benchmarkTileScheduling && !benchmarkPixelMappings &&
+		!compareTilePipelines && !compareWavefront && !compareBackends &&
+		!multiDevice && !streamOutput && !useWavefront && !useReSTIR &&
+		!compareReSTIR && jobDirectory.empty();
+	if (m_Checkpointing)
 	{
-		// Create tile
-		Image::Tile tile(props.TileWidth, props.TileHeight);
+		samplesPerPass = std::min(samplesPerPass, checkpointSamplesPerPass);
+		if (samplesPerPass >= samplesPerPixel)
+			std::cout << "The render is a single pass, so no checkpoints will "
+						 "be saved."
+					  << std::endl;
+	}
 
-		// Calculate current tile offsets
-		cl_uint tileX = k % props.nRows;
-		cl_uint tileY = k / props.nRows;
+	// Tuning renders the whole image for every candidate, which streamed
+	// renders are too large for
+	if (m_TuningPending && !streamOutput)
+		VERIFY(RunAutoTune());
+	VERIFY(ChooseItemsPerPixel());
 
-		cl_uint xOffset = tileX * props.TileWidth;
-		cl_uint yOffset = tileY * props.TileHeight;
+	// Other devices render with the tuned tile size of the first
+	for (OpenCLContext &ocl : m_ExtraOCL)
+		VERIFY(UploadScene(ocl));
 
-		// Send per-tile offsets to OpenCL device
-		VERIFY(m_OCL.SetKernelArg(9, xOffset));
-		VERIFY(m_OCL.SetKernelArg(10, yOffset));
+	// Jobs are planned in the tile grid of the tuned tile size
+	VERIFY(PlanJob());
 
-		// Execute kernel
-		VERIFY(m_OCL.QueueKernel(NULL, m_GlobalWorkSize, m_LocalWorkSize));
+	// Only a single render on one device leaves the whole image in its
+	// running sums, comparisons and benchmarks also need the radiance
+	m_TonemapOnDevice = deviceTonemap && !runConvergenceStudy &&
+		!benchmarkTileScheduling && !benchmarkPixelMappings &&
+		!compareTilePipelines && !compareWavefront && !compareBackends &&
+		!compareReSTIR && !multiDevice && !streamOutput && !patchOutput &&
+		jobDirectory.empty();
+	VERIFY(ResumeCheckpoint(samplesPerPixel, 0));
 
-		// Read result to current tile
-		VERIFY(m_OCL.QueueRead("output", CL_TRUE, 0,
-			m_GlobalWorkSize * sizeof(cl_float3), tile.Pixels.data()));
+	// Streamed renders don't hold an image for the other modes to use
+	if (!jobDirectory.empty())
+		VERIFY(RenderSharedFrame());
+	else if (streamOutput)
+		VERIFY(RenderTilesStreamed(samplesPerPixel, 0));
+	else if (runConvergenceStudy)
+		VERIFY(RenderConvergenceStudy());
+	else if (benchmarkTileScheduling)
+		VERIFY(RenderTileSchedulingBenchmark());
+	else if (benchmarkPixelMappings)
+		VERIFY(RenderPixelMappingBenchmark());
+	else if (compareTilePipelines)
+		VERIFY(RenderTilePipelineComparison());
+	else if (compareWavefront)
+		VERIFY(RenderWavefrontComparison());
+	else if (compareBackends)
+		VERIFY(RenderBackendComparison());
+	else if (compareReSTIR)
+		VERIFY(RenderReSTIRComparison());
+	else if (useWavefront)
+		VERIFY(RenderWavefront(samplesPerPixel, 0));
+	else if (useReSTIR)
+		VERIFY(RenderReSTIR());
+	else if (multiDevice)
+		VERIFY(RenderMultiDevice(samplesPerPixel, 0));
+	else if (persistentTiles)
+		VERIFY(RenderPersistent(samplesPerPixel, 0));
+	else
+		VERIFY(RenderTiles(samplesPerPixel, 0));
 
-		// Merge tile into image
-		for (int j = 0; j < props.TileHeight; j++)
-		{
-			int y = yOffset + j;
-			if (y == props.Height)
-				break;
-			for (int i = 0; i < props.TileWidth; i++)
-			{
-				int x = xOffset + i;
-				if (x == props.Width)
-					break;
-				m_Image.m_Pixels[y][x] = tile.Pixels[j * props.TileWidth + i];
-			}
-		}
-		std::cout << "Done tile " << k + 1 << " of "
-				  << props.nColumns * props.nRows << std::endl;
+	if (m_Checkpointing)
+	{
+		VERIFY(m_Checkpoint.Wait());
+		m_Checkpoint.Remove(checkpointFile);
+		m_FirstPass = 0;
 	}
 
 	// clock_t timeEnd = clock();
@@ -209,25 +695,1726 @@ bool Application::Render()
 	return true;
 }
 
-bool Application::WriteOutput()
+bool Application::UploadScene(OpenCLContext &ocl)
 {
-	// TODO: write render stats here
-	// Write render stats to console
-	/*std::cout << "Render time:                " << stats.RenderTime << "
-	seconds" << std::endl; std::cout << "Primary rays:               " <<
-	stats.n_PrimaryRays << std::endl; std::cout << "Ray-triangle tests: " <<
-	stats.n_RayTriangleTests << std::endl; std::cout << "Ray-triangle
-	intersections: " << stats.n_RayTriangleIsects << std::endl << std::endl;*/
+	Image::Props imageProps = m_Image.GetProps();
+	Camera::Props cameraProps = m_Camera.GetProps();
 
-	// Write image to file
-	VERIFY(m_Image.WriteToFile("output.ppm"));
+	// Write scene data to OpenCL buffers on an out-of-order queue so the
+	// transfers can overlap, then wait for all of them before rendering
+	std::vector<cl::Event> uploads;
+	auto upload = [&](const std::string &bufferKey, size_t size,
+					  const void *data)
+	{
+		uploads.emplace_back();
+		return ocl.QueueWrite(bufferKey, CL_FALSE, 0, size, data, nullptr,
+			&uploads.back(), "transfer");
+	};
+	VERIFY(upload("imageProps", sizeof(Image::Props), &imageProps));
+	VERIFY(upload("cameraProps", sizeof(Camera::Props), &cameraProps));
 
-	m_AppEnd = clock();
-	std::cout << "App time: " << (float)(m_AppEnd - m_AppStart) / CLOCKS_PER_SEC
-			  << "s." << std::endl;
-	std::cout << "Render time: "
-			  << (float)(m_RenderEnd - m_RenderStart) / CLOCKS_PER_SEC << "s."
-			  << std::endl;
+	// Scene buffers stay on the devices between renders of the same process,
+	// such as the render server's jobs, so only the elements edited since a
+	// device's last upload are written
+	auto uploadChanged = [&](const std::string &bufferKey, size_t elementSize,
+							 size_t count, const void *data)
+	{
+		size_t first = 0;
+		size_t nChanged = 0;
+		bool all = false;
+		m_SceneVersions.GetDirtyRange(bufferKey,
+			ocl.GetBufferVersion(bufferKey), first, nChanged, all);
+		if (all)
+		{
+			first = 0;
+			nChanged = count;
+		}
+		if (nChanged > 0)
+		{
+			uploads.emplace_back();
+			VERIFY(ocl.QueueWrite(bufferKey, CL_FALSE, first * elementSize,
+				nChanged * elementSize,
+				(const char *)data + first * elementSize, nullptr,
+				&uploads.back(), "transfer"));
+		}
+		ocl.SetBufferVersion(bufferKey, m_SceneVersions.GetVersion(bufferKey));
+		return true;
+	};
+	VERIFY(uploadChanged("vertices", sizeof(Vertex), m_BVH.m_Vertices.size(),
+		m_BVH.m_Vertices.data()));
+	VERIFY(uploadChanged("triangles", sizeof(Triangle),
+		m_BVH.m_Triangles.size(), m_BVH.m_Triangles.data()));
+	VERIFY(uploadChanged("materials", sizeof(Material), m_Materials.size(),
+		m_Materials.data()));
+	VERIFY(uploadChanged("transforms", sizeof(glm::mat4),
+		m_BVH.m_Transforms.size(), m_BVH.m_Transforms.data()));
+	VERIFY(uploadChanged("bvh", sizeof(BVH::BVHLinearNode),
+		m_BVH.m_BVHLinearNodes.size(), m_BVH.m_BVHLinearNodes.data()));
+	VERIFY(uploadChanged("lights", sizeof(Light), m_LightList.m_Lights.size(),
+		m_LightList.m_Lights.data()));
+	VERIFY(uploadChanged("lightBVH", sizeof(LightBVH::LightBVHNode),
+		m_LightBVH.m_Nodes.size(), m_LightBVH.m_Nodes.data()));
+	VERIFY(uploadChanged("lightAliasTable", sizeof(LightAliasEntry),
+		m_LightList.m_AliasTable.size(), m_LightList.m_AliasTable.data()));
+	VERIFY(uploadChanged("triangleLights", sizeof(cl_uint),
+		m_LightList.m_TriangleLights.size(),
+		m_LightList.m_TriangleLights.data()));
+	VERIFY(uploadChanged("blueNoise", sizeof(cl_float),
+		m_BlueNoise.m_Mask.size(), m_BlueNoise.m_Mask.data()));
+	VERIFY(ocl.WaitForEvents(uploads));
+
+	return true;
+}
+
+bool Application::ReadTile(OpenCLContext &ocl, const std::string &output,
+	cl_uint xOffset, cl_uint yOffset, cl_bool blocking,
+	const std::vector<cl::Event> *waitEvents, cl::Event *event,
+	const std::string &queueName)
+{
+	// Tile rows are TileWidth pixels apart in the output buffer and Width
+	// apart in the image, so one rectangular read puts the tile in place
+	Image::Props props = m_Image.GetProps();
+	cl_uint width = 0;
+	cl_uint height = 0;
+	m_Image.CalcTileRegion(xOffset, yOffset, width, height);
+	return ocl.QueueReadRect(output, blocking, width * sizeof(cl_float3),
+		height, props.TileWidth * sizeof(cl_float3),
+		props.Width * sizeof(cl_float3),
+		&m_Image.m_Pixels[yOffset * props.Width + xOffset], waitEvents, event,
+		queueName);
+}
+
+bool Application::RenderTiles(cl_uint nSamples, cl_uint firstSample)
+{
+	if (asyncTiles)
+	{
+		VERIFY(RenderTilesAsync(nSamples, firstSample));
+	}
+	else
+	{
+		VERIFY(RenderTilesSerial(nSamples, firstSample));
+	}
+
+	if (m_TonemapOnDevice)
+		VERIFY(TonemapOnDevice(1.0f / nSamples));
+
+	return true;
+}
+
+bool Application::ReadAccumulation(cl_float scale)
+{
+	// With device tonemapping only the 8-bit pixels are read back
+	if (m_TonemapOnDevice)
+		return TonemapOnDevice(scale);
+
+	// Read running sums into the image and average in place
+	std::vector<cl_float3> &pixels = m_Image.m_Pixels;
+	VERIFY(m_OCL.QueueRead("accumulation", CL_TRUE, 0,
+		pixels.size() * sizeof(cl_float3), pixels.data()));
+	for (cl_float3 &pixel : pixels)
+		pixel = {pixel.x * scale, pixel.y * scale, pixel.z * scale};
+
+	return true;
+}
+
+bool Application::TonemapOnDevice(cl_float scale)
+{
+	Image::Props props = m_Image.GetProps();
+	size_t nPixels = props.Width * props.Height;
+	size_t globalWorkSize =
+		(nPixels + m_LocalWorkSize - 1) / m_LocalWorkSize * m_LocalWorkSize;
+
+	// Runs after the render's kernels on the same in-order queue
+	VERIFY(m_OCL.SetKernelArg("tonemap", 3, scale));
+	VERIFY(m_OCL.QueueKernel("tonemap", NULL, globalWorkSize,
+		m_LocalWorkSize));
+
+	m_Image.m_LDRPixels.resize(nPixels);
+	VERIFY(m_OCL.QueueRead("ldrOutput", CL_TRUE, 0,
+		nPixels * sizeof(cl_uchar4), m_Image.m_LDRPixels.data()));
+
+	return true;
+}
+
+bool Application::SetPassKernelArgs(OpenCLContext &ocl,
+	const std::string &kernelName, cl_uint firstIndex, cl_uint pass,
+	cl_uint nSamples, cl_uint firstSample)
+{
+	// Each pass adds its samples to the running sum of each pixel, so the image
+	// holds the average of all samples so far after every pass
+	cl_uint nAccumulatedSamples = pass * samplesPerPass;
+	cl_uint nPassSamples =
+		std::min(samplesPerPass, nSamples - nAccumulatedSamples);
+	VERIFY(ocl.SetKernelArg(kernelName, firstIndex, nPassSamples));
+	VERIFY(ocl.SetKernelArg(kernelName, firstIndex + 1,
+		firstSample + nAccumulatedSamples));
+	VERIFY(ocl.SetKernelArg(kernelName, firstIndex + 2, nAccumulatedSamples));
+
+	return true;
+}
+
+bool Application::RenderTilesSerial(cl_uint nSamples, cl_uint firstSample)
+{
+	Image::Props props = m_Image.GetProps();
+	std::vector<cl_uint> tiles = GetTiles();
+	VERIFY(m_OCL.SetKernelArg("Laser", 0, "output0"));
+
+	cl_uint nPasses = (nSamples + samplesPerPass - 1) / samplesPerPass;
+	for (cl_uint pass = m_FirstPass; pass < nPasses; pass++)
+	{
+		VERIFY(SetPassKernelArgs(m_OCL, "Laser", 19, pass, nSamples,
+			firstSample));
+
+		// Execute kernel for each tile
+		for (cl_uint i = 0; i < tiles.size(); i++)
+		{
+			// Calculate current tile offsets
+			cl_uint k = tiles[i];
+			cl_uint tileX = k % props.nRows;
+			cl_uint tileY = k / props.nRows;
+
+			cl_uint xOffset = tileX * props.TileWidth;
+			cl_uint yOffset = tileY * props.TileHeight;
+
+			// Send per-tile offsets to OpenCL device
+			VERIFY(m_OCL.SetKernelArg("Laser", 17, xOffset));
+			VERIFY(m_OCL.SetKernelArg("Laser", 18, yOffset));
+
+			// Execute kernel
+			VERIFY(m_OCL.QueueKernel("Laser", NULL,
+				m_GlobalWorkSize * m_ItemsPerPixel, m_LocalWorkSize));
+
+			// Read result into place in the image, unless only the
+			// tonemapped image is read back at the end
+			if (!m_TonemapOnDevice)
+				VERIFY(ReadTile(m_OCL, "output0", xOffset, yOffset, CL_TRUE));
+
+			std::cout << "Done tile " << i + 1 << " of " << tiles.size()
+					  << ", pass " << pass + 1 << " of " << nPasses
+					  << std::endl;
+			Heartbeat();
+		}
+
+		VERIFY(CheckpointPass(pass, nSamples, firstSample));
+	}
+
+	return true;
+}
+
+bool Application::RenderTilesAsync(cl_uint nSamples, cl_uint firstSample)
+{
+	Image::Props props = m_Image.GetProps();
+	std::vector<cl_uint> tiles = GetTiles();
+	cl_uint nTiles = (cl_uint)tiles.size();
+
+	// Tiles cycle through output buffers, each read straight into the image
+	// on the readback queue. A buffer is reused once its last read completes.
+	std::vector<cl::Event> slotReads(tileBuffers);
+	std::vector<std::string> slotLabels(tileBuffers);
+	auto waitSlot = [&](cl_uint slot) -> bool
+	{
+		if (slotLabels[slot].empty())
+			return true;
+		VERIFY(m_OCL.WaitForEvents({slotReads[slot]}));
+		std::cout << slotLabels[slot] << std::endl;
+		slotLabels[slot].clear();
+		return true;
+	};
+
+	cl_uint nPasses = (nSamples + samplesPerPass - 1) / samplesPerPass;
+	for (cl_uint pass = m_FirstPass; pass < nPasses; pass++)
+	{
+		VERIFY(SetPassKernelArgs(m_OCL, "Laser", 19, pass, nSamples,
+			firstSample));
+
+		for (cl_uint i = 0; i < nTiles; i++)
+		{
+			cl_uint slot = (pass * nTiles + i) % tileBuffers;
+			std::string output = "output" + std::to_string(slot);
+			VERIFY(waitSlot(slot));
+
+			// Calculate current tile offsets
+			cl_uint k = tiles[i];
+			cl_uint xOffset = (k % props.nRows) * props.TileWidth;
+			cl_uint yOffset = (k / props.nRows) * props.TileHeight;
+
+			VERIFY(m_OCL.SetKernelArg("Laser", 0, output));
+			VERIFY(m_OCL.SetKernelArg("Laser", 17, xOffset));
+			VERIFY(m_OCL.SetKernelArg("Laser", 18, yOffset));
+
+			// Execute kernel, then read back on the readback queue so the next
+			// kernel can start while this tile is transferred
+			cl::Event kernelEvent;
+			VERIFY(m_OCL.QueueKernel("Laser", NULL,
+				m_GlobalWorkSize * m_ItemsPerPixel, m_LocalWorkSize, nullptr,
+				&kernelEvent));
+
+			// Without a read, the tile is done when its kernel is
+			std::vector<cl::Event> waitEvents = {kernelEvent};
+			if (m_TonemapOnDevice)
+				slotReads[slot] = kernelEvent;
+			else
+				VERIFY(ReadTile(m_OCL, output, xOffset, yOffset, CL_FALSE,
+					&waitEvents, &slotReads[slot], "readback"));
+			slotLabels[slot] = "Done tile " + std::to_string(i + 1) + " of " +
+				std::to_string(nTiles) + ", pass " + std::to_string(pass + 1) +
+				" of " + std::to_string(nPasses);
+
+			VERIFY(m_OCL.Flush());
+			VERIFY(m_OCL.Flush("readback"));
+
+			// Waiting for free output buffers paces the loop to the device
+			Heartbeat();
+		}
+
+		VERIFY(CheckpointPass(pass, nSamples, firstSample));
+	}
+
+	// Wait for the last reads in the order they were queued
+	cl_uint nQueued = nPasses * nTiles;
+	for (cl_uint i = 0; i < tileBuffers; i++)
+		VERIFY(waitSlot((nQueued + i) % tileBuffers));
+
+	return true;
+}
+
+bool Application::RenderTilesStreamed(cl_uint nSamples, cl_uint firstSample)
+{
+	Image::Props props = m_Image.GetProps();
+	std::vector<cl_uint> tiles = GetTiles();
+	cl_uint nTiles = props.nRows * props.nColumns;
+	cl_uint nPasses = (nSamples + samplesPerPass - 1) / samplesPerPass;
+
+	TileFileWriter writer;
+	VERIFY(writer.Open(m_OutputFile, props.Format, props.Width, props.Height,
+		patchOutput));
+
+	// Tiles cycle through output buffers, each with a tile of host memory
+	// that is written to the file while the next tiles render
+	std::vector<std::vector<cl_float3>> slotPixels(tileBuffers,
+		std::vector<cl_float3>(m_GlobalWorkSize));
+	std::vector<cl::Event> slotReads(tileBuffers);
+	std::vector<cl_uint> slotTiles(tileBuffers, nTiles); // nTiles if empty
+	cl_uint nWritten = 0;
+	auto writeSlot = [&](cl_uint slot) -> bool
+	{
+		cl_uint k = slotTiles[slot];
+		if (k == nTiles)
+			return true;
+		VERIFY(m_OCL.WaitForEvents({slotReads[slot]}));
+
+		// Only the part of the tile in the crop of a job is written
+		cl_uint xOffset = (k % props.nRows) * props.TileWidth;
+		cl_uint yOffset = (k / props.nRows) * props.TileHeight;
+		Image::Region region = CalcJobTileRegion(k);
+		size_t first = (region.y - yOffset) * props.TileWidth +
+			(region.x - xOffset);
+		VERIFY(writer.WriteTile(&slotPixels[slot][first], props.TileWidth,
+			region.x, region.y, region.Width, region.Height));
+		slotTiles[slot] = nTiles;
+
+		std::cout << "Done tile " << ++nWritten << " of " << tiles.size()
+				  << std::endl;
+		return true;
+	};
+
+	for (cl_uint i = 0; i < tiles.size(); i++)
+	{
+		cl_uint slot = i % tileBuffers;
+		std::string output = "output" + std::to_string(slot);
+		VERIFY(writeSlot(slot));
+
+		cl_uint k = tiles[i];
+		cl_uint xOffset = (k % props.nRows) * props.TileWidth;
+		cl_uint yOffset = (k / props.nRows) * props.TileHeight;
+		VERIFY(m_OCL.SetKernelArg("Laser", 0, output));
+		VERIFY(m_OCL.SetKernelArg("Laser", 17, xOffset));
+		VERIFY(m_OCL.SetKernelArg("Laser", 18, yOffset));
+
+		// The running sums only hold this tile, so render all of its passes
+		cl::Event kernelEvent;
+		for (cl_uint pass = 0; pass < nPasses; pass++)
+		{
+			VERIFY(SetPassKernelArgs(m_OCL, "Laser", 19, pass, nSamples,
+				firstSample));
+			VERIFY(m_OCL.QueueKernel("Laser", NULL,
+				m_GlobalWorkSize * m_ItemsPerPixel, m_LocalWorkSize, nullptr,
+				&kernelEvent));
+		}
+
+		std::vector<cl::Event> waitEvents = {kernelEvent};
+		VERIFY(m_OCL.QueueRead(output, CL_FALSE, 0,
+			m_GlobalWorkSize * sizeof(cl_float3), slotPixels[slot].data(),
+			&waitEvents, &slotReads[slot], "readback"));
+		slotTiles[slot] = k;
+		VERIFY(m_OCL.Flush());
+		VERIFY(m_OCL.Flush("readback"));
+
+		// Write the previous tile while this one renders
+		if (i > 0)
+			VERIFY(writeSlot((i - 1) % tileBuffers));
+	}
+
+	for (cl_uint i = 0; i < tileBuffers; i++)
+		VERIFY(writeSlot((tiles.size() + i) % tileBuffers));
+
+	return writer.Close();
+}
+
+bool Application::PlanJob()
+{
+	Image::Props props = m_Image.GetProps();
+	cl_uint nTiles = props.nRows * props.nColumns;
+	m_JobTiles.clear();
+	m_Crop = {0, 0, props.Width, props.Height};
+	m_Image.SetOutputRegion(m_Crop);
+	if (!IsRenderJob())
+		return true;
+
+	if (UsesOtherRenderMode())
+	{
+		std::cout << "Crop and tile-range jobs only render with the tile "
+					 "kernel, one launch per tile."
+				  << std::endl;
+		return false;
+	}
+	if (streamOutput && !patchOutput)
+	{
+		std::cout << "Streamed jobs write their tiles into a full image file, "
+					 "which needs patchOutput."
+				  << std::endl;
+		return false;
+	}
+
+	if (cropWidth > 0 && cropHeight > 0)
+	{
+		if (cropX + cropWidth > props.Width ||
+			cropY + cropHeight > props.Height)
+		{
+			std::cout << "Crop is outside the " << props.Width << "x"
+					  << props.Height << " image." << std::endl;
+			return false;
+		}
+		m_Crop = {cropX, cropY, cropWidth, cropHeight};
+	}
+
+	cl_uint lastTile = nJobTiles > 0 ? firstJobTile + nJobTiles : nTiles;
+	if (firstJobTile >= nTiles || lastTile > nTiles)
+	{
+		std::cout << "Tile range is outside the image's " << nTiles
+				  << " tiles." << std::endl;
+		return false;
+	}
+
+	// Output the bounds of the pixels of the job's tiles in the crop
+	cl_uint x0 = props.Width;
+	cl_uint y0 = props.Height;
+	cl_uint x1 = 0;
+	cl_uint y1 = 0;
+	for (cl_uint k = firstJobTile; k < lastTile; k++)
+	{
+		Image::Region region = CalcJobTileRegion(k);
+		if (region.Width == 0 || region.Height == 0)
+			continue;
+		m_JobTiles.push_back(k);
+		x0 = std::min(x0, region.x);
+		y0 = std::min(y0, region.y);
+		x1 = std::max(x1, region.x + region.Width);
+		y1 = std::max(y1, region.y + region.Height);
+	}
+	if (m_JobTiles.empty())
+	{
+		std::cout << "No tile of the tile range overlaps the crop."
+				  << std::endl;
+		return false;
+	}
+	m_Image.SetOutputRegion({x0, y0, x1 - x0, y1 - y0});
+
+	std::cout << "Rendering " << m_JobTiles.size() << " of " << nTiles
+			  << " tiles, " << x1 - x0 << "x" << y1 - y0 << " pixels at ("
+			  << x0 << ", " << y0 << ")." << std::endl;
+	return true;
+}
+
+std::vector<cl_uint> Application::GetTiles() const
+{
+	if (!m_JobTiles.empty())
+		return m_JobTiles;
+
+	Image::Props props = m_Image.GetProps();
+	std::vector<cl_uint> tiles(props.nRows * props.nColumns);
+	for (cl_uint k = 0; k < tiles.size(); k++)
+		tiles[k] = k;
+	return tiles;
+}
+
+Image::Region Application::CalcJobTileRegion(cl_uint tile) const
+{
+	Image::Props props = m_Image.GetProps();
+	cl_uint xOffset = (tile % props.nRows) * props.TileWidth;
+	cl_uint yOffset = (tile / props.nRows) * props.TileHeight;
+	cl_uint width = 0;
+	cl_uint height = 0;
+	m_Image.CalcTileRegion(xOffset, yOffset, width, height);
+
+	cl_uint x0 = std::max(xOffset, m_Crop.x);
+	cl_uint y0 = std::max(yOffset, m_Crop.y);
+	cl_uint x1 = std::min(xOffset + width, m_Crop.x + m_Crop.Width);
+	cl_uint y1 = std::min(yOffset + height, m_Crop.y + m_Crop.Height);
+	if (x1 <= x0 || y1 <= y0)
+		return {x0, y0, 0, 0};
+	return {x0, y0, x1 - x0, y1 - y0};
+}
+
+bool Application::PatchOutput(const std::string &filepath) const
+{
+	// Write only the job's pixels, leaving the rest of the file as it was
+	Image::Props props = m_Image.GetProps();
+	TileFileWriter writer;
+	VERIFY(writer.Open(filepath, props.Format, props.Width, props.Height,
+		true));
+	for (cl_uint tile : GetTiles())
+	{
+		Image::Region region = CalcJobTileRegion(tile);
+		VERIFY(writer.WriteTile(
+			&m_Image.m_Pixels[region.y * props.Width + region.x], props.Width,
+			region.x, region.y, region.Width, region.Height));
+	}
+
+	return writer.Close();
+}
+
+bool Application::RenderSharedFrame()
+{
+	if (IsRenderJob() || streamOutput || UsesOtherRenderMode())
+	{
+		std::cout << "Shared frames are rendered whole by the tile kernel, "
+					 "one launch per tile."
+				  << std::endl;
+		return false;
+	}
+
+	JobQueue queue(jobDirectory);
+	Image::Props props = m_Image.GetProps();
+	cl_uint nTiles = props.nRows * props.nColumns;
+	JobQueue::Frame frame = {};
+	frame.Render = GetCheckpointHeader(samplesPerPixel, 0);
+	frame.TileWidth = props.TileWidth;
+	frame.TileHeight = props.TileHeight;
+	frame.TilesPerTask = std::max(1u, tilesPerTask);
+	frame.nTasks = (nTiles + frame.TilesPerTask - 1) / frame.TilesPerTask;
+
+	if (!coordinateJobs)
+		return RenderWorkerTasks(queue, frame);
+	VERIFY(queue.Create(frame));
+
+	// Merge published tasks, requeue stalled ones and render waiting tasks
+	// until every task is merged
+	std::vector<bool> merged(frame.nTasks, false);
+	cl_uint nMerged = 0;
+	std::vector<cl_uint> results;
+	std::vector<cl_float3> pixels;
+	while (nMerged < frame.nTasks)
+	{
+		VERIFY(queue.ListResults(results));
+		for (cl_uint task : results)
+		{
+			if (task >= frame.nTasks || merged[task])
+				continue;
+			// Workers still on an earlier frame may publish into this one
+			bool current = false;
+			VERIFY(queue.ReadResult(task, frame.ID, pixels, current));
+			if (!current)
+			{
+				std::cout << "Requeued task " << task + 1
+						  << " published for another frame." << std::endl;
+				VERIFY(queue.Requeue(task));
+				continue;
+			}
+			VERIFY(MergeTask(frame, task, pixels));
+			merged[task] = true;
+			nMerged++;
+			std::cout << "Merged task " << task + 1 << ", " << nMerged
+					  << " of " << frame.nTasks << " done" << std::endl;
+		}
+		VERIFY(queue.RequeueStalled(stallSeconds));
+
+		cl_uint task = 0;
+		bool claimed = false;
+		VERIFY(queue.Claim(task, claimed));
+		if (claimed)
+		{
+			VERIFY(RenderTask(queue, frame, task));
+		}
+		else if (nMerged < frame.nTasks)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	}
+
+	return queue.Finish(frame.ID);
+}
+
+bool Application::RenderWorkerTasks(JobQueue &queue,
+	const JobQueue::Frame &frame)
+{
+	std::cout << "Waiting for a frame in " << jobDirectory << "..."
+			  << std::endl;
+	while (true)
+	{
+		// A finished frame is left over from an earlier render
+		JobQueue::Frame queued = {};
+		bool active = false;
+		while (!active)
+		{
+			bool found = false;
+			VERIFY(queue.LoadFrame(queued, found));
+			active = found && !queue.IsFinished(queued.ID);
+			if (!active)
+				std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		}
+
+		// Tiles of another render would silently corrupt the coordinator's
+		// image
+		const Checkpoint::Header &render = queued.Render;
+		if (render.SceneHash != frame.Render.SceneHash ||
+			render.Width != frame.Render.Width ||
+			render.Height != frame.Render.Height ||
+			render.SamplerType != frame.Render.SamplerType ||
+			render.SamplesPerPass != frame.Render.SamplesPerPass ||
+			render.nSamples != frame.Render.nSamples)
+		{
+			std::cout << "Frame in " << jobDirectory
+					  << " is of a different scene or settings." << std::endl;
+			return false;
+		}
+
+		// Tasks are ranges of the coordinator's tiles
+		Image::Props props = m_Image.GetProps();
+		if (queued.TileWidth != props.TileWidth ||
+			queued.TileHeight != props.TileHeight)
+		{
+			if ((size_t)queued.TileWidth * queued.TileHeight > m_OutputSize)
+			{
+				std::cout << "The coordinator's " << queued.TileWidth << "x"
+						  << queued.TileHeight
+						  << " tiles don't fit this worker's output buffers."
+						  << std::endl;
+				return false;
+			}
+			VERIFY(SetTileSize(queued.TileWidth, queued.TileHeight));
+			VERIFY(ChooseItemsPerPixel());
+		}
+
+		while (!queue.IsFinished(queued.ID))
+		{
+			// Stop claiming tasks once the coordinator replaces the frame
+			JobQueue::Frame latest = {};
+			bool found = false;
+			VERIFY(queue.LoadFrame(latest, found));
+			if (!found || latest.ID != queued.ID)
+				break;
+
+			cl_uint task = 0;
+			bool claimed = false;
+			VERIFY(queue.Claim(task, claimed));
+			if (claimed)
+			{
+				VERIFY(RenderTask(queue, queued, task));
+			}
+			else
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+
+		if (queue.IsFinished(queued.ID))
+			break;
+		std::cout << "Frame in " << jobDirectory
+				  << " was replaced, waiting for the new one..." << std::endl;
+	}
+
+	std::cout << "Frame complete." << std::endl;
+	return true;
+}
+
+std::vector<cl_uint> Application::GetTaskTiles(const JobQueue::Frame &frame,
+	cl_uint task) const
+{
+	Image::Props props = m_Image.GetProps();
+	cl_uint nTiles = props.nRows * props.nColumns;
+	cl_uint firstTile = task * frame.TilesPerTask;
+	cl_uint lastTile = std::min(firstTile + frame.TilesPerTask, nTiles);
+
+	std::vector<cl_uint> tiles;
+	for (cl_uint k = firstTile; k < lastTile; k++)
+		tiles.push_back(k);
+	return tiles;
+}
+
+bool Application::RenderTask(JobQueue &queue, const JobQueue::Frame &frame,
+	cl_uint task)
+{
+	// Render only the task's tiles into the image
+	Image::Props props = m_Image.GetProps();
+	m_JobTiles = GetTaskTiles(frame, task);
+	std::cout << "Rendering task " << task + 1 << " of " << frame.nTasks
+			  << std::endl;
+	m_ClaimQueue = &queue;
+	m_ClaimedTask = task;
+	bool rendered = RenderTiles(samplesPerPixel, 0);
+	m_ClaimQueue = nullptr;
+	VERIFY(rendered);
+
+	// Publish the pixels of each tile in turn
+	std::vector<cl_float3> pixels;
+	for (cl_uint tile : m_JobTiles)
+	{
+		Image::Region region = CalcJobTileRegion(tile);
+		for (cl_uint y = region.y; y < region.y + region.Height; y++)
+		{
+			const cl_float3 *row =
+				&m_Image.m_Pixels[y * props.Width + region.x];
+			pixels.insert(pixels.end(), row, row + region.Width);
+		}
+	}
+	m_JobTiles.clear();
+
+	return queue.Publish(task, frame.ID, pixels);
+}
+
+void Application::Heartbeat()
+{
+	// Touched at most once a second, the share may be on a network
+	std::chrono::steady_clock::time_point now =
+		std::chrono::steady_clock::now();
+	if (!m_ClaimQueue || now - m_LastHeartbeat < std::chrono::seconds(1))
+		return;
+	m_LastHeartbeat = now;
+	m_ClaimQueue->Touch(m_ClaimedTask);
+}
+
+bool Application::MergeTask(const JobQueue::Frame &frame, cl_uint task,
+	const std::vector<cl_float3> &pixels)
+{
+	Image::Props props = m_Image.GetProps();
+	std::vector<cl_uint> tiles = GetTaskTiles(frame, task);
+	size_t nPixels = 0;
+	for (cl_uint tile : tiles)
+	{
+		Image::Region region = CalcJobTileRegion(tile);
+		nPixels += (size_t)region.Width * region.Height;
+	}
+	if (pixels.size() != nPixels)
+	{
+		std::cout << "Result of task " << task + 1 << " has " << pixels.size()
+				  << " pixels instead of " << nPixels << "." << std::endl;
+		return false;
+	}
+
+	const cl_float3 *source = pixels.data();
+	for (cl_uint tile : tiles)
+	{
+		Image::Region region = CalcJobTileRegion(tile);
+		for (cl_uint y = region.y; y < region.y + region.Height; y++)
+		{
+			std::copy(source, source + region.Width,
+				&m_Image.m_Pixels[y * props.Width + region.x]);
+			source += region.Width;
+		}
+	}
+
+	return true;
+}
+
+Checkpoint::Header Application::GetCheckpointHeader(cl_uint nSamples,
+	cl_uint firstSample) const
+{
+	// Hash each value rather than whole structs, as padding is uninitialized
+	cl_ulong hash = Checkpoint::Hash(nullptr, 0);
+	auto hashFloat3 = [&](const cl_float3 &v)
+	{
+		hash = Checkpoint::Hash(&v.x, sizeof(cl_float), hash);
+		hash = Checkpoint::Hash(&v.y, sizeof(cl_float), hash);
+		hash = Checkpoint::Hash(&v.z, sizeof(cl_float), hash);
+	};
+	for (const Vertex &vertex : m_BVH.m_Vertices)
+	{
+		hashFloat3(vertex.Position);
+		hashFloat3(vertex.Normal);
+	}
+	for (const Triangle &triangle : m_BVH.m_Triangles)
+	{
+		cl_uint values[5] = {triangle.v0, triangle.v1, triangle.v2,
+			triangle.Material, triangle.Transform};
+		hash = Checkpoint::Hash(values, sizeof(values), hash);
+	}
+	for (const Material &material : m_Materials)
+	{
+		hashFloat3(material.Albedo);
+		hashFloat3(material.Emission);
+		cl_uint values[3] = {(cl_uint)material.IsMetal,
+			(cl_uint)material.IsTransparent, 0};
+		std::memcpy(&values[2], &material.RefractiveIndex, sizeof(cl_float));
+		hash = Checkpoint::Hash(values, sizeof(values), hash);
+	}
+	hash = Checkpoint::Hash(m_BVH.m_Transforms.data(),
+		m_BVH.m_Transforms.size() * sizeof(glm::mat4), hash);
+	hash = Checkpoint::Hash(m_JobTiles.data(),
+		m_JobTiles.size() * sizeof(cl_uint), hash);
+
+	Camera::Props camera = m_Camera.GetProps();
+	hashFloat3(camera.Position);
+	hashFloat3(camera.Target);
+
+	// The focus distance only shows in the size of the viewport
+	hashFloat3(camera.UpperLeftCorner);
+	hashFloat3(camera.ViewportHorizontal);
+	hashFloat3(camera.ViewportVertical);
+	cl_float cameraValues[3] = {camera.VerticalFOV, camera.AspectRatio,
+		camera.LensRadius};
+	hash = Checkpoint::Hash(cameraValues, sizeof(cameraValues), hash);
+
+	Image::Props props = m_Image.GetProps();
+	Checkpoint::Header header = {};
+	header.SceneHash = hash;
+	header.Width = props.Width;
+	header.Height = props.Height;
+	header.SamplerType = samplerType;
+	header.SamplesPerPass = samplesPerPass;
+	header.FirstSample = firstSample;
+	header.nSamples = nSamples;
+	return header;
+}
+
+bool Application::ResumeCheckpoint(cl_uint nSamples, cl_uint firstSample)
+{
+	m_FirstPass = 0;
+	m_LastCheckpoint = std::chrono::steady_clock::now();
+	if (!m_Checkpointing)
+		return true;
+
+	Checkpoint::Header header = GetCheckpointHeader(nSamples, firstSample);
+	std::vector<cl_float3> accumulation;
+	bool found = false;
+	VERIFY(m_Checkpoint.Load(checkpointFile, header, accumulation, found));
+	if (!found)
+		return true;
+
+	VERIFY(m_OCL.QueueWrite("accumulation", CL_TRUE, 0,
+		accumulation.size() * sizeof(cl_float3), accumulation.data()));
+	m_FirstPass = header.nAccumulatedSamples / samplesPerPass;
+	std::cout << "Resuming from checkpoint at " << header.nAccumulatedSamples
+			  << " samples per pixel." << std::endl;
+
+	return true;
+}
+
+bool Application::CheckpointPass(cl_uint pass, cl_uint nSamples,
+	cl_uint firstSample)
+{
+	// Nothing is left to resume after the last pass
+	cl_uint nPasses = (nSamples + samplesPerPass - 1) / samplesPerPass;
+	if (!m_Checkpointing || pass + 1 >= nPasses)
+		return true;
+
+	std::chrono::duration<float> sinceLast =
+		std::chrono::steady_clock::now() - m_LastCheckpoint;
+	if (sinceLast.count() < checkpointSeconds)
+		return true;
+	m_LastCheckpoint = std::chrono::steady_clock::now();
+
+	Checkpoint::Header header = GetCheckpointHeader(nSamples, firstSample);
+	header.nAccumulatedSamples = (pass + 1) * samplesPerPass;
+
+	// Read after the pass's kernels on the in-order queue, so the sums are
+	// complete and the next pass can't change them until read. The host
+	// carries on queueing passes while the file is written.
+	Image::Props props = m_Image.GetProps();
+	size_t nPixels = props.Width * props.Height;
+	std::vector<cl_float3> &buffer = m_Checkpoint.AcquireBuffer(nPixels);
+	cl::Event readEvent;
+	VERIFY(m_OCL.QueueRead("accumulation", CL_FALSE, 0,
+		nPixels * sizeof(cl_float3), buffer.data(), nullptr, &readEvent));
+	VERIFY(m_OCL.Flush());
+
+	return m_Checkpoint.SaveAsync(checkpointFile, header, readEvent);
+}
+
+bool Application::RenderTilePipelineComparison()
+{
+	auto start = std::chrono::steady_clock::now();
+	VERIFY(RenderTilesSerial(samplesPerPixel, 0));
+	std::chrono::duration<float> serialTime =
+		std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	VERIFY(RenderTilesAsync(samplesPerPixel, 0));
+	std::chrono::duration<float> asyncTime =
+		std::chrono::steady_clock::now() - start;
+
+	std::cout << "Serial tile loop: " << serialTime.count() << "s"
+			  << std::endl;
+	std::cout << "Double-buffered tile pipeline: " << asyncTime.count()
+			  << "s (" << serialTime.count() / asyncTime.count()
+			  << "x speedup)" << std::endl;
+
+	return true;
+}
+
+bool Application::RenderPersistent(cl_uint nSamples, cl_uint firstSample)
+{
+	// Enough groups to keep every compute unit busy, tiles are balanced
+	// between them by the counter rather than by the launch
+	size_t globalWorkSize =
+		m_OCL.GetComputeUnits() * groupsPerComputeUnit * m_LocalWorkSize;
+
+	cl_uint nPasses = (nSamples + samplesPerPass - 1) / samplesPerPass;
+	for (cl_uint pass = m_FirstPass; pass < nPasses; pass++)
+	{
+		VERIFY(SetPassKernelArgs(m_OCL, "LaserPersistent", 16, pass,
+			nSamples, firstSample));
+
+		cl_uint tileCounter = 0;
+		VERIFY(m_OCL.QueueWrite("tileCounter", CL_TRUE, 0, sizeof(cl_uint),
+			&tileCounter));
+		VERIFY(m_OCL.QueueKernel("LaserPersistent", NULL, globalWorkSize,
+			m_LocalWorkSize));
+
+		std::cout << "Done pass " << pass + 1 << " of " << nPasses
+				  << std::endl;
+
+		VERIFY(CheckpointPass(pass, nSamples, firstSample));
+	}
+
+	return ReadAccumulation(1.0f / nSamples);
+}
+
+bool Application::SetTileSize(cl_uint tileWidth, cl_uint tileHeight)
+{
+	m_Image.SetTileSize(tileWidth, tileHeight);
+	m_GlobalWorkSize = tileWidth * tileHeight;
+
+	Image::Props imageProps = m_Image.GetProps();
+	VERIFY(m_OCL.QueueWrite("imageProps", CL_TRUE, 0, sizeof(Image::Props),
+		&imageProps));
+
+	return true;
+}
+
+bool Application::LoadTuning()
+{
+	VERIFY(m_TuningCache.Load(tuningCacheFile));
+
+	TuningCache::Entry entry;
+	if (!m_TuningCache.Find(m_OCL.GetDeviceName(), TileKernelName(), entry))
+	{
+		m_TuningPending = autoTune;
+		return true;
+	}
+
+	std::cout << "Using tuned local work size " << entry.LocalWorkSize
+			  << " and " << entry.TileWidth << "x" << entry.TileHeight
+			  << " tiles." << std::endl;
+	m_LocalWorkSize = entry.LocalWorkSize;
+	m_Image.SetTileSize(entry.TileWidth, entry.TileHeight);
+	m_GlobalWorkSize = entry.TileWidth * entry.TileHeight;
+
+	return true;
+}
+
+bool Application::RunAutoTune()
+{
+	std::string device = m_OCL.GetDeviceName();
+	std::string kernelName = TileKernelName();
+
+	// Local sizes are multiples of the preferred multiple (the SIMD width on
+	// most devices) up to the kernel's limit
+	size_t maxWorkGroupSize = 0;
+	size_t preferredMultiple = 0;
+	VERIFY(m_OCL.GetKernelWorkGroupInfo(kernelName, maxWorkGroupSize,
+		preferredMultiple));
+	maxWorkGroupSize = std::min(maxWorkGroupSize, maxTuningLocalSize);
+
+	Image::Props props = m_Image.GetProps();
+	cl_float nRays = (cl_float)props.Width * props.Height * tuningSamples;
+
+	TuningCache::Entry best = {device, kernelName, (cl_uint)m_LocalWorkSize,
+		props.TileWidth, props.TileHeight};
+	cl_float bestRate = 0.0f;
+	std::vector<std::string> results;
+	for (size_t localWorkSize = preferredMultiple;
+		 localWorkSize <= maxWorkGroupSize; localWorkSize *= 2)
+	{
+		for (cl_uint tileSize : tuningTileSizes)
+		{
+			// Tile launches must be a multiple of the work-group size
+			if (tileSize * tileSize % localWorkSize != 0)
+				continue;
+
+			m_LocalWorkSize = localWorkSize;
+			VERIFY(SetTileSize(tileSize, tileSize));
+
+			// Renders end with a blocking read, so times include all work
+			auto start = std::chrono::steady_clock::now();
+			if (persistentTiles)
+			{
+				VERIFY(RenderPersistent(tuningSamples, 0));
+			}
+			else
+			{
+				VERIFY(RenderTiles(tuningSamples, 0));
+			}
+			std::chrono::duration<float> time =
+				std::chrono::steady_clock::now() - start;
+
+			// Camera rays, as secondary rays depend on the scene
+			cl_float rate = nRays / time.count() / 1e6f;
+			results.push_back(std::to_string(localWorkSize) + "\t" +
+				std::to_string(tileSize) + "x" + std::to_string(tileSize) +
+				"\t" + std::to_string(rate));
+			if (rate > bestRate)
+			{
+				bestRate = rate;
+				best.LocalWorkSize = (cl_uint)localWorkSize;
+				best.TileWidth = tileSize;
+				best.TileHeight = tileSize;
+			}
+		}
+	}
+
+	std::cout << "Tuning " << kernelName << " on " << device << std::endl;
+	std::cout << "Local\tTile\tMrays/s" << std::endl;
+	for (const std::string &result : results)
+		std::cout << result << std::endl;
+	std::cout << "Using local work size " << best.LocalWorkSize << " and "
+			  << best.TileWidth << "x" << best.TileHeight << " tiles."
+			  << std::endl;
+
+	m_LocalWorkSize = best.LocalWorkSize;
+	VERIFY(SetTileSize(best.TileWidth, best.TileHeight));
+	m_TuningCache.Store(best);
+	VERIFY(m_TuningCache.Save(tuningCacheFile));
+	m_TuningPending = false;
+
+	return true;
+}
+
+bool Application::RenderTileSchedulingBenchmark()
+{
+	// Output buffers are allocated for the configured tile size, so only
+	// smaller tiles are benchmarked
+	Image::Props props = m_Image.GetProps();
+	cl_uint maxTileSize = std::min(props.TileWidth, props.TileHeight);
+
+	std::vector<std::string> results;
+	for (cl_uint tileSize = 16; tileSize <= maxTileSize; tileSize *= 2)
+	{
+		VERIFY(SetTileSize(tileSize, tileSize));
+
+		// Both renders end with a blocking read, so times include all work
+		auto start = std::chrono::steady_clock::now();
+		VERIFY(RenderTiles(samplesPerPixel, 0));
+		std::chrono::duration<float> perTileTime =
+			std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		VERIFY(RenderPersistent(samplesPerPixel, 0));
+		std::chrono::duration<float> persistentTime =
+			std::chrono::steady_clock::now() - start;
+
+		results.push_back(std::to_string(tileSize) + "x" +
+			std::to_string(tileSize) + "\t" +
+			std::to_string(perTileTime.count()) + "s\t" +
+			std::to_string(persistentTime.count()) + "s\t" +
+			std::to_string(perTileTime.count() / persistentTime.count()) +
+			"x");
+	}
+
+	VERIFY(SetTileSize(props.TileWidth, props.TileHeight));
+
+	std::cout << "Tile\tPer-tile\tPersistent\tSpeedup" << std::endl;
+	for (const std::string &result : results)
+		std::cout << result << std::endl;
+
+	return true;
+}
+
+bool Application::RenderPixelMappingBenchmark()
+{
+	const char *mappingNames[] = {"Rows", "Blocks", "Morton"};
+	std::string kernelName = TileKernelName();
+	cl_uint argIndex = persistentTiles ? 21 : 24;
+
+	Image::Props props = m_Image.GetProps();
+	cl_float nRays = (cl_float)props.Width * props.Height * samplesPerPixel;
+
+	// Mappings only change which work item renders a pixel, so the RMSE
+	// against rows should be zero
+	std::vector<cl_float3> rowsImage;
+	std::vector<std::string> results;
+	for (cl_uint mapping = 0; mapping < 3; mapping++)
+	{
+		VERIFY(m_OCL.SetKernelArg(kernelName, argIndex, mapping));
+
+		// Renders end with a blocking read, so times include all work
+		auto start = std::chrono::steady_clock::now();
+		if (persistentTiles)
+		{
+			VERIFY(RenderPersistent(samplesPerPixel, 0));
+		}
+		else
+		{
+			VERIFY(RenderTiles(samplesPerPixel, 0));
+		}
+		std::chrono::duration<float> time =
+			std::chrono::steady_clock::now() - start;
+
+		if (mapping == 0)
+			rowsImage = m_Image.m_Pixels;
+
+		// Camera rays, as secondary rays depend on the scene
+		results.push_back(std::string(mappingNames[mapping]) + "\t" +
+			std::to_string(time.count()) + "s\t" +
+			std::to_string(nRays / time.count() / 1e6f) + "\t" +
+			std::to_string(m_Image.CalcRMSE(rowsImage)));
+	}
+
+	VERIFY(m_OCL.SetKernelArg(kernelName, argIndex, pixelMapping));
+
+	std::cout << "Mapping\tTime\tMrays/s\tRMSE" << std::endl;
+	for (const std::string &result : results)
+		std::cout << result << std::endl;
+
+	return true;
+}
+
+bool Application::ChooseItemsPerPixel()
+{
+	// Multi-device rendering already spreads tiles over devices, and the
+	// persistent kernel launches its own number of work items
+	m_ItemsPerPixel = 1;
+	if (sampleParallel && !multiDevice && !persistentTiles)
+	{
+		// Images smaller than a tile leave the rest of the tile idle
+		Image::Props props = m_Image.GetProps();
+		size_t nPixels = (size_t)std::min(props.Width, props.TileWidth) *
+			std::min(props.Height, props.TileHeight);
+		size_t nTargetItems =
+			(size_t)m_OCL.GetComputeUnits() * itemsPerComputeUnit;
+		cl_uint nPassSamples = std::min(samplesPerPass, samplesPerPixel);
+
+		// Work items of a pixel must be in the same work-group
+		while (nPixels * m_ItemsPerPixel < nTargetItems &&
+			m_ItemsPerPixel * 2 <= maxItemsPerPixel &&
+			m_ItemsPerPixel * 2 <= nPassSamples &&
+			m_LocalWorkSize % (m_ItemsPerPixel * 2) == 0)
+			m_ItemsPerPixel *= 2;
+	}
+
+	if (m_ItemsPerPixel > 1)
+		std::cout << "Splitting the samples of each pixel between "
+				  << m_ItemsPerPixel << " work items." << std::endl;
+
+	VERIFY(m_OCL.SetKernelArg("Laser", 25, m_ItemsPerPixel));
+	VERIFY(m_OCL.SetLocalKernelArg("Laser", 26,
+		m_LocalWorkSize * sizeof(cl_float3)));
+
+	return true;
+}
+
+bool Application::RenderMultiDevice(cl_uint nSamples, cl_uint firstSample)
+{
+	Image::Props props = m_Image.GetProps();
+	cl_uint nTiles = props.nRows * props.nColumns;
+	cl_uint nPasses = (nSamples + samplesPerPass - 1) / samplesPerPass;
+
+	std::vector<OpenCLContext *> devices = {&m_OCL};
+	for (OpenCLContext &ocl : m_ExtraOCL)
+		devices.push_back(&ocl);
+
+	// Each device takes the next tile when it finishes one. Devices render
+	// every pass of a tile, so its running sums stay on one device.
+	std::atomic<cl_uint> nextTile(0);
+	std::vector<cl_uint> tilesRendered(devices.size(), 0);
+	std::mutex printMutex;
+
+	auto renderDevice = [&](size_t device) -> bool
+	{
+		OpenCLContext &ocl = *devices[device];
+
+		// Tuned for the first device, so halve until the kernel fits this one
+		size_t maxWorkGroupSize = 0;
+		size_t preferredMultiple = 0;
+		VERIFY(ocl.GetKernelWorkGroupInfo("Laser", maxWorkGroupSize,
+			preferredMultiple));
+		size_t localWorkSize = m_LocalWorkSize;
+		while (localWorkSize > maxWorkGroupSize)
+			localWorkSize /= 2;
+
+		for (cl_uint k = nextTile++; k < nTiles; k = nextTile++)
+		{
+			cl_uint xOffset = (k % props.nRows) * props.TileWidth;
+			cl_uint yOffset = (k / props.nRows) * props.TileHeight;
+			VERIFY(ocl.SetKernelArg("Laser", 17, xOffset));
+			VERIFY(ocl.SetKernelArg("Laser", 18, yOffset));
+
+			for (cl_uint pass = 0; pass < nPasses; pass++)
+			{
+				VERIFY(SetPassKernelArgs(ocl, "Laser", 19, pass, nSamples,
+					firstSample));
+				VERIFY(ocl.QueueKernel("Laser", NULL, m_GlobalWorkSize,
+					localWorkSize));
+			}
+
+			// Tiles cover separate pixels, so devices read into the image
+			// without locking
+			VERIFY(ReadTile(ocl, "output0", xOffset, yOffset, CL_TRUE));
+			tilesRendered[device]++;
+
+			std::lock_guard<std::mutex> lock(printMutex);
+			std::cout << "Done tile " << k + 1 << " of " << nTiles
+					  << " on device " << device << std::endl;
+		}
+
+		return true;
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<char> succeeded(devices.size(), false);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < devices.size(); i++)
+		threads.emplace_back([&, i]() { succeeded[i] = renderDevice(i); });
+	for (std::thread &thread : threads)
+		thread.join();
+	std::chrono::duration<float> time =
+		std::chrono::steady_clock::now() - start;
+
+	for (char success : succeeded)
+		VERIFY(success);
+
+	// Throughput of each device over the whole render, in camera rays
+	cl_float raysPerTile =
+		(cl_float)props.TileWidth * props.TileHeight * nSamples;
+	for (size_t i = 0; i < devices.size(); i++)
+	{
+		std::cout << "Device " << i << " (" << devices[i]->GetDeviceName()
+				  << "): " << tilesRendered[i] << " tiles, "
+				  << tilesRendered[i] * raysPerTile / time.count() / 1e6f
+				  << " Mrays/s" << std::endl;
+	}
+	std::cout << "Total: " << nTiles * raysPerTile / time.count() / 1e6f
+			  << " Mrays/s" << std::endl;
+
+	return true;
+}
+
+bool Application::RenderReSTIR()
+{
+	Image::Props props = m_Image.GetProps();
+	size_t nPixels = props.Width * props.Height;
+
+	// Reservoirs are reused across the whole frame, so each pass covers every
+	// pixel rather than a tile
+	size_t globalWorkSize =
+		(nPixels + m_LocalWorkSize - 1) / m_LocalWorkSize * m_LocalWorkSize;
+
+	for (cl_uint frame = 0; frame < restirFrames; frame++)
+	{
+		VERIFY(m_OCL.SetKernelArg("restirCandidates", 19, frame));
+		VERIFY(m_OCL.SetKernelArg("restirSpatial", 19, frame));
+		VERIFY(m_OCL.SetKernelArg("restirShade", 19, frame));
+
+		// Passes are serialized by the in-order command queue
+		VERIFY(m_OCL.QueueKernel("restirCandidates", NULL, globalWorkSize,
+			m_LocalWorkSize));
+		VERIFY(m_OCL.QueueKernel("restirSpatial", NULL, globalWorkSize,
+			m_LocalWorkSize));
+		VERIFY(m_OCL.QueueKernel("restirShade", NULL, globalWorkSize,
+			m_LocalWorkSize));
+
+		std::cout << "Queued frame " << frame + 1 << " of " << restirFrames
+				  << std::endl;
+	}
+
+	return ReadAccumulation(1.0f / restirFrames);
+}
+
+bool Application::RenderReSTIRComparison()
+{
+	// Renders end with a blocking read, so times include all work
+	auto start = std::chrono::steady_clock::now();
+	VERIFY(RenderReSTIR());
+	std::chrono::duration<float> restirTime =
+		std::chrono::steady_clock::now() - start;
+	std::vector<cl_float3> restirPixels = m_Image.m_Pixels;
+
+	// Time one sample per pixel to fit as many path traced samples into the
+	// time ReSTIR took
+	start = std::chrono::steady_clock::now();
+	VERIFY(RenderTiles(1, 0));
+	std::chrono::duration<float> sampleTime =
+		std::chrono::steady_clock::now() - start;
+	cl_uint pathSamples =
+		std::max(1u, (cl_uint)(restirTime.count() / sampleTime.count()));
+
+	start = std::chrono::steady_clock::now();
+	VERIFY(RenderTiles(pathSamples, 0));
+	std::chrono::duration<float> pathTime =
+		std::chrono::steady_clock::now() - start;
+	std::vector<cl_float3> pathPixels = m_Image.m_Pixels;
+
+	// Render reference with independent samples after those of the path
+	// tracer, so it isn't correlated with either render
+	std::cout << "Rendering reference with " << referenceSamples
+			  << " samples per pixel..." << std::endl;
+	VERIFY(m_OCL.SetKernelArg("Laser", 16, (cl_uint)0));
+	VERIFY(RenderTiles(referenceSamples, pathSamples));
+	VERIFY(m_OCL.SetKernelArg("Laser", 16, samplerType));
+	std::vector<cl_float3> reference = m_Image.m_Pixels;
+
+	// The ReSTIR render is kept as the output image
+	m_Image.m_Pixels = pathPixels;
+	cl_float pathRMSE = m_Image.CalcRMSE(reference);
+	m_Image.m_Pixels = restirPixels;
+	cl_float restirRMSE = m_Image.CalcRMSE(reference);
+
+	std::cout << "ReSTIR:       " << restirFrames << " frames, "
+			  << restirTime.count() << "s, RMSE = " << restirRMSE << std::endl;
+	std::cout << "Path tracing: " << pathSamples << " spp, "
+			  << pathTime.count() << "s, RMSE = " << pathRMSE << std::endl;
+
+	return true;
+}
+
+bool Application::RenderWavefront(cl_uint nSamples, cl_uint firstSample)
+{
+	Image::Props props = m_Image.GetProps();
+	cl_uint nPixels = props.Width * props.Height;
+
+	// Round launches up to a multiple of the work-group size
+	auto roundUp = [this](size_t n)
+	{ return (n + m_LocalWorkSize - 1) / m_LocalWorkSize * m_LocalWorkSize; };
+
+	// Written and read without blocking, the in-order queue finishes with
+	// them before the final blocking read of the accumulation
+	const cl_uint firstCounts[QUEUE_COUNT] = {nPixels, 0, 0, 0};
+	std::vector<std::array<cl_uint, QUEUE_COUNT>> counts(WAVEFRONT_MAX_DEPTH);
+
+	// Each sample of every pixel is traced as one wave of paths
+	for (cl_uint sample = 0; sample < nSamples; sample++)
+	{
+		cl_uint sampleIndex = firstSample + sample;
+
+		VERIFY(m_OCL.SetKernelArg("wavefrontGenerate", 18, sampleIndex));
+		VERIFY(m_OCL.SetKernelArg("wavefrontShade", 21, sampleIndex));
+		VERIFY(m_OCL.QueueKernel("wavefrontGenerate", NULL, roundUp(nPixels),
+			m_LocalWorkSize));
+
+		// Queue counts stay on the device, where each kernel reads how many
+		// paths it has and the advance kernel starts the next bounce. Counts
+		// read back without blocking only shrink launches once they arrive,
+		// and end the sample early when no paths are left.
+		VERIFY(m_OCL.QueueWrite("queueCounts", CL_FALSE, 0,
+			sizeof(firstCounts), firstCounts));
+		std::vector<cl::Event> countReads(WAVEFRONT_MAX_DEPTH);
+		cl_uint maxRays = nPixels;
+		std::string rayQueue = "rayQueue";
+		std::string nextRayQueue = "nextRayQueue";
+		for (cl_uint depth = 0; depth < WAVEFRONT_MAX_DEPTH; depth++)
+		{
+			// Rays only get fewer, so the latest count that has arrived
+			// bounds every later bounce
+			for (cl_uint i = depth; i-- > 0;)
+			{
+				cl_int status =
+					countReads[i].getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>();
+				if (status == CL_COMPLETE)
+				{
+					maxRays = counts[i][QUEUE_NEXT_RAYS];
+					break;
+				}
+			}
+			if (maxRays == 0)
+				break;
+
+			if (depth > 0)
+				VERIFY(m_OCL.QueueKernel("wavefrontAdvance", NULL, 1));
+
+			VERIFY(m_OCL.SetKernelArg("wavefrontExtend", 17, rayQueue));
+			VERIFY(m_OCL.QueueKernel("wavefrontExtend", NULL,
+				roundUp(maxRays), m_LocalWorkSize));
+
+			// Shade each material queue in a separate launch
+			VERIFY(m_OCL.SetKernelArg("wavefrontShade", 19, nextRayQueue));
+			for (cl_uint queue : {QUEUE_DIFFUSE, QUEUE_SPECULAR})
+			{
+				VERIFY(m_OCL.SetKernelArg("wavefrontShade", 20, queue));
+				VERIFY(m_OCL.QueueKernel("wavefrontShade", NULL,
+					roundUp(maxRays), m_LocalWorkSize));
+			}
+			VERIFY(m_OCL.QueueRead("queueCounts", CL_FALSE, 0,
+				sizeof(counts[depth]), counts[depth].data(), nullptr,
+				&countReads[depth]));
+			VERIFY(m_OCL.Flush());
+
+			std::swap(rayQueue, nextRayQueue);
+		}
+
+		VERIFY(m_OCL.SetKernelArg("wavefrontAccumulate", 18, sample));
+		VERIFY(m_OCL.QueueKernel("wavefrontAccumulate", NULL,
+			roundUp(nPixels), m_LocalWorkSize));
+
+		std::cout << "Done sample " << sample + 1 << " of " << nSamples
+				  << std::endl;
+	}
+
+	return ReadAccumulation(1.0f / nSamples);
+}
+
+bool Application::RenderWavefrontComparison()
+{
+	Image::Props props = m_Image.GetProps();
+	cl_float nSamples = (cl_float)props.Width * props.Height * samplesPerPixel;
+
+	// Both renders end with a blocking read, so clock times include all work
+	clock_t start = clock();
+	VERIFY(RenderTiles(samplesPerPixel, 0));
+	cl_float megakernelTime = (cl_float)(clock() - start) / CLOCKS_PER_SEC;
+	std::vector<cl_float3> megakernelPixels = m_Image.m_Pixels;
+
+	start = clock();
+	VERIFY(RenderWavefront(samplesPerPixel, 0));
+	cl_float wavefrontTime = (cl_float)(clock() - start) / CLOCKS_PER_SEC;
+
+	std::cout << "Megakernel: " << megakernelTime << "s, "
+			  << nSamples / megakernelTime << " samples/s" << std::endl;
+	std::cout << "Wavefront:  " << wavefrontTime << "s, "
+			  << nSamples / wavefrontTime << " samples/s" << std::endl;
+
+	// Both compute the same paths and sums, so the images should match
+	std::cout << "RMSE between megakernel and wavefront: "
+			  << m_Image.CalcRMSE(megakernelPixels) << std::endl;
+
+	return true;
+}
+
+bool Application::RenderBackendComparison()
+{
+	Image::Props props = m_Image.GetProps();
+	cl_float nSamples = (cl_float)props.Width * props.Height * samplesPerPixel;
+
+	auto start = std::chrono::steady_clock::now();
+	VERIFY(RenderTiles(samplesPerPixel, 0));
+	std::chrono::duration<float> openCLTime =
+		std::chrono::steady_clock::now() - start;
+	std::vector<cl_float3> openCLPixels = m_Image.m_Pixels;
+
+	start = std::chrono::steady_clock::now();
+	m_CPURenderer->Render(m_Image, m_Camera.GetProps(), samplesPerPixel, 0);
+	std::chrono::duration<float> cpuTime =
+		std::chrono::steady_clock::now() - start;
+
+	std::cout << "OpenCL: " << openCLTime.count() << "s, "
+			  << nSamples / openCLTime.count() << " samples/s" << std::endl;
+	std::cout << "CPU:    " << cpuTime.count() << "s, "
+			  << nSamples / cpuTime.count() << " samples/s" << std::endl;
+
+	// Both trace the same samples, so the images differ only where floating
+	// point differences change a path
+	std::cout << "RMSE between OpenCL and CPU: "
+			  << m_Image.CalcRMSE(openCLPixels) << std::endl;
+
+	return true;
+}
+
+bool Application::RenderConvergenceStudy()
+{
+	// Render reference with independent samples so it isn't correlated with
+	// any of the low-discrepancy sequences being measured, starting after the
+	// sample indices used by the study
+	std::cout << "Rendering reference with " << referenceSamples
+			  << " samples per pixel..." << std::endl;
+	VERIFY(m_OCL.SetKernelArg("Laser", 16, (cl_uint)0));
+	VERIFY(RenderTiles(referenceSamples, maxStudySamples));
+	std::vector<cl_float3> reference = m_Image.m_Pixels;
+
+	// RMSE of each sampler at power of two sample counts
+	const char *samplerNames[] = {"random", "sobol", "blueNoise"};
+	std::vector<std::vector<cl_float>> rmse(3);
+	for (cl_uint type = 0; type < 3; type++)
+	{
+		VERIFY(m_OCL.SetKernelArg("Laser", 16, type));
+		for (cl_uint spp = 1; spp <= maxStudySamples; spp *= 2)
+		{
+			VERIFY(RenderTiles(spp, 0));
+			rmse[type].push_back(m_Image.CalcRMSE(reference));
+			std::cout << samplerNames[type] << " " << spp
+					  << " spp: RMSE = " << rmse[type].back() << std::endl;
+		}
+	}
+
+	// Write RMSE-versus-spp curves
+	std::ofstream file("convergence.csv");
+	if (!file)
+	{
+		std::cout << "Failed to open file convergence.csv." << std::endl;
+		return false;
+	}
+	file << "spp," << samplerNames[0] << "," << samplerNames[1] << ","
+		 << samplerNames[2] << std::endl;
+	for (cl_uint i = 0, spp = 1; spp <= maxStudySamples; i++, spp *= 2)
+		file << spp << "," << rmse[0][i] << "," << rmse[1][i] << ","
+			 << rmse[2][i] << std::endl;
+
+	// Restore sampler for the output image, which is the last render
+	VERIFY(m_OCL.SetKernelArg("Laser", 16, samplerType));
+
+	return true;
+}
+
+bool Application::WriteOutput()
+{
+	// TODO: write render stats here
+	// Write render stats to console
+	/*std::cout << "Render time:                " << stats.RenderTime << "
+	seconds" << std::endl; std::cout << "Primary rays:               " <<
+	stats.n_PrimaryRays << std::endl; std::cout << "Ray-triangle tests: " <<
+	stats.n_RayTriangleTests << std::endl; std::cout << "Ray-triangle
+	intersections: " << stats.n_RayTriangleIsects << std::endl << std::endl;*/
+
+	// Write image to file, streamed renders have already written their tiles
+	// and workers of a shared frame have sent theirs to the coordinator
+	bool sentTiles = !jobDirectory.empty() && !coordinateJobs;
+	if (!streamOutput && !sentTiles)
+	{
+		if (patchOutput)
+		{
+			VERIFY(PatchOutput(m_OutputFile));
+		}
+		else
+		{
+			VERIFY(m_Image.WriteToFile(m_OutputFile));
+		}
+	}
+
+	m_AppEnd = clock();
+	std::cout << "App time: " << (float)(m_AppEnd - m_AppStart) / CLOCKS_PER_SEC
+			  << "s." << std::endl;
+	std::cout << "Render time: "
+			  << (float)(m_RenderEnd - m_RenderStart) / CLOCKS_PER_SEC << "s."
+			  << std::endl;
+
+	return true;
+}
+
+bool Application::Serve(const std::string &spoolDirectory)
+{
+	std::cout << "Serving render jobs from " << spoolDirectory
+			  << " until a file named stop is created there." << std::endl;
+
+	// Settings jobs don't give are the server's
+	RenderJob defaults;
+	defaults.Samples = samplesPerPixel;
+	defaults.Sampler = samplerType;
+	defaults.Position = position;
+	defaults.Target = target;
+	defaults.VerticalFOV = 75.0f;
+	defaults.Aperture = aperture;
+	defaults.Materials = m_Materials;
+	defaults.Transforms = m_BVH.m_Transforms;
+
+	namespace fs = std::filesystem;
+	fs::path spool = spoolDirectory;
+	std::error_code error;
+	while (!fs::exists(spool / "stop", error))
+	{
+		std::vector<fs::path> jobs;
+		for (const fs::directory_entry &entry :
+			fs::directory_iterator(spool, error))
+		{
+			if (entry.path().extension() == ".job")
+				jobs.push_back(entry.path());
+		}
+		if (error)
+		{
+			std::cout << "Failed to list jobs in " << spoolDirectory << "."
+					  << std::endl;
+			return false;
+		}
+
+		// Run the first job by name, claiming it by renaming so servers can
+		// share a spool directory. A failed job leaves the server running.
+		std::sort(jobs.begin(), jobs.end());
+		bool ran = false;
+		for (const fs::path &path : jobs)
+		{
+			fs::path running = path;
+			running.replace_extension(".running");
+			std::error_code renameError;
+			fs::rename(path, running, renameError);
+			if (renameError)
+				continue;
+
+			RenderJob job = defaults;
+			job.Output = path.stem().string() + "." +
+				m_Image.GetFileExtension();
+			bool done = RunJob(running.string(), job);
+
+			fs::path result = running;
+			result.replace_extension(done ? ".done" : ".failed");
+			fs::rename(running, result, renameError);
+			ran = true;
+			break;
+		}
+
+		if (!ran)
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	std::cout << "Stopped serving render jobs." << std::endl;
+	return true;
+}
+
+bool Application::RunJob(const std::string &filepath, RenderJob &job)
+{
+	std::cout << "Running job " << filepath << "..." << std::endl;
+	auto start = std::chrono::steady_clock::now();
+	VERIFY(job.Load(filepath));
+
+	// The CPU backend takes its sampler when created
+	if (m_Backend == Backend::CPU && job.Sampler != samplerType)
+	{
+		std::cout << "The CPU backend's sampler can't change between jobs."
+				  << std::endl;
+		return false;
+	}
+
+	// Outputs are in the spool directory unless given an absolute path
+	samplesPerPixel = job.Samples;
+	samplerType = job.Sampler;
+	glm::vec3 offset = {job.Target.x - job.Position.x,
+		job.Target.y - job.Position.y, job.Target.z - job.Position.z};
+	m_Camera = Camera(job.Position, job.Target, job.VerticalFOV,
+		m_Image.GetProps().AspectRatio, job.Aperture, glm::length(offset));
+	m_OutputFile =
+		(std::filesystem::path(filepath).parent_path() / job.Output).string();
+
+	// Each job starts from the server's scene, so only materials and
+	// transforms that differ from the last job's are edited and uploaded
+	for (cl_uint i = 0; i < job.Materials.size(); i++)
+	{
+		if (std::memcmp(&job.Materials[i], &m_Materials[i],
+				sizeof(Material)) != 0)
+			VERIFY(SetMaterial(i, job.Materials[i]));
+	}
+	for (cl_uint i = 0; i < job.Transforms.size(); i++)
+	{
+		if (job.Transforms[i] != m_BVH.m_Transforms[i])
+			VERIFY(SetTransform(i, job.Transforms[i]));
+	}
+
+	// Setting kernel arguments is cheap, and carries the sampler
+	VERIFY(SetKernelArgs());
+	VERIFY(Render());
+	VERIFY(WriteOutput());
+
+	std::chrono::duration<float> time =
+		std::chrono::steady_clock::now() - start;
+	std::cout << "Finished job " << filepath << " in " << time.count()
+			  << "s." << std::endl;
+	return true;
+}
+
+bool Application::SetMaterial(cl_uint index, const Material &material)
+{
+	if (index >= m_Materials.size())
+	{
+		std::cout << "No material " << index << " in the scene." << std::endl;
+		return false;
+	}
+
+	Material previous = m_Materials[index];
+	m_Materials[index] = material;
+
+	// Light selection is proportional to emitted power
+	const cl_float3 &a = previous.Emission;
+	const cl_float3 &b = material.Emission;
+	if (a.x != b.x || a.y != b.y || a.z != b.z)
+	{
+		if (!RebuildLights())
+		{
+			m_Materials[index] = previous;
+			return false;
+		}
+	}
+	m_SceneVersions.MarkDirty("materials", index, 1);
+
+	return true;
+}
+
+bool Application::SetTransform(cl_uint index, const glm::mat4 &transform)
+{
+	if (index >= m_BVH.m_Transforms.size())
+	{
+		std::cout << "No transform " << index << " in the scene." << std::endl;
+		return false;
+	}
+
+	// Refitting keeps the tree, which may traverse slower than a rebuild
+	// after large moves but leaves the BVH's size unchanged. Every node
+	// above a moved triangle changes, including the root.
+	glm::mat4 previous = m_BVH.m_Transforms[index];
+	m_BVH.m_Transforms[index] = transform;
+	m_BVH.Refit();
+	if (!RebuildLights())
+	{
+		m_BVH.m_Transforms[index] = previous;
+		m_BVH.Refit();
+		return false;
+	}
+	m_SceneVersions.MarkDirty("transforms", index, 1);
+	m_SceneVersions.MarkAllDirty("bvh");
+
+	// The CPU backend keeps world space triangles
+	if (m_CPURenderer)
+	{
+		m_CPURenderer = std::make_unique<CPURenderer>(m_BVH, m_Materials,
+			m_LightList, m_LightBVH, m_BlueNoise, samplerType);
+		m_CPURenderer->SetPacketTraversal(cpuPacketTraversal);
+	}
+
+	return true;
+}
+
+bool Application::RebuildLights()
+{
+	LightList lightList(m_BVH, m_Materials);
+	LightBVH lightBVH(m_BVH, m_Materials, lightList);
+
+	// The light buffers were allocated for the lights of the loaded scene
+	bool sameLights =
+		lightList.m_Lights.size() == m_LightList.m_Lights.size() &&
+		lightBVH.m_Nodes.size() == m_LightBVH.m_Nodes.size();
+	for (size_t i = 0; sameLights && i < lightList.m_TriangleLights.size(); i++)
+	{
+		sameLights = (lightList.m_TriangleLights[i] == LightList::NO_LIGHT) ==
+			(m_LightList.m_TriangleLights[i] == LightList::NO_LIGHT);
+	}
+	if (!sameLights)
+	{
+		std::cout << "Scene edits can't change which triangles emit light."
+				  << std::endl;
+		return false;
+	}
+
+	// Assigned in place, the CPU backend holds references to both
+	m_LightList = lightList;
+	m_LightBVH = lightBVH;
+	m_SceneVersions.MarkAllDirty("lights");
+	m_SceneVersions.MarkAllDirty("lightBVH");
+	m_SceneVersions.MarkAllDirty("lightAliasTable");
+	m_SceneVersions.MarkAllDirty("triangleLights");
 
 	return true;
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <memory>
 #include <vector>
 
 #include <glm/glm.hpp>
@@ -11,37 +13,163 @@
 #include "TriangleMesh.h"
 #include "Material.h"
 #include "BVH.h"
+#include "LightList.h"
+#include "LightBVH.h"
+#include "BlueNoise.h"
+#include "TuningCache.h"
+#include "CPURenderer.h"
+#include "Checkpoint.h"
+#include "JobQueue.h"
+#include "RenderJob.h"
+#include "BufferVersions.h"
 
 class Application
 {
 public:
+	// Auto uses OpenCL if a GPU is available and the CPU backend otherwise
+	enum class Backend
+	{
+		Auto = 0,
+		OpenCL,
+		CPU
+	};
+
 	Application();
 
+	void SetBackend(Backend backend);
+
 	bool Init();
 	bool GenBuffers();
 	bool SetKernelArgs();
 	bool Render();
 	bool WriteOutput();
 
+	// Run render jobs from files in a spool directory, reusing the OpenCL
+	// context, programs and scene buffers of a single Init
+	bool Serve(const std::string &spoolDirectory);
+
+	// Edit the scene between renders, after which renders upload only what
+	// changed. Edits take effect from the next SetKernelArgs and Render.
+	bool SetMaterial(cl_uint index, const Material &material);
+	bool SetTransform(cl_uint index, const glm::mat4 &transform);
+
 private:
+	bool InitOpenCL();
+	bool GenSceneBuffers(OpenCLContext &ocl, size_t outputSize);
+	bool SetLaserKernelArgs(OpenCLContext &ocl);
+	bool SetSceneKernelArgs(OpenCLContext &ocl, const std::string &kernelName,
+		cl_uint firstIndex);
+	bool UploadScene(OpenCLContext &ocl);
+	bool ReadTile(OpenCLContext &ocl, const std::string &output,
+		cl_uint xOffset, cl_uint yOffset, cl_bool blocking,
+		const std::vector<cl::Event> *waitEvents = nullptr,
+		cl::Event *event = nullptr,
+		const std::string &queueName = OpenCLContext::DEFAULT_QUEUE);
+	bool RenderTiles(cl_uint nSamples, cl_uint firstSample);
+	bool ReadAccumulation(cl_float scale);
+	bool TonemapOnDevice(cl_float scale);
+	bool RenderTilesSerial(cl_uint nSamples, cl_uint firstSample);
+	bool RenderTilesAsync(cl_uint nSamples, cl_uint firstSample);
+	bool RenderTilesStreamed(cl_uint nSamples, cl_uint firstSample);
+	bool PlanJob();
+	std::vector<cl_uint> GetTiles() const;
+	Image::Region CalcJobTileRegion(cl_uint tile) const;
+	bool PatchOutput(const std::string &filepath) const;
+	bool RenderSharedFrame();
+	bool RenderWorkerTasks(JobQueue &queue, const JobQueue::Frame &frame);
+	std::vector<cl_uint> GetTaskTiles(const JobQueue::Frame &frame,
+		cl_uint task) const;
+	bool RenderTask(JobQueue &queue, const JobQueue::Frame &frame,
+		cl_uint task);
+	void Heartbeat();
+	bool MergeTask(const JobQueue::Frame &frame, cl_uint task,
+		const std::vector<cl_float3> &pixels);
+	Checkpoint::Header GetCheckpointHeader(cl_uint nSamples,
+		cl_uint firstSample) const;
+	bool ResumeCheckpoint(cl_uint nSamples, cl_uint firstSample);
+	bool CheckpointPass(cl_uint pass, cl_uint nSamples, cl_uint firstSample);
+	bool RenderTilePipelineComparison();
+	bool SetPassKernelArgs(OpenCLContext &ocl, const std::string &kernelName,
+		cl_uint firstIndex, cl_uint pass, cl_uint nSamples,
+		cl_uint firstSample);
+	bool RenderPersistent(cl_uint nSamples, cl_uint firstSample);
+	bool RenderTileSchedulingBenchmark();
+	bool RenderPixelMappingBenchmark();
+	bool SetTileSize(cl_uint tileWidth, cl_uint tileHeight);
+	bool LoadTuning();
+	bool RunAutoTune();
+	bool ChooseItemsPerPixel();
+	bool RenderMultiDevice(cl_uint nSamples, cl_uint firstSample);
+	bool RenderBackendComparison();
+	bool RenderReSTIR();
+	bool RenderReSTIRComparison();
+	bool RenderConvergenceStudy();
+	bool RenderWavefront(cl_uint nSamples, cl_uint firstSample);
+	bool RenderWavefrontComparison();
+
+	bool RunJob(const std::string &filepath, RenderJob &job);
+	bool RebuildLights();
+
 	bool LoadModel(const std::string &filepath,
 		std::vector<TriangleMesh> &meshes, unsigned int materialIndex,
 		unsigned int transformIndex);
 	void CombineMeshes(std::vector<TriangleMesh> &meshes,
 		std::vector<Vertex> &vertices, std::vector<Triangle> &triangles);
 
+	Backend m_Backend;
+	std::unique_ptr<CPURenderer> m_CPURenderer;
+
 	// OpenCL context
 	OpenCLContext m_OCL;
 	size_t m_GlobalWorkSize;
 	size_t m_LocalWorkSize;
+	cl_uint m_ItemsPerPixel; // Work items sharing each pixel's samples
+	size_t m_OutputSize;     // Pixels each output buffer holds
 
-	// Scene
+	// Devices after the first in multi-device rendering, which only render
+	// tiles
+	std::vector<OpenCLContext> m_ExtraOCL;
+
+	// Auto-tuned launch configurations
+	TuningCache m_TuningCache;
+	bool m_TuningPending;
+
+	// Whether the render in progress reads back only the image tonemapped on
+	// the device
+	bool m_TonemapOnDevice;
+
+	// Checkpoints of the render in progress, which starts at m_FirstPass when
+	// resumed
+	Checkpoint m_Checkpoint;
+	bool m_Checkpointing;
+	cl_uint m_FirstPass;
+	std::chrono::steady_clock::time_point m_LastCheckpoint;
+
+	// Tiles of a crop or tile-range job in render order, empty when rendering
+	// the whole image, and the crop of their pixels that is output
+	std::vector<cl_uint> m_JobTiles;
+	Image::Region m_Crop;
+
+	// Shared frame task being rendered, if any, whose claim is touched as
+	// tiles finish so it isn't requeued as stalled
+	JobQueue *m_ClaimQueue;
+	cl_uint m_ClaimedTask;
+	std::chrono::steady_clock::time_point m_LastHeartbeat;
+
+	// Scene, with the edits each device's buffers are yet to receive
+	BufferVersions m_SceneVersions;
 	std::vector<Material> m_Materials;
 	BVH m_BVH;
+	LightList m_LightList;
+	LightBVH m_LightBVH;
+
+	// Sampling
+	BlueNoise m_BlueNoise;
 
 	// Image and camera
 	Image m_Image;
 	Camera m_Camera;
+	std::string m_OutputFile;
 
 	// Profiler
 	RenderStats m_RenderStats;
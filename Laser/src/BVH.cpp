@@ -1,225 +1,250 @@
-#include "BVH.h"
-#include <algorithm>
-
-/********** BVH TRIANGLE INFO **********/
-
-BVH::BVHTriangleInfo::BVHTriangleInfo(cl_uint triangleNumber,
-	const ::Bounds &bounds)
-	: TriangleNumber(triangleNumber), Bounds(bounds),
-	  Centroid(CalcCentroid(bounds))
-{
-}
-
-cl_float3 BVH::BVHTriangleInfo::CalcCentroid(const ::Bounds &bounds)
-{
-	cl_float x = (bounds.pMin.x + bounds.pMax.x) * 0.5f;
-	cl_float y = (bounds.pMin.y + bounds.pMax.y) * 0.5f;
-	cl_float z = (bounds.pMin.z + bounds.pMax.z) * 0.5f;
-
-	cl_float3 result = {x, y, z};
-	return result;
-}
-
-/********** BVH BUILD NODE **********/
-
-BVH::BVHBuildNode::BVHBuildNode()
-{
-	Children[0] = nullptr;
-	Children[1] = nullptr;
-}
-
-BVH::BVHBuildNode::~BVHBuildNode()
-{
-	if (Children[0])
-		delete Children[0];
-	if (Children[1])
-		delete Children[1];
-}
-
-void BVH::BVHBuildNode::InitLeaf(cl_uint first, cl_uint n,
-	const ::Bounds &bounds)
-{
-	FirstTriangle = first;
-	this->nTriangles = n;
-	Bounds = bounds;
-}
-
-void BVH::BVHBuildNode::InitInterior(cl_uint axis, BVHBuildNode *child0,
-	BVHBuildNode *child1)
-{
-	Children[0] = child0;
-	Children[1] = child1;
-	::Bounds nodeBounds = child0->Bounds;
-	nodeBounds.Join(child1->Bounds);
-	Bounds = nodeBounds;
-	SplitAxis = axis;
-	nTriangles = 0;
-}
-
-/********** BVH **********/
-
-BVH::BVH() {}
-
-BVH::BVH(const std::vector<Vertex> &vertices,
-	const std::vector<Triangle> &triangles,
-	const std::vector<glm::mat4> &transforms)
-	: m_Vertices(vertices), m_Triangles(triangles), m_Transforms(transforms)
-{
-	// Ensure at least one triangle in the scene
-	if (m_Triangles.size() == 0)
-		return;
-
-	// Calculate scene triangle info (bounds, centroids)
-	std::vector<BVHTriangleInfo> trianglesInfo;
-	trianglesInfo.reserve(m_Triangles.size());
-	for (uint32_t i = 0; i < m_Triangles.size(); i++)
-		trianglesInfo.emplace_back(BVHTriangleInfo(i, CalcTriangleBounds(i)));
-
-	// Build BVH tree
-	uint32_t totalNodes = 0;
-	std::vector<Triangle> orderedTriangles;
-	orderedTriangles.reserve(m_Triangles.size());
-	BVHBuildNode *root = Build(trianglesInfo, 0, m_Triangles.size(),
-		&totalNodes, orderedTriangles);
-
-	// Store ordered triangles
-	m_Triangles.swap(orderedTriangles);
-
-	// Build depth-first representation for non-recursive GPU traversal
-	m_BVHLinearNodes.resize(totalNodes);
-	cl_uint offset = 0;
-	Flatten(root, &offset);
-}
-
-BVH::~BVH() {}
-
-BVH::BVHBuildNode *BVH::Build(std::vector<BVHTriangleInfo> &trianglesInfo,
-	cl_uint start, cl_uint end, cl_uint *totalNodes,
-	std::vector<Triangle> &orderedTriangles)
-{
-	BVHBuildNode *node = new BVHBuildNode;
-	(*totalNodes)++;
-
-	// Compute bounds of triangles in node
-	Bounds nodeBounds;
-	for (cl_uint i = start; i < end; i++)
-		nodeBounds.Join(trianglesInfo[i].Bounds);
-
-	// If 1 triangle in node
-	cl_uint nTriangles = end - start;
-	if (nTriangles == 1)
-	{
-		// Create leaf node with 1 triangle
-		cl_uint firstTriangleOffset = orderedTriangles.size();
-		for (cl_uint i = start; i < end; i++)
-		{
-			cl_uint triangleNumber = trianglesInfo[i].TriangleNumber;
-			orderedTriangles.emplace_back(m_Triangles[triangleNumber]);
-		}
-		node->InitLeaf(firstTriangleOffset, nTriangles, nodeBounds);
-		return node;
-	}
-
-	// If more than 1 triangle in node
-	else
-	{
-		// Choose split dimension
-		Bounds centroidBounds;
-		for (cl_uint i = start; i < end; ++i)
-			centroidBounds.Extend(trianglesInfo[i].Centroid);
-		cl_uint dimension = centroidBounds.GetLargestDimension();
-
-		// Partition triangles
-		cl_uint mid = (start + end) / 2;
-
-		cl_float pMinInDim = dimension == 0 ? centroidBounds.pMin.x
-			: dimension == 1				? centroidBounds.pMin.y
-											: centroidBounds.pMin.z;
-		cl_float pMaxInDim = dimension == 0 ? centroidBounds.pMax.x
-			: dimension == 1				? centroidBounds.pMax.y
-											: centroidBounds.pMax.z;
-
-		// If bounds of centroids of triangles is degenerate
-		if (pMinInDim == pMaxInDim)
-		{
-			// Create leaf node with multiple triangles
-			cl_uint firstTriangleOffset = orderedTriangles.size();
-			for (cl_uint i = start; i < end; i++)
-			{
-				cl_uint triangleNumber = trianglesInfo[i].TriangleNumber;
-				orderedTriangles.emplace_back(m_Triangles[triangleNumber]);
-			}
-			node->InitLeaf(firstTriangleOffset, nTriangles, nodeBounds);
-			return node;
-		}
-		else
-		{
-			// Partition primitives into equal subsets
-			std::nth_element(&trianglesInfo[start], &trianglesInfo[mid],
-				&trianglesInfo[end - 1] + 1,
-				[dimension](const BVHTriangleInfo &a, const BVHTriangleInfo &b)
-				{
-					cl_float aCentroidDim = dimension == 0 ? a.Centroid.x
-						: dimension == 1				   ? a.Centroid.y
-														   : a.Centroid.z;
-					cl_float bCentroidDim = dimension == 0 ? b.Centroid.x
-						: dimension == 1				   ? b.Centroid.y
-														   : b.Centroid.z;
-					return aCentroidDim < bCentroidDim;
-				});
-
-			// Create interior node and recurse
-			node->InitInterior(dimension,
-				Build(trianglesInfo, start, mid, totalNodes, orderedTriangles),
-				Build(trianglesInfo, mid, end, totalNodes, orderedTriangles));
-		}
-	}
-	return node;
-}
-
-cl_uint BVH::Flatten(BVHBuildNode *node, cl_uint *offset)
-{
-	BVHLinearNode *linearNode = &m_BVHLinearNodes[*offset];
-	linearNode->Bounds = node->Bounds;
-	cl_uint myOffset = (*offset)++;
-	// If node is leaf
-	if (node->nTriangles > 0)
-	{
-		// Copy triangle indices
-		linearNode->FirstTriangle = node->FirstTriangle;
-		linearNode->nTriangles = node->nTriangles;
-	}
-	// If node is interior
-	else
-	{
-		// Copy split axis and flatten children
-		linearNode->SplitAxis = node->SplitAxis;
-		linearNode->nTriangles = 0;
-		Flatten(node->Children[0], offset);
-		linearNode->SecondChildOffset = Flatten(node->Children[1], offset);
-	}
-	return myOffset;
-}
-
-Bounds BVH::CalcTriangleBounds(cl_uint tri) const
-{
-	cl_float3 v0 = m_Vertices[m_Triangles[tri].v0].Position;
-	cl_float3 v1 = m_Vertices[m_Triangles[tri].v1].Position;
-	cl_float3 v2 = m_Vertices[m_Triangles[tri].v2].Position;
-
-	glm::vec3 glmv0 = {v0.x, v0.y, v0.z};
-	glm::vec3 glmv1 = {v1.x, v1.y, v1.z};
-	glm::vec3 glmv2 = {v2.x, v2.y, v2.z};
-
-	glm::mat4 transform = m_Transforms[m_Triangles[tri].Transform];
-
-	glmv0 = transform * glm::vec4(glmv0, 1.0f);
-	glmv1 = transform * glm::vec4(glmv1, 1.0f);
-	glmv2 = transform * glm::vec4(glmv2, 1.0f);
-
-	v0 = {glmv0.x, glmv0.y, glmv0.z};
-	v1 = {glmv1.x, glmv1.y, glmv1.z};
-	v2 = {glmv2.x, glmv2.y, glmv2.z};
-
-	return Bounds(v0, v1, v2);
-}
+#include "BVH.h"
+#include <algorithm>
+
+/********** BVH TRIANGLE INFO **********/
+
+BVH::BVHTriangleInfo::BVHTriangleInfo(cl_uint triangleNumber,
+	const ::Bounds &bounds)
+	: TriangleNumber(triangleNumber), Bounds(bounds),
+	  Centroid(CalcCentroid(bounds))
+{
+}
+
+cl_float3 BVH::BVHTriangleInfo::CalcCentroid(const ::Bounds &bounds)
+{
+	cl_float x = (bounds.pMin.x + bounds.pMax.x) * 0.5f;
+	cl_float y = (bounds.pMin.y + bounds.pMax.y) * 0.5f;
+	cl_float z = (bounds.pMin.z + bounds.pMax.z) * 0.5f;
+
+	cl_float3 result = {x, y, z};
+	return result;
+}
+
+/********** BVH BUILD NODE **********/
+
+BVH::BVHBuildNode::BVHBuildNode()
+{
+	Children[0] = nullptr;
+	Children[1] = nullptr;
+}
+
+BVH::BVHBuildNode::~BVHBuildNode()
+{
+	if (Children[0])
+		delete Children[0];
+	if (Children[1])
+		delete Children[1];
+}
+
+void BVH::BVHBuildNode::InitLeaf(cl_uint first, cl_uint n,
+	const ::Bounds &bounds)
+{
+	FirstTriangle = first;
+	this->nTriangles = n;
+	Bounds = bounds;
+}
+
+void BVH::BVHBuildNode::InitInterior(cl_uint axis, BVHBuildNode *child0,
+	BVHBuildNode *child1)
+{
+	Children[0] = child0;
+	Children[1] = child1;
+	::Bounds nodeBounds = child0->Bounds;
+	nodeBounds.Join(child1->Bounds);
+	Bounds = nodeBounds;
+	SplitAxis = axis;
+	nTriangles = 0;
+}
+
+/********** BVH **********/
+
+BVH::BVH() {}
+
+BVH::BVH(const std::vector<Vertex> &vertices,
+	const std::vector<Triangle> &triangles,
+	const std::vector<glm::mat4> &transforms)
+	: m_Vertices(vertices), m_Triangles(triangles), m_Transforms(transforms)
+{
+	// Ensure at least one triangle in the scene
+	if (m_Triangles.size() == 0)
+		return;
+
+	// Calculate scene triangle info (bounds, centroids)
+	std::vector<BVHTriangleInfo> trianglesInfo;
+	trianglesInfo.reserve(m_Triangles.size());
+	for (uint32_t i = 0; i < m_Triangles.size(); i++)
+		trianglesInfo.emplace_back(BVHTriangleInfo(i, CalcTriangleBounds(i)));
+
+	// Build BVH tree
+	uint32_t totalNodes = 0;
+	std::vector<Triangle> orderedTriangles;
+	orderedTriangles.reserve(m_Triangles.size());
+	BVHBuildNode *root = Build(trianglesInfo, 0, m_Triangles.size(),
+		&totalNodes, orderedTriangles);
+
+	// Store ordered triangles
+	m_Triangles.swap(orderedTriangles);
+
+	// Build depth-first representation for non-recursive GPU traversal
+	m_BVHLinearNodes.resize(totalNodes);
+	cl_uint offset = 0;
+	Flatten(root, &offset);
+}
+
+BVH::~BVH() {}
+
+BVH::BVHBuildNode *BVH::Build(std::vector<BVHTriangleInfo> &trianglesInfo,
+	cl_uint start, cl_uint end, cl_uint *totalNodes,
+	std::vector<Triangle> &orderedTriangles)
+{
+	BVHBuildNode *node = new BVHBuildNode;
+	(*totalNodes)++;
+
+	// Compute bounds of triangles in node
+	Bounds nodeBounds;
+	for (cl_uint i = start; i < end; i++)
+		nodeBounds.Join(trianglesInfo[i].Bounds);
+
+	// If 1 triangle in node
+	cl_uint nTriangles = end - start;
+	if (nTriangles == 1)
+	{
+		// Create leaf node with 1 triangle
+		cl_uint firstTriangleOffset = orderedTriangles.size();
+		for (cl_uint i = start; i < end; i++)
+		{
+			cl_uint triangleNumber = trianglesInfo[i].TriangleNumber;
+			orderedTriangles.emplace_back(m_Triangles[triangleNumber]);
+		}
+		node->InitLeaf(firstTriangleOffset, nTriangles, nodeBounds);
+		return node;
+	}
+
+	// If more than 1 triangle in node
+	else
+	{
+		// Choose split dimension
+		Bounds centroidBounds;
+		for (cl_uint i = start; i < end; ++i)
+			centroidBounds.Extend(trianglesInfo[i].Centroid);
+		cl_uint dimension = centroidBounds.GetLargestDimension();
+
+		// Partition triangles
+		cl_uint mid = (start + end) / 2;
+
+		cl_float pMinInDim = dimension == 0 ? centroidBounds.pMin.x
+			: dimension == 1				? centroidBounds.pMin.y
+											: centroidBounds.pMin.z;
+		cl_float pMaxInDim = dimension == 0 ? centroidBounds.pMax.x
+			: dimension == 1				? centroidBounds.pMax.y
+											: centroidBounds.pMax.z;
+
+		// If bounds of centroids of triangles is degenerate
+		if (pMinInDim == pMaxInDim)
+		{
+			// Create leaf node with multiple triangles
+			cl_uint firstTriangleOffset = orderedTriangles.size();
+			for (cl_uint i = start; i < end; i++)
+			{
+				cl_uint triangleNumber = trianglesInfo[i].TriangleNumber;
+				orderedTriangles.emplace_back(m_Triangles[triangleNumber]);
+			}
+			node->InitLeaf(firstTriangleOffset, nTriangles, nodeBounds);
+			return node;
+		}
+		else
+		{
+			// Partition primitives into equal subsets
+			std::nth_element(&trianglesInfo[start], &trianglesInfo[mid],
+				&trianglesInfo[end - 1] + 1,
+				[dimension](const BVHTriangleInfo &a, const BVHTriangleInfo &b)
+				{
+					cl_float aCentroidDim = dimension == 0 ? a.Centroid.x
+						: dimension == 1				   ? a.Centroid.y
+														   : a.Centroid.z;
+					cl_float bCentroidDim = dimension == 0 ? b.Centroid.x
+						: dimension == 1				   ? b.Centroid.y
+														   : b.Centroid.z;
+					return aCentroidDim < bCentroidDim;
+				});
+
+			// Create interior node and recurse
+			node->InitInterior(dimension,
+				Build(trianglesInfo, start, mid, totalNodes, orderedTriangles),
+				Build(trianglesInfo, mid, end, totalNodes, orderedTriangles));
+		}
+	}
+	return node;
+}
+
+cl_uint BVH::Flatten(BVHBuildNode *node, cl_uint *offset)
+{
+	BVHLinearNode *linearNode = &m_BVHLinearNodes[*offset];
+	linearNode->Bounds = node->Bounds;
+	cl_uint myOffset = (*offset)++;
+	// If node is leaf
+	if (node->nTriangles > 0)
+	{
+		// Copy triangle indices
+		linearNode->FirstTriangle = node->FirstTriangle;
+		linearNode->nTriangles = node->nTriangles;
+	}
+	// If node is interior
+	else
+	{
+		// Copy split axis and flatten children
+		linearNode->SplitAxis = node->SplitAxis;
+		linearNode->nTriangles = 0;
+		Flatten(node->Children[0], offset);
+		linearNode->SecondChildOffset = Flatten(node->Children[1], offset);
+	}
+	return myOffset;
+}
+
+void BVH::Refit()
+{
+	// Children follow their parent in the array, so a reverse pass bounds
+	// them before the parent
+	for (size_t i = m_BVHLinearNodes.size(); i-- > 0;)
+	{
+		BVHLinearNode &node = m_BVHLinearNodes[i];
+		Bounds bounds;
+		if (node.nTriangles > 0)
+		{
+			for (cl_uint j = 0; j < node.nTriangles; j++)
+				bounds.Join(CalcTriangleBounds(node.FirstTriangle + j));
+		}
+		else
+		{
+			bounds.Join(m_BVHLinearNodes[i + 1].Bounds);
+			bounds.Join(m_BVHLinearNodes[node.SecondChildOffset].Bounds);
+		}
+		node.Bounds = bounds;
+	}
+}
+
+void BVH::CalcWorldVertices(cl_uint tri, glm::vec3 &v0, glm::vec3 &v1,
+	glm::vec3 &v2) const
+{
+	cl_float3 p0 = m_Vertices[m_Triangles[tri].v0].Position;
+	cl_float3 p1 = m_Vertices[m_Triangles[tri].v1].Position;
+	cl_float3 p2 = m_Vertices[m_Triangles[tri].v2].Position;
+
+	glm::mat4 transform = m_Transforms[m_Triangles[tri].Transform];
+
+	v0 = transform * glm::vec4(p0.x, p0.y, p0.z, 1.0f);
+	v1 = transform * glm::vec4(p1.x, p1.y, p1.z, 1.0f);
+	v2 = transform * glm::vec4(p2.x, p2.y, p2.z, 1.0f);
+}
+
+Bounds BVH::CalcTriangleBounds(cl_uint tri) const
+{
+	glm::vec3 glmv0, glmv1, glmv2;
+	CalcWorldVertices(tri, glmv0, glmv1, glmv2);
+
+	cl_float3 v0 = {glmv0.x, glmv0.y, glmv0.z};
+	cl_float3 v1 = {glmv1.x, glmv1.y, glmv1.z};
+	cl_float3 v2 = {glmv2.x, glmv2.y, glmv2.z};
+
+	return Bounds(v0, v1, v2);
+}
@@ -0,0 +1,162 @@
+#include "BlueNoise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+BlueNoise::BlueNoise() : m_Size(0) {}
+
+BlueNoise::BlueNoise(cl_uint size, cl_uint seed) : m_Size(size)
+{
+	cl_uint nPixels = m_Size * m_Size;
+	m_Mask.resize(nPixels);
+
+	// Precompute Gaussian filter for every toroidal offset
+	const cl_float sigma = 1.5f;
+	m_Filter.resize(nPixels);
+	for (cl_uint y = 0; y < m_Size; y++)
+	{
+		for (cl_uint x = 0; x < m_Size; x++)
+		{
+			cl_float dx = (cl_float)std::min(x, m_Size - x);
+			cl_float dy = (cl_float)std::min(y, m_Size - y);
+			m_Filter[x + y * m_Size] =
+				exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+		}
+	}
+
+	// Random initial pattern with a tenth of pixels set
+	std::vector<bool> pattern(nPixels, false);
+	std::vector<cl_float> energy(nPixels, 0.0f);
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<cl_uint> distribution(0, nPixels - 1);
+	cl_uint nInitial = std::max<cl_uint>(nPixels / 10, 1);
+	for (cl_uint i = 0; i < nInitial;)
+	{
+		cl_uint pixel = distribution(rng);
+		if (pattern[pixel])
+			continue;
+		pattern[pixel] = true;
+		AddEnergy(energy, pixel, 1.0f);
+		i++;
+	}
+
+	// Move pixels from the tightest cluster to the largest void until the
+	// pattern is evenly distributed
+	while (true)
+	{
+		cl_uint cluster = FindTightestCluster(pattern, energy);
+		pattern[cluster] = false;
+		AddEnergy(energy, cluster, -1.0f);
+
+		cl_uint voidPixel = FindLargestVoid(pattern, energy);
+		pattern[voidPixel] = true;
+		AddEnergy(energy, voidPixel, 1.0f);
+
+		if (voidPixel == cluster)
+			break;
+	}
+	std::vector<bool> initialPattern = pattern;
+	std::vector<cl_float> initialEnergy = energy;
+	std::vector<cl_uint> ranks(nPixels, 0);
+
+	// Phase 1: rank initial pixels by removing tightest clusters
+	for (cl_int rank = nInitial - 1; rank >= 0; rank--)
+	{
+		cl_uint cluster = FindTightestCluster(pattern, energy);
+		pattern[cluster] = false;
+		AddEnergy(energy, cluster, -1.0f);
+		ranks[cluster] = rank;
+	}
+
+	// Phase 2: rank up to half by filling largest voids
+	pattern = initialPattern;
+	energy = initialEnergy;
+	for (cl_uint rank = nInitial; rank < nPixels / 2; rank++)
+	{
+		cl_uint voidPixel = FindLargestVoid(pattern, energy);
+		pattern[voidPixel] = true;
+		AddEnergy(energy, voidPixel, 1.0f);
+		ranks[voidPixel] = rank;
+	}
+
+	// Phase 3: rank the rest by filling the tightest clusters of unset pixels,
+	// which requires the energy of the unset pixels
+	std::fill(energy.begin(), energy.end(), 0.0f);
+	for (cl_uint i = 0; i < nPixels; i++)
+		if (!pattern[i])
+			AddEnergy(energy, i, 1.0f);
+	for (cl_uint rank = nPixels / 2; rank < nPixels; rank++)
+	{
+		cl_uint cluster = 0;
+		cl_float maxEnergy = -INFINITY;
+		for (cl_uint i = 0; i < nPixels; i++)
+		{
+			if (!pattern[i] && energy[i] > maxEnergy)
+			{
+				maxEnergy = energy[i];
+				cluster = i;
+			}
+		}
+		pattern[cluster] = true;
+		AddEnergy(energy, cluster, -1.0f);
+		ranks[cluster] = rank;
+	}
+
+	// Convert ranks to thresholds
+	for (cl_uint i = 0; i < nPixels; i++)
+		m_Mask[i] = ((cl_float)ranks[i] + 0.5f) / (cl_float)nPixels;
+}
+
+cl_uint BlueNoise::GetSize() const
+{
+	return m_Size;
+}
+
+void BlueNoise::AddEnergy(std::vector<cl_float> &energy, cl_uint pixel,
+	cl_float sign) const
+{
+	cl_uint px = pixel % m_Size;
+	cl_uint py = pixel / m_Size;
+	for (cl_uint y = 0; y < m_Size; y++)
+	{
+		cl_uint dy = (y + m_Size - py) % m_Size;
+		for (cl_uint x = 0; x < m_Size; x++)
+		{
+			cl_uint dx = (x + m_Size - px) % m_Size;
+			energy[x + y * m_Size] += sign * m_Filter[dx + dy * m_Size];
+		}
+	}
+}
+
+cl_uint BlueNoise::FindTightestCluster(const std::vector<bool> &pattern,
+	const std::vector<cl_float> &energy) const
+{
+	cl_uint cluster = 0;
+	cl_float maxEnergy = -INFINITY;
+	for (cl_uint i = 0; i < pattern.size(); i++)
+	{
+		if (pattern[i] && energy[i] > maxEnergy)
+		{
+			maxEnergy = energy[i];
+			cluster = i;
+		}
+	}
+	return cluster;
+}
+
+cl_uint BlueNoise::FindLargestVoid(const std::vector<bool> &pattern,
+	const std::vector<cl_float> &energy) const
+{
+	cl_uint voidPixel = 0;
+	cl_float minEnergy = INFINITY;
+	for (cl_uint i = 0; i < pattern.size(); i++)
+	{
+		if (!pattern[i] && energy[i] < minEnergy)
+		{
+			minEnergy = energy[i];
+			voidPixel = i;
+		}
+	}
+	return voidPixel;
+}
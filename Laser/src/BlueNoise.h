@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+#include <CL/cl.hpp>
+
+// Blue noise dither mask generated with the void-and-cluster method, used to
+// decorrelate low-discrepancy samples between neighbouring pixels
+class BlueNoise
+{
+public:
+	BlueNoise();
+	BlueNoise(cl_uint size, cl_uint seed);
+
+	cl_uint GetSize() const;
+
+private:
+	// Energy of each pixel from a Gaussian filter over the set pixels of the
+	// pattern (toroidally wrapped)
+	void AddEnergy(std::vector<cl_float> &energy, cl_uint pixel,
+		cl_float sign) const;
+	cl_uint FindTightestCluster(const std::vector<bool> &pattern,
+		const std::vector<cl_float> &energy) const;
+	cl_uint FindLargestVoid(const std::vector<bool> &pattern,
+		const std::vector<cl_float> &energy) const;
+
+public:
+	// Threshold of each pixel in [0, 1), row major
+	std::vector<cl_float> m_Mask;
+
+private:
+	cl_uint m_Size;
+	std::vector<cl_float> m_Filter; // Gaussian weight of each wrapped offset
+};
@@ -0,0 +1,70 @@
+#include "BufferVersions.h"
+
+#include <algorithm>
+
+namespace
+{
+// Older edits are forgotten, devices that missed them upload everything
+const size_t MAX_EDITS = 64;
+} // namespace
+
+void BufferVersions::MarkDirty(const std::string &bufferKey, size_t first,
+	size_t count)
+{
+	Buffer &buffer = m_Buffers[bufferKey];
+	buffer.Version++;
+	if (buffer.Edits.size() == MAX_EDITS)
+	{
+		buffer.AllDirtyVersion = buffer.Edits.front().Version;
+		buffer.Edits.erase(buffer.Edits.begin());
+	}
+	buffer.Edits.push_back({buffer.Version, first, first + count});
+}
+
+void BufferVersions::MarkAllDirty(const std::string &bufferKey)
+{
+	Buffer &buffer = m_Buffers[bufferKey];
+	buffer.Version++;
+	buffer.AllDirtyVersion = buffer.Version;
+	buffer.Edits.clear();
+}
+
+cl_ulong BufferVersions::GetVersion(const std::string &bufferKey) const
+{
+	auto it = m_Buffers.find(bufferKey);
+	return it == m_Buffers.end() ? 1 : it->second.Version;
+}
+
+void BufferVersions::GetDirtyRange(const std::string &bufferKey,
+	cl_ulong heldVersion, size_t &first, size_t &count, bool &all) const
+{
+	first = 0;
+	count = 0;
+	all = false;
+
+	auto it = m_Buffers.find(bufferKey);
+	cl_ulong allDirtyVersion = it == m_Buffers.end() ? 1 :
+		it->second.AllDirtyVersion;
+	if (heldVersion < allDirtyVersion)
+	{
+		all = true;
+		return;
+	}
+	if (it == m_Buffers.end())
+		return;
+
+	// Union of the edits the device hasn't received
+	size_t end = 0;
+	first = SIZE_MAX;
+	for (const Edit &edit : it->second.Edits)
+	{
+		if (edit.Version <= heldVersion)
+			continue;
+		first = std::min(first, edit.First);
+		end = std::max(end, edit.End);
+	}
+	if (first == SIZE_MAX)
+		first = 0;
+	else
+		count = end - first;
+}
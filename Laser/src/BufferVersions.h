@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <CL/cl.hpp>
+
+// Versions of host arrays mirrored in device buffers, so each device uploads
+// only what changed since its last upload of a buffer. Every edit bumps the
+// buffer's version and records the range of elements it changed.
+class BufferVersions
+{
+public:
+	// Record an edit of count elements from first
+	void MarkDirty(const std::string &bufferKey, size_t first, size_t count);
+
+	// Record a change to the whole buffer
+	void MarkAllDirty(const std::string &bufferKey);
+
+	// Current version, 1 for buffers never edited
+	cl_ulong GetVersion(const std::string &bufferKey) const;
+
+	// Range of elements to upload to a device holding heldVersion of the
+	// buffer, covering every edit since. all is set if the whole buffer must
+	// be uploaded, and count is 0 if the device is up to date.
+	void GetDirtyRange(const std::string &bufferKey, cl_ulong heldVersion,
+		size_t &first, size_t &count, bool &all) const;
+
+private:
+	struct Edit
+	{
+		cl_ulong Version;
+		size_t First;
+		size_t End;
+	};
+
+	struct Buffer
+	{
+		cl_ulong Version = 1;
+		cl_ulong AllDirtyVersion = 1; // Last change to the whole buffer
+		std::vector<Edit> Edits;	  // Edits since AllDirtyVersion
+	};
+
+	std::unordered_map<std::string, Buffer> m_Buffers;
+};
@@ -0,0 +1,1372 @@
+#include "CPURenderer.h"
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <thread>
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+#include "ThreadPool.h"
+#include "Util.h"
+
+namespace
+{
+
+// Must match the constants of cl/Laser.cl and cl/Sampler.cl
+const float EPSILON = 0.00001f;
+const float SHADOW_EPSILON = 0.001f;
+const cl_uint MAX_DEPTH = 16;
+
+const cl_uint LIGHT_SAMPLING_AREA = 0;
+const cl_uint LIGHT_SAMPLING_POWER = 1;
+const cl_uint LIGHT_SAMPLING_BVH = 2;
+const cl_uint LIGHT_SAMPLING = LIGHT_SAMPLING_BVH;
+
+const cl_uint SAMPLER_RANDOM = 0;
+const cl_uint SAMPLER_SOBOL = 1;
+const cl_uint SAMPLER_BLUE_NOISE = 2;
+
+const cl_uint SAMPLE_DIMENSION_PIXEL = 0;
+const cl_uint SAMPLE_DIMENSION_LENS = 2;
+const cl_uint SAMPLE_DIMENSION_BOUNCE = 4;
+const cl_uint SAMPLE_DIMENSION_BSDF = 0;
+const cl_uint SAMPLE_DIMENSION_LIGHT = 2;
+const cl_uint SAMPLE_DIMENSIONS_PER_BOUNCE = 5;
+
+glm::vec3 toVec3(const cl_float3 &v)
+{
+	return glm::vec3(v.x, v.y, v.z);
+}
+
+/********** RANDOM NUMBERS (cl/Random.cl, cl/Sampler.cl) **********/
+
+cl_uint PCGHash(cl_uint seed)
+{
+	cl_uint state = seed * 747796405u + 2891336453u;
+	cl_uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+cl_uint mulHi(cl_uint a, cl_uint b)
+{
+	return (cl_uint)(((cl_ulong)a * b) >> 32);
+}
+
+// Philox4x32-10, returns the first two words
+void philox4x32(cl_uint counter[4], cl_uint key0, cl_uint key1)
+{
+	for (int i = 0; i < 10; i++)
+	{
+		if (i > 0)
+		{
+			key0 += 0x9E3779B9u;
+			key1 += 0xBB67AE85u;
+		}
+
+		cl_uint hi0 = mulHi(0xD2511F53u, counter[0]);
+		cl_uint lo0 = 0xD2511F53u * counter[0];
+		cl_uint hi1 = mulHi(0xCD9E8D57u, counter[2]);
+		cl_uint lo1 = 0xCD9E8D57u * counter[2];
+		cl_uint next[4] = {hi1 ^ counter[1] ^ key0, lo1,
+			hi0 ^ counter[3] ^ key1, lo0};
+		std::copy(next, next + 4, counter);
+	}
+}
+
+cl_uint reverseBits(cl_uint x)
+{
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00FF00FFu) << 8) | ((x & 0xFF00FF00u) >> 8);
+	x = ((x & 0x0F0F0F0Fu) << 4) | ((x & 0xF0F0F0F0u) >> 4);
+	x = ((x & 0x33333333u) << 2) | ((x & 0xCCCCCCCCu) >> 2);
+	x = ((x & 0x55555555u) << 1) | ((x & 0xAAAAAAAAu) >> 1);
+	return x;
+}
+
+cl_uint hashCombine(cl_uint seed, cl_uint v)
+{
+	return seed ^ (v + 0x9E3779B9u + (seed << 6) + (seed >> 2));
+}
+
+cl_uint sobolSecondDimension(cl_uint index)
+{
+	cl_uint result = 0;
+	for (cl_uint v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+		if (index & 1)
+			result ^= v;
+	return result;
+}
+
+cl_uint laineKarrasPermutation(cl_uint x, cl_uint seed)
+{
+	x += seed;
+	x ^= x * 0x6C50B47Cu;
+	x ^= x * 0xB82F1E52u;
+	x ^= x * 0xC7AFE638u;
+	x ^= x * 0x8D22F6E6u;
+	return x;
+}
+
+cl_uint nestedUniformScramble(cl_uint x, cl_uint seed)
+{
+	return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+float toUnitFloat(cl_uint x)
+{
+	return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+glm::vec2 owenSobol2D(cl_uint index, cl_uint seed)
+{
+	index = nestedUniformScramble(index, seed);
+	cl_uint x = nestedUniformScramble(reverseBits(index), hashCombine(seed, 0));
+	cl_uint y = nestedUniformScramble(sobolSecondDimension(index),
+		hashCombine(seed, 1));
+	return glm::vec2(toUnitFloat(x), toUnitFloat(y));
+}
+
+float owenSobol1D(cl_uint index, cl_uint seed)
+{
+	index = nestedUniformScramble(index, seed);
+	return toUnitFloat(
+		nestedUniformScramble(reverseBits(index), hashCombine(seed, 0)));
+}
+
+glm::vec3 sampleUnitDisk(glm::vec2 u)
+{
+	glm::vec2 offset = u * 2.0f - 1.0f;
+	if (offset.x == 0.0f && offset.y == 0.0f)
+		return glm::vec3(0.0f);
+
+	float r, theta;
+	if (std::fabs(offset.x) > std::fabs(offset.y))
+	{
+		r = offset.x;
+		theta = (PI / 4.0f) * (offset.y / offset.x);
+	}
+	else
+	{
+		r = offset.y;
+		theta = (PI / 2.0f) - (PI / 4.0f) * (offset.x / offset.y);
+	}
+	return glm::vec3(r * std::cos(theta), r * std::sin(theta), 0.0f);
+}
+
+/********** LIGHTS (cl/Light.cl) **********/
+
+float cosSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	if (cosA > cosB)
+		return 1.0f;
+	return cosA * cosB + sinA * sinB;
+}
+
+float sinSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	if (cosA > cosB)
+		return 0.0f;
+	return sinA * cosB - cosA * sinB;
+}
+
+float calcLightPdf(float pmf, float area, float dist2, float cosLight)
+{
+	return pmf * dist2 / (cosLight * area);
+}
+
+float powerHeuristic(float a, float b)
+{
+	float a2 = a * a;
+	return a2 / (a2 + b * b);
+}
+
+/********** SSE INTERSECTION **********/
+
+// Slab test of 3 axes at once, lane 3 holds the ray interval [0, tMax]
+bool intersectBounds(const Bounds &bounds, __m128 origin, __m128 invDir,
+	float tMax)
+{
+	const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+
+	__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds.pMin.s), origin),
+		invDir);
+	__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds.pMax.s), origin),
+		invDir);
+	__m128 tNear = _mm_and_ps(_mm_min_ps(t0, t1), xyz);
+	__m128 tFar = _mm_or_ps(_mm_and_ps(_mm_max_ps(t0, t1), xyz),
+		_mm_andnot_ps(xyz, _mm_set1_ps(tMax)));
+
+	// Largest near and smallest far distance of all lanes
+	tNear = _mm_max_ps(tNear,
+		_mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(1, 0, 3, 2)));
+	tNear = _mm_max_ps(tNear,
+		_mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(2, 3, 0, 1)));
+	tFar =
+		_mm_min_ps(tFar, _mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(1, 0, 3, 2)));
+	tFar =
+		_mm_min_ps(tFar, _mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	return _mm_cvtss_f32(tNear) <= _mm_cvtss_f32(tFar);
+}
+
+} // namespace
+
+CPURenderer::CPURenderer(const BVH &bvh, const std::vector<Material> &materials,
+	const LightList &lightList, const LightBVH &lightBVH,
+	const BlueNoise &blueNoise, cl_uint samplerType)
+	: m_BVH(bvh), m_Materials(materials), m_LightList(lightList),
+	  m_LightBVH(lightBVH), m_BlueNoise(blueNoise), m_SamplerType(samplerType),
+	  m_PacketTraversal(true)
+{
+	// Transform triangles to world space once instead of at every test
+	size_t nTriangles = m_BVH.m_Triangles.size();
+	for (int axis = 0; axis < 3; axis++)
+	{
+		m_V0[axis].resize(nTriangles + 3, 0.0f);
+		m_Edge1[axis].resize(nTriangles + 3, 0.0f);
+		m_Edge2[axis].resize(nTriangles + 3, 0.0f);
+	}
+	m_GeometricNormals.resize(nTriangles);
+
+	for (cl_uint tri = 0; tri < nTriangles; tri++)
+	{
+		glm::vec3 v0, v1, v2;
+		m_BVH.CalcWorldVertices(tri, v0, v1, v2);
+		glm::vec3 edge1 = v1 - v0;
+		glm::vec3 edge2 = v2 - v0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			m_V0[axis][tri] = v0[axis];
+			m_Edge1[axis][tri] = edge1[axis];
+			m_Edge2[axis][tri] = edge2[axis];
+		}
+		m_GeometricNormals[tri] = glm::normalize(glm::cross(edge1, edge2));
+	}
+}
+
+void CPURenderer::Render(Image &image, const Camera::Props &camera,
+	cl_uint nSamples, cl_uint firstSample, cl_uint nThreads) const
+{
+	if (nThreads == 0)
+		nThreads = std::thread::hardware_concurrency();
+	ThreadPool pool(nThreads);
+
+	Image::Props props = image.GetProps();
+	cl_uint nTiles = props.nRows * props.nColumns;
+	std::cout << "Rendering " << nTiles << " tiles on " << pool.GetThreadCount()
+			  << " CPU threads" << std::endl;
+
+	// Tiles cover separate pixels, so they are written without locking
+	std::mutex printMutex;
+	cl_uint nDone = 0;
+	for (cl_uint k = 0; k < nTiles; k++)
+	{
+		pool.Submit(
+			[&, k]()
+			{
+				RenderTile(image, camera, k, nSamples, firstSample);
+
+				std::lock_guard<std::mutex> lock(printMutex);
+				std::cout << "Done tile " << ++nDone << " of " << nTiles
+						  << std::endl;
+			});
+	}
+	pool.Wait();
+}
+
+void CPURenderer::SetPacketTraversal(bool packetTraversal)
+{
+	m_PacketTraversal = packetTraversal;
+}
+
+void CPURenderer::BenchmarkPrimaryRays(const Image &image,
+	const Camera::Props &camera, cl_uint nSamples, cl_uint nThreads) const
+{
+	if (nThreads == 0)
+		nThreads = std::thread::hardware_concurrency();
+	ThreadPool pool(nThreads);
+
+	Image::Props props = image.GetProps();
+	cl_uint nTiles = props.nRows * props.nColumns;
+	double nRays = (double)props.Width * props.Height * nSamples;
+
+	std::cout << "Primary ray traversal, " << nSamples
+			  << " samples per pixel on " << pool.GetThreadCount()
+			  << " CPU threads:" << std::endl;
+
+	float singleRaysPerSecond = 0.0f;
+	cl_uint singleHits = 0;
+	for (bool packetTraversal : {false, true})
+	{
+		std::atomic<cl_uint> nHits(0);
+		auto start = std::chrono::steady_clock::now();
+		for (cl_uint k = 0; k < nTiles; k++)
+		{
+			pool.Submit(
+				[&, k, packetTraversal]()
+				{
+					nHits += IntersectCameraRays(props, camera, k, nSamples,
+						packetTraversal);
+				});
+		}
+		pool.Wait();
+		std::chrono::duration<float> time =
+			std::chrono::steady_clock::now() - start;
+
+		float raysPerSecond = (float)(nRays / time.count());
+		std::cout << (packetTraversal ? "Packets:     " : "Single rays: ")
+				  << time.count() << "s, " << raysPerSecond / 1e6f
+				  << " Mrays/s, " << nHits << " hits";
+		if (packetTraversal)
+		{
+			std::cout << ", " << raysPerSecond / singleRaysPerSecond
+					  << "x speedup";
+			if (nHits != singleHits)
+				std::cout << " (hit counts differ)";
+		}
+		std::cout << std::endl;
+
+		singleRaysPerSecond = raysPerSecond;
+		singleHits = nHits;
+	}
+}
+
+void CPURenderer::RenderTile(Image &image, const Camera::Props &camera,
+	cl_uint tile, cl_uint nSamples, cl_uint firstSample) const
+{
+	Image::Props props = image.GetProps();
+	cl_uint xOffset = (tile % props.nRows) * props.TileWidth;
+	cl_uint yOffset = (tile / props.nRows) * props.TileHeight;
+	cl_uint xEnd = std::min(xOffset + props.TileWidth, props.Width);
+	cl_uint yEnd = std::min(yOffset + props.TileHeight, props.Height);
+	cl_uint width = xEnd - xOffset;
+
+	// Samples of each pixel are added in the same order as the Laser kernel,
+	// with the camera rays of each sample traced a packet at a time
+	std::vector<glm::vec3> colors(width * (yEnd - yOffset), glm::vec3(0.0f));
+	for (cl_uint i = 0; i < nSamples; i++)
+	{
+		for (cl_uint y = yOffset; y < yEnd; y++)
+		{
+			for (cl_uint x = xOffset; x < xEnd; x += PACKET_SIZE)
+			{
+				RayPacket packet;
+				Sampler samplers[PACKET_SIZE];
+				GenerateCameraRays(props, camera, x, y, xEnd, firstSample + i,
+					packet, samplers);
+
+				if (m_PacketTraversal)
+					IntersectPacket(packet);
+				else
+				{
+					for (cl_uint r = 0; r < packet.nRays; r++)
+						packet.Hit[r] = Intersect(packet.Rays[r], packet.t[r],
+							packet.Isects[r]);
+				}
+
+				glm::vec3 *row = &colors[(y - yOffset) * width + x - xOffset];
+				for (cl_uint r = 0; r < packet.nRays; r++)
+					row[r] += Trace(packet.Rays[r], samplers[r], packet.Hit[r],
+						packet.t[r], packet.Isects[r]);
+			}
+		}
+	}
+
+	for (cl_uint y = yOffset; y < yEnd; y++)
+	{
+		for (cl_uint x = xOffset; x < xEnd; x++)
+		{
+			glm::vec3 color = colors[(y - yOffset) * width + x - xOffset];
+			color *= 1.0f / nSamples;
+			image.m_Pixels[y * props.Width + x] = {color.x, color.y, color.z};
+		}
+	}
+}
+
+void CPURenderer::GenerateCameraRays(const Image::Props &image,
+	const Camera::Props &camera, cl_uint x, cl_uint y, cl_uint xEnd,
+	cl_uint sample, RayPacket &packet, Sampler *samplers) const
+{
+	glm::vec3 position = toVec3(camera.Position);
+	glm::vec3 upperLeftCorner = toVec3(camera.UpperLeftCorner);
+	glm::vec3 horizontal = toVec3(camera.ViewportHorizontal);
+	glm::vec3 vertical = toVec3(camera.ViewportVertical);
+	glm::vec3 u = toVec3(camera.u);
+	glm::vec3 v = toVec3(camera.v);
+
+	packet.nRays = std::min(PACKET_SIZE, xEnd - x);
+	for (cl_uint r = 0; r < packet.nRays; r++)
+	{
+		Sampler &sampler = samplers[r];
+		InitSampler(sampler, x + r, y, image.Width, sample);
+
+		// Primary ray through a jittered point in the pixel and a point on
+		// the lens
+		sampler.Dimension = SAMPLE_DIMENSION_PIXEL;
+		glm::vec2 pixelSample = Sample2D(sampler);
+		float fx = ((float)(x + r) + pixelSample.x) / (float)(image.Width - 1);
+		float fy = ((float)y + pixelSample.y) / (float)(image.Height - 1);
+
+		sampler.Dimension = SAMPLE_DIMENSION_LENS;
+		glm::vec3 pointInLens =
+			camera.LensRadius * sampleUnitDisk(Sample2D(sampler));
+		glm::vec3 offset = u * pointInLens.x + v * pointInLens.y;
+
+		Ray &ray = packet.Rays[r];
+		ray.Origin = position + offset;
+		ray.Direction = glm::normalize(upperLeftCorner + fx * horizontal -
+			fy * vertical - position - offset);
+	}
+}
+
+cl_uint CPURenderer::IntersectCameraRays(const Image::Props &image,
+	const Camera::Props &camera, cl_uint tile, cl_uint nSamples,
+	bool packetTraversal) const
+{
+	cl_uint xOffset = (tile % image.nRows) * image.TileWidth;
+	cl_uint yOffset = (tile / image.nRows) * image.TileHeight;
+	cl_uint xEnd = std::min(xOffset + image.TileWidth, image.Width);
+	cl_uint yEnd = std::min(yOffset + image.TileHeight, image.Height);
+
+	cl_uint nHits = 0;
+	for (cl_uint i = 0; i < nSamples; i++)
+	{
+		for (cl_uint y = yOffset; y < yEnd; y++)
+		{
+			for (cl_uint x = xOffset; x < xEnd; x += PACKET_SIZE)
+			{
+				RayPacket packet;
+				Sampler samplers[PACKET_SIZE];
+				GenerateCameraRays(image, camera, x, y, xEnd, i, packet,
+					samplers);
+
+				if (packetTraversal)
+					IntersectPacket(packet);
+				else
+				{
+					for (cl_uint r = 0; r < packet.nRays; r++)
+						packet.Hit[r] = Intersect(packet.Rays[r], packet.t[r],
+							packet.Isects[r]);
+				}
+
+				for (cl_uint r = 0; r < packet.nRays; r++)
+					nHits += packet.Hit[r];
+			}
+		}
+	}
+	return nHits;
+}
+
+glm::vec3 CPURenderer::Trace(Ray ray, Sampler &sampler, bool hit, float t,
+	Intersection isect) const
+{
+	glm::vec3 color(0.0f);
+	glm::vec3 mask(1.0f);
+
+	// Previous diffuse vertex and pdf of its bounce for weighting emission
+	// found by BSDF sampling against light sampling
+	glm::vec3 prevP(0.0f);
+	glm::vec3 prevN(0.0f);
+	float bsdfPdf = 0.0f;
+	bool specularBounce = true;
+
+	for (cl_uint depth = 0; depth < MAX_DEPTH; depth++)
+	{
+		if (depth > 0)
+			hit = Intersect(ray, t, isect);
+		if (!hit)
+		{
+			// Add background color
+			color += mask * glm::vec3(0.2f);
+			break;
+		}
+
+		const Material &material =
+			m_Materials[m_BVH.m_Triangles[isect.TriangleIndex].Material];
+		glm::vec3 emission = toVec3(material.Emission);
+
+		// Accumulate emission, weighted with MIS if the light could also have
+		// been reached by light sampling from the previous vertex
+		cl_uint lightIndex = m_LightList.m_TriangleLights[isect.TriangleIndex];
+		if (specularBounce || lightIndex == LightList::NO_LIGHT)
+			color += mask * emission;
+		else
+		{
+			float cosLight = std::fabs(glm::dot(isect.N, ray.Direction));
+			if (cosLight > 0.0f)
+			{
+				float pmf = CalcLightSelectionPmf(prevP, prevN, lightIndex);
+				float lightPdf = calcLightPdf(pmf,
+					m_LightList.m_Lights[lightIndex].Area, t * t, cosLight);
+				color += mask * emission * powerHeuristic(bsdfPdf, lightPdf);
+			}
+		}
+
+		StartBounceDimensions(sampler, depth, SAMPLE_DIMENSION_BSDF);
+		BounceRay(ray, isect, material, sampler);
+
+		specularBounce = material.IsTransparent || material.IsMetal;
+		if (!specularBounce)
+		{
+			// Next event estimation
+			StartBounceDimensions(sampler, depth, SAMPLE_DIMENSION_LIGHT);
+			color += mask * SampleDirectLight(isect, material, sampler);
+
+			bsdfPdf = glm::dot(ray.Direction, isect.N) / PI;
+			prevP = isect.P;
+			prevN = isect.N;
+		}
+		mask *= toVec3(material.Albedo);
+	}
+	return color;
+}
+
+bool CPURenderer::Intersect(const Ray &ray, float &t,
+	Intersection &isect) const
+{
+	glm::vec3 invDir = 1.0f / ray.Direction;
+	__m128 origin = _mm_set_ps(0.0f, ray.Origin.z, ray.Origin.y, ray.Origin.x);
+	__m128 invDirection = _mm_set_ps(0.0f, invDir.z, invDir.y, invDir.x);
+	bool dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+
+	t = INFINITY;
+	bool hit = false;
+
+	cl_uint current = 0;
+	cl_uint toVisitOffset = 0;
+	cl_uint nodesToVisit[64];
+
+	while (true)
+	{
+		const BVH::BVHLinearNode &node = m_BVH.m_BVHLinearNodes[current];
+
+		// Nodes further than the closest hit so far are skipped
+		if (intersectBounds(node.Bounds, origin, invDirection, t))
+		{
+			// If node is leaf
+			if (node.nTriangles > 0)
+			{
+				hit |= IntersectLeaf(ray, node.FirstTriangle, node.nTriangles,
+					t, &isect);
+
+				if (toVisitOffset == 0)
+					break;
+				current = nodesToVisit[--toVisitOffset];
+			}
+
+			// Visit the near child first based on ray direction in split axis
+			else if (dirIsNeg[node.SplitAxis])
+			{
+				nodesToVisit[toVisitOffset++] = current + 1;
+				current = node.SecondChildOffset;
+			}
+			else
+			{
+				nodesToVisit[toVisitOffset++] = node.SecondChildOffset;
+				current++;
+			}
+		}
+		else
+		{
+			if (toVisitOffset == 0)
+				break;
+			current = nodesToVisit[--toVisitOffset];
+		}
+	}
+	return hit;
+}
+
+bool CPURenderer::Occluded(const Ray &ray, float tMax) const
+{
+	glm::vec3 invDir = 1.0f / ray.Direction;
+	__m128 origin = _mm_set_ps(0.0f, ray.Origin.z, ray.Origin.y, ray.Origin.x);
+	__m128 invDirection = _mm_set_ps(0.0f, invDir.z, invDir.y, invDir.x);
+	bool dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+
+	cl_uint current = 0;
+	cl_uint toVisitOffset = 0;
+	cl_uint nodesToVisit[64];
+
+	while (true)
+	{
+		const BVH::BVHLinearNode &node = m_BVH.m_BVHLinearNodes[current];
+
+		if (intersectBounds(node.Bounds, origin, invDirection, tMax))
+		{
+			// Any hit before tMax occludes
+			if (node.nTriangles > 0)
+			{
+				float t = tMax;
+				if (IntersectLeaf(ray, node.FirstTriangle, node.nTriangles, t,
+						nullptr))
+					return true;
+
+				if (toVisitOffset == 0)
+					break;
+				current = nodesToVisit[--toVisitOffset];
+			}
+			else if (dirIsNeg[node.SplitAxis])
+			{
+				nodesToVisit[toVisitOffset++] = current + 1;
+				current = node.SecondChildOffset;
+			}
+			else
+			{
+				nodesToVisit[toVisitOffset++] = node.SecondChildOffset;
+				current++;
+			}
+		}
+		else
+		{
+			if (toVisitOffset == 0)
+				break;
+			current = nodesToVisit[--toVisitOffset];
+		}
+	}
+	return false;
+}
+
+void CPURenderer::IntersectPacket(RayPacket &packet) const
+{
+	// Lanes past the end of the packet repeat the first ray but are never
+	// active
+	bool dirIsNeg[3];
+	bool coherent = true;
+	for (cl_uint r = 0; r < PACKET_SIZE; r++)
+	{
+		const Ray &ray = packet.Rays[r < packet.nRays ? r : 0];
+		glm::vec3 invDir = 1.0f / ray.Direction;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			packet.Origin[axis][r] = ray.Origin[axis];
+			packet.Direction[axis][r] = ray.Direction[axis];
+			packet.InvDirection[axis][r] = invDir[axis];
+			if (r == 0)
+				dirIsNeg[axis] = invDir[axis] < 0;
+			if ((invDir[axis] < 0) != dirIsNeg[axis] ||
+				std::isinf(invDir[axis]))
+				coherent = false;
+		}
+		packet.t[r] = INFINITY;
+		packet.Hit[r] = false;
+	}
+
+	// Without a common traversal order the packet would visit the union of
+	// the rays' nodes, so they are traced one at a time instead
+	if (!coherent)
+	{
+		for (cl_uint r = 0; r < packet.nRays; r++)
+			packet.Hit[r] =
+				Intersect(packet.Rays[r], packet.t[r], packet.Isects[r]);
+		return;
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float *origin = packet.Origin[axis];
+		const float *invDir = packet.InvDirection[axis];
+		packet.OriginMin[axis] =
+			*std::min_element(origin, origin + PACKET_SIZE);
+		packet.OriginMax[axis] =
+			*std::max_element(origin, origin + PACKET_SIZE);
+		packet.InvDirectionMin[axis] =
+			*std::min_element(invDir, invDir + PACKET_SIZE);
+		packet.InvDirectionMax[axis] =
+			*std::max_element(invDir, invDir + PACKET_SIZE);
+	}
+	packet.OriginMin[3] = packet.OriginMax[3] = 0.0f;
+	packet.InvDirectionMin[3] = packet.InvDirectionMax[3] = 0.0f;
+
+	// Each stack entry keeps the rays that hit its parent, so every ray visits
+	// the same nodes in the same order as it would alone
+	struct StackEntry
+	{
+		cl_uint Node;
+		int Active;
+	};
+
+	cl_uint current = 0;
+	int active = (1 << packet.nRays) - 1;
+	cl_uint toVisitOffset = 0;
+	StackEntry nodesToVisit[64];
+
+	while (true)
+	{
+		const BVH::BVHLinearNode &node = m_BVH.m_BVHLinearNodes[current];
+
+		int hits = active & IntersectPacketBounds(node.Bounds, packet);
+		if (hits)
+		{
+			// If node is leaf
+			if (node.nTriangles > 0)
+			{
+				IntersectPacketLeaf(packet, hits, node.FirstTriangle,
+					node.nTriangles);
+
+				if (toVisitOffset == 0)
+					break;
+				current = nodesToVisit[--toVisitOffset].Node;
+				active = nodesToVisit[toVisitOffset].Active;
+			}
+
+			// Visit the near child first based on the shared direction signs
+			else if (dirIsNeg[node.SplitAxis])
+			{
+				nodesToVisit[toVisitOffset++] = {current + 1, hits};
+				current = node.SecondChildOffset;
+				active = hits;
+			}
+			else
+			{
+				nodesToVisit[toVisitOffset++] = {node.SecondChildOffset, hits};
+				current++;
+				active = hits;
+			}
+		}
+		else
+		{
+			if (toVisitOffset == 0)
+				break;
+			current = nodesToVisit[--toVisitOffset].Node;
+			active = nodesToVisit[toVisitOffset].Active;
+		}
+	}
+}
+
+int CPURenderer::IntersectPacketBounds(const Bounds &bounds,
+	const RayPacket &packet) const
+{
+	// Interval arithmetic over the packet's origins and inverse directions
+	// bounds the slab distances of all its rays at once, rejecting boxes
+	// missed by the whole packet without testing each ray
+	__m128 pMin = _mm_loadu_ps(bounds.pMin.s);
+	__m128 pMax = _mm_loadu_ps(bounds.pMax.s);
+	__m128 oMin = _mm_load_ps(packet.OriginMin);
+	__m128 oMax = _mm_load_ps(packet.OriginMax);
+	__m128 invMin = _mm_load_ps(packet.InvDirectionMin);
+	__m128 invMax = _mm_load_ps(packet.InvDirectionMax);
+
+	__m128 tLow = _mm_set1_ps(INFINITY);
+	__m128 tHigh = _mm_set1_ps(-INFINITY);
+	for (__m128 d : {_mm_sub_ps(pMin, oMax), _mm_sub_ps(pMin, oMin),
+			 _mm_sub_ps(pMax, oMax), _mm_sub_ps(pMax, oMin)})
+	{
+		__m128 t0 = _mm_mul_ps(d, invMin);
+		__m128 t1 = _mm_mul_ps(d, invMax);
+		tLow = _mm_min_ps(tLow, _mm_min_ps(t0, t1));
+		tHigh = _mm_max_ps(tHigh, _mm_max_ps(t0, t1));
+	}
+
+	alignas(16) float low[4], high[4];
+	_mm_store_ps(low, tLow);
+	_mm_store_ps(high, tHigh);
+	float tNear = std::max(std::max(low[0], low[1]), std::max(low[2], 0.0f));
+	float tFar = std::min(std::min(high[0], high[1]), high[2]);
+	if (tNear > tFar)
+		return 0;
+
+	// Slab test of each ray against its closest hit so far, 4 rays at a time
+	int mask = 0;
+	for (cl_uint r = 0; r < PACKET_SIZE; r += 4)
+	{
+		__m128 near = _mm_setzero_ps();
+		__m128 far = _mm_load_ps(&packet.t[r]);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			__m128 origin = _mm_load_ps(&packet.Origin[axis][r]);
+			__m128 invDir = _mm_load_ps(&packet.InvDirection[axis][r]);
+			__m128 t0 = _mm_mul_ps(
+				_mm_sub_ps(_mm_set1_ps(bounds.pMin.s[axis]), origin), invDir);
+			__m128 t1 = _mm_mul_ps(
+				_mm_sub_ps(_mm_set1_ps(bounds.pMax.s[axis]), origin), invDir);
+			near = _mm_max_ps(near, _mm_min_ps(t0, t1));
+			far = _mm_min_ps(far, _mm_max_ps(t0, t1));
+		}
+		mask |= _mm_movemask_ps(_mm_cmple_ps(near, far)) << r;
+	}
+	return mask;
+}
+
+void CPURenderer::IntersectPacketLeaf(RayPacket &packet, int active,
+	cl_uint first, cl_uint count) const
+{
+	// Moller Trumbore of each triangle against 4 rays of the packet at a
+	// time, with the operations of IntersectLeaf in the same order so every
+	// ray finds the same hit as it would alone
+	const __m128 epsilon = _mm_set1_ps(EPSILON);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (cl_uint tri = first; tri < first + count; tri++)
+	{
+		__m128 e1x = _mm_set1_ps(m_Edge1[0][tri]);
+		__m128 e1y = _mm_set1_ps(m_Edge1[1][tri]);
+		__m128 e1z = _mm_set1_ps(m_Edge1[2][tri]);
+		__m128 e2x = _mm_set1_ps(m_Edge2[0][tri]);
+		__m128 e2y = _mm_set1_ps(m_Edge2[1][tri]);
+		__m128 e2z = _mm_set1_ps(m_Edge2[2][tri]);
+		__m128 v0x = _mm_set1_ps(m_V0[0][tri]);
+		__m128 v0y = _mm_set1_ps(m_V0[1][tri]);
+		__m128 v0z = _mm_set1_ps(m_V0[2][tri]);
+
+		for (cl_uint r = 0; r < PACKET_SIZE; r += 4)
+		{
+			int lanes = (active >> r) & 0xF;
+			if (lanes == 0)
+				continue;
+
+			__m128 dx = _mm_load_ps(&packet.Direction[0][r]);
+			__m128 dy = _mm_load_ps(&packet.Direction[1][r]);
+			__m128 dz = _mm_load_ps(&packet.Direction[2][r]);
+
+			// h = dir x edge2, a = edge1 . h
+			__m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+			__m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+			__m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+			__m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx),
+									  _mm_mul_ps(e1y, hy)),
+				_mm_mul_ps(e1z, hz));
+			__m128 valid = _mm_or_ps(_mm_cmple_ps(a, _mm_sub_ps(zero, epsilon)),
+				_mm_cmpge_ps(a, epsilon));
+
+			__m128 f = _mm_div_ps(one, a);
+			__m128 sx = _mm_sub_ps(_mm_load_ps(&packet.Origin[0][r]), v0x);
+			__m128 sy = _mm_sub_ps(_mm_load_ps(&packet.Origin[1][r]), v0y);
+			__m128 sz = _mm_sub_ps(_mm_load_ps(&packet.Origin[2][r]), v0z);
+			__m128 u = _mm_mul_ps(f,
+				_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)),
+					_mm_mul_ps(sz, hz)));
+			valid = _mm_and_ps(valid,
+				_mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+
+			// q = s x edge1
+			__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+			__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+			__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+			__m128 v = _mm_mul_ps(f,
+				_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+					_mm_mul_ps(dz, qz)));
+			valid = _mm_and_ps(valid,
+				_mm_and_ps(_mm_cmpge_ps(v, zero),
+					_mm_cmple_ps(_mm_add_ps(u, v), one)));
+
+			__m128 tt = _mm_mul_ps(f,
+				_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+					_mm_mul_ps(e2z, qz)));
+			valid = _mm_and_ps(valid,
+				_mm_and_ps(_mm_cmpgt_ps(tt, epsilon),
+					_mm_cmplt_ps(tt, _mm_load_ps(&packet.t[r]))));
+
+			int mask = _mm_movemask_ps(valid) & lanes;
+			if (mask == 0)
+				continue;
+
+			alignas(16) float ts[4], us[4], vs[4];
+			_mm_store_ps(ts, tt);
+			_mm_store_ps(us, u);
+			_mm_store_ps(vs, v);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (!(mask & (1 << lane)))
+					continue;
+
+				cl_uint ray = r + lane;
+				float t = ts[lane];
+				Intersection &isect = packet.Isects[ray];
+				packet.t[ray] = t;
+				packet.Hit[ray] = true;
+				isect.P = packet.Rays[ray].Origin +
+					t * packet.Rays[ray].Direction;
+				isect.N = m_GeometricNormals[tri];
+				isect.u = us[lane];
+				isect.v = vs[lane];
+				isect.TriangleIndex = tri;
+			}
+		}
+	}
+}
+
+bool CPURenderer::IntersectLeaf(const Ray &ray, cl_uint first, cl_uint count,
+	float &t, Intersection *isect) const
+{
+	// Moller Trumbore of 4 triangles at a time, as in cl/Triangle.cl
+	const __m128 epsilon = _mm_set1_ps(EPSILON);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+
+	__m128 ox = _mm_set1_ps(ray.Origin.x);
+	__m128 oy = _mm_set1_ps(ray.Origin.y);
+	__m128 oz = _mm_set1_ps(ray.Origin.z);
+	__m128 dx = _mm_set1_ps(ray.Direction.x);
+	__m128 dy = _mm_set1_ps(ray.Direction.y);
+	__m128 dz = _mm_set1_ps(ray.Direction.z);
+
+	bool hit = false;
+	for (cl_uint i = 0; i < count; i += 4)
+	{
+		cl_uint base = first + i;
+		__m128 e1x = _mm_loadu_ps(&m_Edge1[0][base]);
+		__m128 e1y = _mm_loadu_ps(&m_Edge1[1][base]);
+		__m128 e1z = _mm_loadu_ps(&m_Edge1[2][base]);
+		__m128 e2x = _mm_loadu_ps(&m_Edge2[0][base]);
+		__m128 e2y = _mm_loadu_ps(&m_Edge2[1][base]);
+		__m128 e2z = _mm_loadu_ps(&m_Edge2[2][base]);
+
+		// h = dir x edge2, a = edge1 . h
+		__m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+		__m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+		__m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+		__m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx),
+								  _mm_mul_ps(e1y, hy)),
+			_mm_mul_ps(e1z, hz));
+
+		// Lanes past the end of the leaf and rays parallel to the triangle
+		__m128 valid = _mm_cmplt_ps(lanes, _mm_set1_ps((float)(count - i)));
+		valid = _mm_and_ps(valid,
+			_mm_or_ps(_mm_cmple_ps(a, _mm_sub_ps(zero, epsilon)),
+				_mm_cmpge_ps(a, epsilon)));
+
+		__m128 f = _mm_div_ps(one, a);
+		__m128 sx = _mm_sub_ps(ox, _mm_loadu_ps(&m_V0[0][base]));
+		__m128 sy = _mm_sub_ps(oy, _mm_loadu_ps(&m_V0[1][base]));
+		__m128 sz = _mm_sub_ps(oz, _mm_loadu_ps(&m_V0[2][base]));
+		__m128 u = _mm_mul_ps(f,
+			_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)),
+				_mm_mul_ps(sz, hz)));
+		valid = _mm_and_ps(valid,
+			_mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+
+		// q = s x edge1
+		__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+		__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+		__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+		__m128 v = _mm_mul_ps(f,
+			_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+				_mm_mul_ps(dz, qz)));
+		valid = _mm_and_ps(valid,
+			_mm_and_ps(_mm_cmpge_ps(v, zero),
+				_mm_cmple_ps(_mm_add_ps(u, v), one)));
+
+		__m128 tt = _mm_mul_ps(f,
+			_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+				_mm_mul_ps(e2z, qz)));
+		valid = _mm_and_ps(valid,
+			_mm_and_ps(_mm_cmpgt_ps(tt, epsilon),
+				_mm_cmplt_ps(tt, _mm_set1_ps(t))));
+
+		int mask = _mm_movemask_ps(valid);
+		if (mask == 0)
+			continue;
+		if (!isect)
+			return true;
+
+		// Closest of the lanes that hit
+		alignas(16) float ts[4], us[4], vs[4];
+		_mm_store_ps(ts, tt);
+		_mm_store_ps(us, u);
+		_mm_store_ps(vs, v);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (!(mask & (1 << lane)) || ts[lane] >= t)
+				continue;
+
+			t = ts[lane];
+			isect->P = ray.Origin + t * ray.Direction;
+			isect->N = m_GeometricNormals[base + lane];
+			isect->u = us[lane];
+			isect->v = vs[lane];
+			isect->TriangleIndex = base + lane;
+		}
+		hit = true;
+	}
+	return hit;
+}
+
+void CPURenderer::BounceRay(Ray &ray, Intersection &isect,
+	const Material &material, Sampler &sampler) const
+{
+	const Triangle &triangle = m_BVH.m_Triangles[isect.TriangleIndex];
+	glm::vec3 v0n = toVec3(m_BVH.m_Vertices[triangle.v0].Normal);
+	glm::vec3 v1n = toVec3(m_BVH.m_Vertices[triangle.v1].Normal);
+	glm::vec3 v2n = toVec3(m_BVH.m_Vertices[triangle.v2].Normal);
+
+	// Flat shading if any vertex normal is degenerate, otherwise interpolate
+	// the normal and transform it to world space
+	glm::vec3 degenerate(0.0f);
+	if (v0n != degenerate && v1n != degenerate && v2n != degenerate)
+	{
+		glm::vec3 normal = v0n * (1.0f - isect.u - isect.v) + v1n * isect.u +
+			v2n * isect.v;
+		isect.N = glm::normalize(
+			glm::mat3(m_BVH.m_Transforms[triangle.Transform]) * normal);
+	}
+
+	// Process refractive materials
+	if (material.IsTransparent)
+	{
+		bool frontFace = glm::dot(ray.Direction, isect.N) < 0.0f;
+		float refractiveIndexRatio = frontFace
+			? (1.0f / material.RefractiveIndex)
+			: material.RefractiveIndex;
+
+		float cosTheta = frontFace ? glm::dot(-ray.Direction, isect.N)
+								   : glm::dot(ray.Direction, isect.N);
+		float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+		// Schlick's approximation for Fresnel effect
+		float r0 =
+			(1.0f - refractiveIndexRatio) / (1.0f + refractiveIndexRatio);
+		r0 = r0 * r0;
+		float reflectance =
+			r0 + (1.0f - r0) * std::pow((1.0f - cosTheta), 5.0f);
+
+		// Total internal reflection or Fresnel reflection
+		if (refractiveIndexRatio * sinTheta > 1.0f ||
+			reflectance > Sample1D(sampler))
+		{
+			ray.Direction = glm::normalize(ray.Direction -
+				2.0f * glm::dot(ray.Direction, isect.N) * isect.N);
+			ray.Origin = isect.P + isect.N * EPSILON;
+		}
+
+		// Refract
+		else
+		{
+			glm::vec3 rOutPerp =
+				refractiveIndexRatio * (ray.Direction + cosTheta * isect.N);
+			float lengthPerp = glm::length(rOutPerp);
+			glm::vec3 rOutParallel =
+				-std::sqrt(std::fabs(1.0f - lengthPerp * lengthPerp)) * isect.N;
+			ray.Direction = glm::normalize(rOutPerp + rOutParallel);
+			ray.Origin = frontFace ? isect.P - isect.N * EPSILON
+								   : isect.P + isect.N * EPSILON;
+		}
+	}
+
+	// Process metal
+	else if (material.IsMetal)
+	{
+		ray.Direction = glm::normalize(ray.Direction -
+			2.0f * glm::dot(ray.Direction, isect.N) * isect.N);
+		ray.Origin = isect.P + isect.N * EPSILON;
+	}
+
+	// Process diffuse with cosine-weighted hemisphere sampling
+	else
+	{
+		glm::vec2 sample = Sample2D(sampler);
+		float rand1 = 2.0f * PI * sample.x;
+		float rand2s = std::sqrt(sample.y);
+
+		glm::vec3 w = isect.N;
+		glm::vec3 axis = std::fabs(w.x) > 0.1f ? glm::vec3(0.0f, 1.0f, 0.0f)
+										  : glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 u = glm::normalize(glm::cross(axis, w));
+		glm::vec3 v = glm::cross(w, u);
+
+		ray.Direction = glm::normalize(u * std::cos(rand1) * rand2s +
+			v * std::sin(rand1) * rand2s + w * std::sqrt(1.0f - sample.y));
+		ray.Origin = isect.P + isect.N * EPSILON;
+	}
+}
+
+glm::vec3 CPURenderer::SampleDirectLight(const Intersection &isect,
+	const Material &material, Sampler &sampler) const
+{
+	glm::vec3 black(0.0f);
+
+	// Choose light and point on light
+	cl_uint lightIndex;
+	float pmf;
+	if (!ChooseLight(isect.P, isect.N, Sample1D(sampler), lightIndex, pmf))
+		return black;
+	const Light &light = m_LightList.m_Lights[lightIndex];
+
+	glm::vec3 v0, v1, v2;
+	m_BVH.CalcWorldVertices(light.TriangleIndex, v0, v1, v2);
+	glm::vec2 u = Sample2D(sampler);
+	float su1 = std::sqrt(u.x);
+	float b0 = 1.0f - su1;
+	float b1 = u.y * su1;
+	glm::vec3 lightPoint = b0 * v0 + b1 * v1 + (1.0f - b0 - b1) * v2;
+	glm::vec3 lightNormal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+
+	// Geometry terms
+	glm::vec3 toLight = lightPoint - isect.P;
+	float dist2 = glm::dot(toLight, toLight);
+	float dist = std::sqrt(dist2);
+	glm::vec3 wi = toLight / dist;
+
+	float cosSurface = glm::dot(isect.N, wi);
+	// Lights are two-sided
+	float cosLight = std::fabs(glm::dot(lightNormal, wi));
+	if (cosSurface <= 0.0f || cosLight <= 0.0f)
+		return black;
+
+	// Shadow ray
+	Ray shadowRay;
+	shadowRay.Origin = isect.P + isect.N * EPSILON;
+	shadowRay.Direction = wi;
+	if (Occluded(shadowRay, dist * (1.0f - SHADOW_EPSILON)))
+		return black;
+
+	// Weight against the pdf of cosine-weighted BSDF sampling
+	float lightPdf = calcLightPdf(pmf, light.Area, dist2, cosLight);
+	float bsdfPdf = cosSurface / PI;
+	float weight = powerHeuristic(lightPdf, bsdfPdf);
+
+	glm::vec3 emission = toVec3(
+		m_Materials[m_BVH.m_Triangles[light.TriangleIndex].Material].Emission);
+	glm::vec3 bsdf = toVec3(material.Albedo) / PI;
+
+	return bsdf * emission * cosSurface * weight / lightPdf;
+}
+
+bool CPURenderer::ChooseLight(const glm::vec3 &p, const glm::vec3 &n, float u,
+	cl_uint &lightIndex, float &pmf) const
+{
+	const std::vector<Light> &lights = m_LightList.m_Lights;
+	cl_uint nLights = (cl_uint)lights.size();
+	if (nLights == 0)
+		return false;
+
+	if (LIGHT_SAMPLING == LIGHT_SAMPLING_AREA)
+	{
+		// Binary search over the CDF
+		cl_uint low = 0;
+		cl_uint high = nLights - 1;
+		while (low < high)
+		{
+			cl_uint mid = (low + high) / 2;
+			if (lights[mid].CDF < u)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+		lightIndex = low;
+		pmf = lights[lightIndex].Area / m_LightList.m_TotalArea;
+		return true;
+	}
+
+	if (LIGHT_SAMPLING == LIGHT_SAMPLING_POWER)
+	{
+		const std::vector<LightAliasEntry> &table = m_LightList.m_AliasTable;
+		float scaled = u * nLights;
+		cl_uint entry = std::min((cl_uint)scaled, nLights - 1);
+		lightIndex = scaled - entry < table[entry].Probability
+			? entry
+			: table[entry].Alias;
+		pmf = table[lightIndex].Pmf;
+		return pmf > 0.0f;
+	}
+
+	// Descend light BVH, choosing children in proportion to their importance
+	// and reusing the remaining range of u at each level
+	const std::vector<LightBVH::LightBVHNode> &nodes = m_LightBVH.m_Nodes;
+	cl_uint current = 0;
+	pmf = 1.0f;
+	while (!nodes[current].IsLeaf)
+	{
+		cl_uint child0 = current + 1;
+		cl_uint child1 = nodes[current].SecondChildOffset;
+		float importance0 = CalcLightBVHImportance(nodes[child0], p, n);
+		float importance1 = CalcLightBVHImportance(nodes[child1], p, n);
+		if (importance0 == 0.0f && importance1 == 0.0f)
+			return false;
+
+		float p0 = importance0 / (importance0 + importance1);
+		if (u < p0)
+		{
+			current = child0;
+			u = std::min(u / p0, 0.99999994f);
+			pmf *= p0;
+		}
+		else
+		{
+			current = child1;
+			u = std::min((u - p0) / (1.0f - p0), 0.99999994f);
+			pmf *= 1.0f - p0;
+		}
+	}
+	lightIndex = nodes[current].LightIndex;
+	return true;
+}
+
+float CPURenderer::CalcLightSelectionPmf(const glm::vec3 &p,
+	const glm::vec3 &n, cl_uint lightIndex) const
+{
+	if (LIGHT_SAMPLING == LIGHT_SAMPLING_AREA)
+		return m_LightList.m_Lights[lightIndex].Area / m_LightList.m_TotalArea;
+
+	if (LIGHT_SAMPLING == LIGHT_SAMPLING_POWER)
+		return m_LightList.m_AliasTable[lightIndex].Pmf;
+
+	// Follow the light's bit trail from the root
+	const std::vector<LightBVH::LightBVHNode> &nodes = m_LightBVH.m_Nodes;
+	cl_uint bitTrail = m_LightList.m_Lights[lightIndex].BitTrail;
+	cl_uint current = 0;
+	float pmf = 1.0f;
+	while (!nodes[current].IsLeaf)
+	{
+		cl_uint child0 = current + 1;
+		cl_uint child1 = nodes[current].SecondChildOffset;
+		float importance0 = CalcLightBVHImportance(nodes[child0], p, n);
+		float importance1 = CalcLightBVHImportance(nodes[child1], p, n);
+		if (importance0 == 0.0f && importance1 == 0.0f)
+			return 0.0f;
+
+		if (bitTrail & 1)
+		{
+			pmf *= importance1 / (importance0 + importance1);
+			current = child1;
+		}
+		else
+		{
+			pmf *= importance0 / (importance0 + importance1);
+			current = child0;
+		}
+		bitTrail >>= 1;
+	}
+	return pmf;
+}
+
+float CPURenderer::CalcLightBVHImportance(const LightBVH::LightBVHNode &node,
+	const glm::vec3 &p, const glm::vec3 &n) const
+{
+	glm::vec3 pMin = toVec3(node.Bounds.pMin);
+	glm::vec3 pMax = toVec3(node.Bounds.pMax);
+	glm::vec3 center = (pMin + pMax) * 0.5f;
+	glm::vec3 diagonal = pMax - pMin;
+
+	glm::vec3 wi = p - center;
+	float dist2 = glm::dot(wi, wi);
+	wi = dist2 > 0.0f ? wi / std::sqrt(dist2) : n;
+
+	// Angle between cone axis and direction to the shading point
+	float cosThetaW = std::fabs(glm::dot(toVec3(node.Axis), wi));
+	float sinThetaW = std::sqrt(std::max(0.0f, 1.0f - cosThetaW * cosThetaW));
+
+	// Angle subtended by the node's bounding sphere
+	float radius2 = glm::dot(diagonal, diagonal) * 0.25f;
+	float cosThetaB = -1.0f;
+	float sinThetaB = 0.0f;
+	if (dist2 > radius2)
+	{
+		float sin2ThetaB = radius2 / dist2;
+		cosThetaB = std::sqrt(std::max(0.0f, 1.0f - sin2ThetaB));
+		sinThetaB = std::sqrt(sin2ThetaB);
+	}
+
+	// Minimum angle between any emitter normal and the shading point
+	float sinThetaO =
+		std::sqrt(std::max(0.0f, 1.0f - node.CosThetaO * node.CosThetaO));
+	float cosThetaX =
+		cosSubClamped(sinThetaW, cosThetaW, sinThetaO, node.CosThetaO);
+	float sinThetaX =
+		sinSubClamped(sinThetaW, cosThetaW, sinThetaO, node.CosThetaO);
+	float cosThetaP =
+		cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP <= node.CosThetaE)
+		return 0.0f;
+
+	// Maximum cosine at the shading point towards the node
+	float cosThetaI = glm::dot(n, -wi);
+	float sinThetaI = std::sqrt(std::max(0.0f, 1.0f - cosThetaI * cosThetaI));
+	float cosThetaIP =
+		cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+	if (cosThetaIP <= 0.0f)
+		return 0.0f;
+
+	// Clamped to the bounding sphere's radius like the device version
+	dist2 = std::max(dist2, radius2);
+	return node.Power * cosThetaP * cosThetaIP / dist2;
+}
+
+void CPURenderer::InitSampler(Sampler &sampler, cl_uint x, cl_uint y,
+	cl_uint width, cl_uint index) const
+{
+	sampler.x = x;
+	sampler.y = y;
+	sampler.Pixel = x + y * width;
+	sampler.PixelSeed = PCGHash(sampler.Pixel);
+	sampler.Index = index;
+	sampler.Dimension = 0;
+}
+
+void CPURenderer::StartBounceDimensions(Sampler &sampler, cl_uint depth,
+	cl_uint offset) const
+{
+	sampler.Dimension = SAMPLE_DIMENSION_BOUNCE +
+		depth * SAMPLE_DIMENSIONS_PER_BOUNCE + offset;
+}
+
+float CPURenderer::BlueNoiseShift(const Sampler &sampler,
+	cl_uint dimension) const
+{
+	cl_uint size = m_BlueNoise.GetSize();
+	cl_uint offset = PCGHash(dimension);
+	cl_uint mx = (sampler.x + offset) % size;
+	cl_uint my = (sampler.y + (offset >> 16)) % size;
+	return m_BlueNoise.m_Mask[mx + my * size];
+}
+
+float CPURenderer::Sample1D(Sampler &sampler) const
+{
+	cl_uint dimension = sampler.Dimension++;
+	switch (m_SamplerType)
+	{
+	case SAMPLER_SOBOL:
+		return owenSobol1D(sampler.Index,
+			hashCombine(sampler.PixelSeed, dimension));
+
+	case SAMPLER_BLUE_NOISE:
+	{
+		float u = owenSobol1D(sampler.Index, PCGHash(dimension)) +
+			BlueNoiseShift(sampler, dimension);
+		return u >= 1.0f ? u - 1.0f : u;
+	}
+
+	case SAMPLER_RANDOM:
+	default:
+	{
+		cl_uint counter[4] = {sampler.Pixel, sampler.Index, dimension, 0};
+		philox4x32(counter, 0xA511E9B3u, 0x63D83595u);
+		return toUnitFloat(counter[0]);
+	}
+	}
+}
+
+glm::vec2 CPURenderer::Sample2D(Sampler &sampler) const
+{
+	cl_uint dimension = sampler.Dimension;
+	sampler.Dimension += 2;
+	switch (m_SamplerType)
+	{
+	case SAMPLER_SOBOL:
+		return owenSobol2D(sampler.Index,
+			hashCombine(sampler.PixelSeed, dimension));
+
+	case SAMPLER_BLUE_NOISE:
+	{
+		glm::vec2 u = owenSobol2D(sampler.Index, PCGHash(dimension));
+		u.x += BlueNoiseShift(sampler, dimension);
+		u.y += BlueNoiseShift(sampler, dimension + 1);
+		return glm::vec2(u.x >= 1.0f ? u.x - 1.0f : u.x,
+			u.y >= 1.0f ? u.y - 1.0f : u.y);
+	}
+
+	case SAMPLER_RANDOM:
+	default:
+	{
+		cl_uint counter[4] = {sampler.Pixel, sampler.Index, dimension, 0};
+		philox4x32(counter, 0xA511E9B3u, 0x63D83595u);
+		return glm::vec2(toUnitFloat(counter[0]), toUnitFloat(counter[1]));
+	}
+	}
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <vector>
+
+#include <CL/cl.hpp>
+#include <glm/glm.hpp>
+
+#include "BVH.h"
+#include "BlueNoise.h"
+#include "Camera.h"
+#include "Image.h"
+#include "LightBVH.h"
+#include "LightList.h"
+#include "Material.h"
+
+// Renders the same scene data as the Laser kernel on the host, for machines
+// without a usable OpenCL device. Mirrors trace and bounceRay of cl/Laser.cl
+// and cl/Material.cl, with tiles spread over a work-stealing thread pool and
+// SSE ray-box and ray-triangle tests.
+class CPURenderer
+{
+public:
+	CPURenderer(const BVH &bvh, const std::vector<Material> &materials,
+		const LightList &lightList, const LightBVH &lightBVH,
+		const BlueNoise &blueNoise, cl_uint samplerType);
+
+	// Render every tile of the image with samples [firstSample, firstSample +
+	// nSamples) of each pixel, nThreads = 0 uses every hardware thread
+	void Render(Image &image, const Camera::Props &camera, cl_uint nSamples,
+		cl_uint firstSample, cl_uint nThreads = 0) const;
+
+	// Find the first hit of camera rays in packets of neighbouring pixels
+	// instead of one ray at a time
+	void SetPacketTraversal(bool packetTraversal);
+
+	// Time closest hit traversal of nSamples camera rays per pixel with
+	// packets and with single rays and print the throughput of both
+	void BenchmarkPrimaryRays(const Image &image, const Camera::Props &camera,
+		cl_uint nSamples, cl_uint nThreads = 0) const;
+
+private:
+	struct Ray
+	{
+		glm::vec3 Origin;
+		glm::vec3 Direction;
+	};
+
+	struct Intersection
+	{
+		glm::vec3 P;
+		glm::vec3 N;
+		float u, v; // Barycentric coordinates
+		cl_uint TriangleIndex;
+	};
+
+	// Sample generator of one pixel sample, as in cl/Sampler.cl
+	struct Sampler
+	{
+		cl_uint x;
+		cl_uint y;
+		cl_uint Pixel;
+		cl_uint PixelSeed;
+		cl_uint Index;
+		cl_uint Dimension;
+	};
+
+	// Camera rays of up to PACKET_SIZE neighbouring pixels of a row. Origins,
+	// directions and inverse directions are also stored in structure of
+	// arrays layout, with bounds over the packet for the interval test of
+	// nodes.
+	static constexpr cl_uint PACKET_SIZE = 8;
+	struct RayPacket
+	{
+		alignas(16) float Origin[3][PACKET_SIZE];
+		alignas(16) float Direction[3][PACKET_SIZE];
+		alignas(16) float InvDirection[3][PACKET_SIZE];
+		alignas(16) float t[PACKET_SIZE];
+		alignas(16) float OriginMin[4];
+		alignas(16) float OriginMax[4];
+		alignas(16) float InvDirectionMin[4];
+		alignas(16) float InvDirectionMax[4];
+		Ray Rays[PACKET_SIZE];
+		Intersection Isects[PACKET_SIZE];
+		bool Hit[PACKET_SIZE];
+		cl_uint nRays;
+	};
+
+	void RenderTile(Image &image, const Camera::Props &camera, cl_uint tile,
+		cl_uint nSamples, cl_uint firstSample) const;
+	void GenerateCameraRays(const Image::Props &image,
+		const Camera::Props &camera, cl_uint x, cl_uint y, cl_uint xEnd,
+		cl_uint sample, RayPacket &packet, Sampler *samplers) const;
+	cl_uint IntersectCameraRays(const Image::Props &image,
+		const Camera::Props &camera, cl_uint tile, cl_uint nSamples,
+		bool packetTraversal) const;
+
+	// Path from a first hit found by the caller, alone or in a packet
+	glm::vec3 Trace(Ray ray, Sampler &sampler, bool hit, float t,
+		Intersection isect) const;
+
+	// Closest hit and any hit traversal of the BVH
+	bool Intersect(const Ray &ray, float &t, Intersection &isect) const;
+	bool Occluded(const Ray &ray, float tMax) const;
+	bool IntersectLeaf(const Ray &ray, cl_uint first, cl_uint count, float &t,
+		Intersection *isect) const;
+
+	// Closest hit traversal of a packet, falling back to single rays when
+	// direction signs differ within it
+	void IntersectPacket(RayPacket &packet) const;
+	int IntersectPacketBounds(const Bounds &bounds,
+		const RayPacket &packet) const;
+	void IntersectPacketLeaf(RayPacket &packet, int active, cl_uint first,
+		cl_uint count) const;
+
+	// Materials and lights
+	void BounceRay(Ray &ray, Intersection &isect, const Material &material,
+		Sampler &sampler) const;
+	glm::vec3 SampleDirectLight(const Intersection &isect,
+		const Material &material, Sampler &sampler) const;
+	bool ChooseLight(const glm::vec3 &p, const glm::vec3 &n, float u,
+		cl_uint &lightIndex, float &pmf) const;
+	float CalcLightSelectionPmf(const glm::vec3 &p, const glm::vec3 &n,
+		cl_uint lightIndex) const;
+	float CalcLightBVHImportance(const LightBVH::LightBVHNode &node,
+		const glm::vec3 &p, const glm::vec3 &n) const;
+
+	// Samples
+	void InitSampler(Sampler &sampler, cl_uint x, cl_uint y, cl_uint width,
+		cl_uint index) const;
+	void StartBounceDimensions(Sampler &sampler, cl_uint depth,
+		cl_uint offset) const;
+	float Sample1D(Sampler &sampler) const;
+	glm::vec2 Sample2D(Sampler &sampler) const;
+	float BlueNoiseShift(const Sampler &sampler, cl_uint dimension) const;
+
+	const BVH &m_BVH;
+	const std::vector<Material> &m_Materials;
+	const LightList &m_LightList;
+	const LightBVH &m_LightBVH;
+	const BlueNoise &m_BlueNoise;
+	cl_uint m_SamplerType;
+	bool m_PacketTraversal;
+
+	// World space triangles in structure of arrays layout, padded to a
+	// multiple of 4 so leaves can be tested 4 triangles at a time
+	std::vector<float> m_V0[3];
+	std::vector<float> m_Edge1[3];
+	std::vector<float> m_Edge2[3];
+	std::vector<glm::vec3> m_GeometricNormals;
+};
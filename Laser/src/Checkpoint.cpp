@@ -0,0 +1,149 @@
+#include "Checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+const char MAGIC[8] = {'L', 'A', 'S', 'E', 'R', 'C', 'P', '1'};
+}
+
+Checkpoint::Checkpoint() : m_Failed(false)
+{
+}
+
+Checkpoint::~Checkpoint()
+{
+	Wait();
+}
+
+bool Checkpoint::Load(const std::string &filepath, Header &header,
+	std::vector<cl_float3> &accumulation, bool &found)
+{
+	found = false;
+	std::ifstream file(filepath, std::ios::binary);
+	if (!file.good())
+		return true;
+
+	char magic[sizeof(MAGIC)];
+	Header saved;
+	file.read(magic, sizeof(magic));
+	file.read((char *)&saved, sizeof(saved));
+	if (!file || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+	{
+		std::cout << "Invalid checkpoint " << filepath << "." << std::endl;
+		return false;
+	}
+
+	// Resuming another render's sums would silently corrupt this one
+	if (saved.SceneHash != header.SceneHash || saved.Width != header.Width ||
+		saved.Height != header.Height ||
+		saved.SamplerType != header.SamplerType ||
+		saved.SamplesPerPass != header.SamplesPerPass ||
+		saved.FirstSample != header.FirstSample ||
+		saved.nSamples != header.nSamples ||
+		saved.nAccumulatedSamples % saved.SamplesPerPass != 0 ||
+		saved.nAccumulatedSamples >= saved.nSamples)
+	{
+		std::cout << "Ignoring checkpoint " << filepath
+				  << " of a different scene or settings." << std::endl;
+		return true;
+	}
+
+	accumulation.resize((size_t)header.Width * header.Height);
+	file.read((char *)accumulation.data(),
+		accumulation.size() * sizeof(cl_float3));
+	if (!file)
+	{
+		std::cout << "Truncated checkpoint " << filepath << "." << std::endl;
+		return false;
+	}
+
+	header.nAccumulatedSamples = saved.nAccumulatedSamples;
+	found = true;
+	return true;
+}
+
+std::vector<cl_float3> &Checkpoint::AcquireBuffer(size_t nPixels)
+{
+	Wait();
+	m_Buffer.resize(nPixels);
+	return m_Buffer;
+}
+
+bool Checkpoint::SaveAsync(const std::string &filepath, const Header &header,
+	const cl::Event &readEvent)
+{
+	if (!Wait())
+		return false;
+	m_Worker = std::thread(
+		[this, filepath, header, readEvent]
+		{ m_Failed = !Write(filepath, header, readEvent); });
+	return true;
+}
+
+bool Checkpoint::Wait()
+{
+	if (m_Worker.joinable())
+		m_Worker.join();
+	return !m_Failed;
+}
+
+void Checkpoint::Remove(const std::string &filepath)
+{
+	Wait();
+	std::remove(filepath.c_str());
+}
+
+cl_ulong Checkpoint::Hash(const void *data, size_t size, cl_ulong hash)
+{
+	const cl_uchar *bytes = (const cl_uchar *)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+bool Checkpoint::Write(const std::string &filepath, const Header &header,
+	cl::Event readEvent)
+{
+	cl_int eventError = readEvent.wait();
+	if (eventError)
+	{
+		std::cout << "OpenCL event error: " << eventError << std::endl;
+		return false;
+	}
+
+	std::string temporaryPath = filepath + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file.write(MAGIC, sizeof(MAGIC));
+		file.write((const char *)&header, sizeof(header));
+		file.write((const char *)m_Buffer.data(),
+			m_Buffer.size() * sizeof(cl_float3));
+		if (!file)
+		{
+			std::cout << "Failed to write checkpoint " << temporaryPath << "."
+					  << std::endl;
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, filepath, error);
+	if (error)
+	{
+		std::cout << "Failed to replace checkpoint " << filepath << ": "
+				  << error.message() << std::endl;
+		return false;
+	}
+
+	std::cout << "Saved checkpoint at " << header.nAccumulatedSamples
+			  << " samples per pixel." << std::endl;
+	return true;
+}
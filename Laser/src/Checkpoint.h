@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <CL/cl.hpp>
+
+// Running sums of a render saved between passes, so a preempted render can
+// resume from the last checkpoint instead of starting over. Files are written
+// on a worker thread to a temporary file that then replaces the checkpoint, so
+// a crash while writing leaves the previous checkpoint intact.
+class Checkpoint
+{
+public:
+	// Identifies the render a checkpoint belongs to. Every pixel has the same
+	// number of samples after each pass, so one count covers the image, and
+	// the sample indices continue from firstSample plus that count.
+	struct Header
+	{
+		cl_ulong SceneHash;
+		cl_uint Width;
+		cl_uint Height;
+		cl_uint SamplerType;
+		cl_uint SamplesPerPass;
+		cl_uint FirstSample;
+		cl_uint nSamples;
+		cl_uint nAccumulatedSamples;
+	};
+
+	Checkpoint();
+	~Checkpoint();
+
+	// found is false if there is no checkpoint or it belongs to another
+	// render. Otherwise nAccumulatedSamples of header is set from the file.
+	bool Load(const std::string &filepath, Header &header,
+		std::vector<cl_float3> &accumulation, bool &found);
+
+	// Host memory for the running sums of the next save, once the previous
+	// save has finished with it
+	std::vector<cl_float3> &AcquireBuffer(size_t nPixels);
+
+	// Write the buffer on the worker thread once readEvent completes
+	bool SaveAsync(const std::string &filepath, const Header &header,
+		const cl::Event &readEvent);
+
+	// Wait for the last save, false if any failed
+	bool Wait();
+
+	// Delete the checkpoint of a finished render
+	void Remove(const std::string &filepath);
+
+	// FNV-1a hash of bytes, continuing from hash
+	static cl_ulong Hash(const void *data, size_t size,
+		cl_ulong hash = 0xCBF29CE484222325ull);
+
+private:
+	bool Write(const std::string &filepath, const Header &header,
+		cl::Event readEvent);
+
+	std::vector<cl_float3> m_Buffer;
+	std::thread m_Worker;
+	bool m_Failed;
+};
@@ -1,81 +1,259 @@
-#include "Image.h"
-
-#include <iostream>
-#include <fstream>
-
-Image::Image(cl_uint width, cl_uint height, cl_uint tileWidth,
-	cl_uint tileHeight, Format format)
-{
-	m_Props.Width = width;
-	m_Props.Height = height;
-	m_Props.TileWidth = tileWidth;
-	m_Props.TileHeight = tileHeight;
-	m_Props.AspectRatio = (float)width / (float)height;
-	m_Props.nRows = 0;
-	m_Props.nColumns = 0;
-	m_Props.Format = format;
-
-	m_Pixels.resize(m_Props.Height);
-	for (int i = 0; i < m_Props.Height; i++)
-		m_Pixels[i].resize(m_Props.Width);
-}
-
-bool Image::WriteToFile(const std::string &filepath) const
-{
-	std::cout << "Writing to file \"" << filepath << "\"..." << std::endl;
-
-	// Open file and ensure it was successfully created
-	FILE *outputFile = nullptr;
-	fopen_s(&outputFile, filepath.c_str(), "w");
-	if (!outputFile)
-	{
-		std::cout << "Failed to open file " << filepath << "." << std::endl;
-		return false;
-	}
-
-	switch (m_Props.Format)
-	{
-	case Format::ppm:
-	default:
-		fprintf(outputFile, "P3\n%d %d\n%d\n", m_Props.Width, m_Props.Height,
-			255);
-
-		// Convert each pixel's RGB values from [0.0f, 1.0f] to [0, 255] and
-		// write to file
-		for (int j = 0; j < m_Props.Height; j++)
-		{
-			for (int i = 0; i < m_Props.Width; i++)
-			{
-				fprintf(outputFile, "%d %d %d ",
-					(cl_int)(clamp(m_Pixels[j][i].x) * 255),
-					(cl_int)(clamp(m_Pixels[j][i].y) * 255),
-					(cl_int)(clamp(m_Pixels[j][i].z) * 255));
-			}
-		}
-	}
-
-	fclose(outputFile);
-	std::cout << "Finished writing to file." << std::endl;
-	return true;
-}
-
-void Image::CalcTileRowsAndColumns(cl_uint &nRows, cl_uint &nColumns) const
-{
-	nRows = m_Props.Width / m_Props.TileWidth;
-	nColumns = m_Props.Height / m_Props.TileHeight;
-	if (m_Props.Width % m_Props.TileWidth != 0)
-		nRows++;
-	if (m_Props.Height % m_Props.TileHeight != 0)
-		nColumns++;
-}
-
-void Image::SetTileRowsAndColumns(cl_uint nRows, cl_uint nColumns)
-{
-	m_Props.nRows = nRows;
-	m_Props.nColumns = nColumns;
-}
-
-Image::Props Image::GetProps() const
-{
-	return m_Props;
-}
+#include "Image.h"
+
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "PNGEncoder.h"
+
+Image::Image(cl_uint width, cl_uint height, cl_uint tileWidth,
+	cl_uint tileHeight, Format format, bool inMemory)
+{
+	m_Props.Width = width;
+	m_Props.Height = height;
+	m_Props.TileWidth = tileWidth;
+	m_Props.TileHeight = tileHeight;
+	m_Props.AspectRatio = (float)width / (float)height;
+	m_Props.nRows = 0;
+	m_Props.nColumns = 0;
+	m_Props.Format = format;
+	m_OutputRegion = {0, 0, width, height};
+
+	if (inMemory)
+		m_Pixels.resize(m_Props.Width * m_Props.Height);
+}
+
+bool Image::WriteToFile(const std::string &filepath) const
+{
+	std::cout << "Writing to file \"" << filepath << "\"..." << std::endl;
+	auto start = std::chrono::steady_clock::now();
+
+	// Encode the whole file in memory, then write it at once
+	std::vector<cl_uchar> file;
+	switch (m_Props.Format)
+	{
+	case Format::pfm:
+		if (!EncodePFM(file))
+			return false;
+		break;
+	case Format::png:
+		EncodePNG(file);
+		break;
+	case Format::ppm:
+	default:
+		EncodePPM(file);
+	}
+
+	// Open file and ensure it was successfully created
+	std::ofstream outputFile(filepath, std::ios::binary);
+	if (!outputFile)
+	{
+		std::cout << "Failed to open file " << filepath << "." << std::endl;
+		return false;
+	}
+	outputFile.write((const char *)file.data(), file.size());
+	if (!outputFile)
+	{
+		std::cout << "Failed to write file " << filepath << "." << std::endl;
+		return false;
+	}
+
+	std::chrono::duration<float> time =
+		std::chrono::steady_clock::now() - start;
+	std::cout << "Finished writing to file in " << time.count() << "s."
+			  << std::endl;
+	return true;
+}
+
+const char *Image::GetFileExtension() const
+{
+	switch (m_Props.Format)
+	{
+	case Format::pfm:
+		return "pfm";
+	case Format::png:
+		return "png";
+	case Format::ppm:
+	default:
+		return "ppm";
+	}
+}
+
+void Image::GetRGB8(std::vector<cl_uchar> &rgb) const
+{
+	const Region &region = m_OutputRegion;
+	rgb.resize(3 * (size_t)region.Width * region.Height);
+
+	// Pixels tonemapped on the device are already quantized, otherwise
+	// convert each pixel's RGB values from [0.0f, 1.0f] to [0, 255]
+	cl_uchar *out = rgb.data();
+	for (cl_uint y = region.y; y < region.y + region.Height; y++)
+	{
+		size_t first = (size_t)y * m_Props.Width + region.x;
+		if (!m_LDRPixels.empty())
+		{
+			const cl_uchar4 *pixels = &m_LDRPixels[first];
+			for (cl_uint i = 0; i < region.Width; i++, out += 3)
+			{
+				out[0] = pixels[i].x;
+				out[1] = pixels[i].y;
+				out[2] = pixels[i].z;
+			}
+			continue;
+		}
+
+		const cl_float3 *pixels = &m_Pixels[first];
+		for (cl_uint i = 0; i < region.Width; i++, out += 3)
+		{
+			out[0] = (cl_uchar)(clamp(pixels[i].x) * 255);
+			out[1] = (cl_uchar)(clamp(pixels[i].y) * 255);
+			out[2] = (cl_uchar)(clamp(pixels[i].z) * 255);
+		}
+	}
+}
+
+void Image::EncodePPM(std::vector<cl_uchar> &file) const
+{
+	// Binary P6 header followed by 3 bytes per pixel, crops are preceded by a
+	// comment with their offset and the size of the full image
+	const Region &region = m_OutputRegion;
+	std::string header = "P6\n";
+	if (IsCropped())
+		header += "# Offset " + std::to_string(region.x) + " " +
+			std::to_string(region.y) + " of " +
+			std::to_string(m_Props.Width) + "x" +
+			std::to_string(m_Props.Height) + "\n";
+	header += std::to_string(region.Width) + " " +
+		std::to_string(region.Height) + "\n255\n";
+	std::vector<cl_uchar> rgb;
+	GetRGB8(rgb);
+
+	file.reserve(header.size() + rgb.size());
+	file.assign(header.begin(), header.end());
+	file.insert(file.end(), rgb.begin(), rgb.end());
+}
+
+bool Image::EncodePFM(std::vector<cl_uchar> &file) const
+{
+	if (!m_LDRPixels.empty())
+	{
+		std::cout << "PFM output needs the radiance, which isn't read back "
+					 "when tonemapping on the device."
+				  << std::endl;
+		return false;
+	}
+	if (IsCropped())
+	{
+		std::cout << "PFM headers can't record the offset of a crop, which "
+					 "can only be written into a full image file."
+				  << std::endl;
+		return false;
+	}
+
+	// Negative scale means little endian floats, rows are stored bottom to
+	// top
+	std::string header = "PF\n" + std::to_string(m_Props.Width) + " " +
+		std::to_string(m_Props.Height) + "\n-1.0\n";
+	size_t rowSize = 3 * m_Props.Width * sizeof(cl_float);
+	file.resize(header.size() + m_Props.Height * rowSize);
+	std::memcpy(file.data(), header.data(), header.size());
+
+	std::vector<cl_float> row(3 * m_Props.Width);
+	for (cl_uint y = 0; y < m_Props.Height; y++)
+	{
+		const cl_float3 *pixels = &m_Pixels[y * m_Props.Width];
+		for (cl_uint x = 0; x < m_Props.Width; x++)
+		{
+			row[3 * x] = pixels[x].x;
+			row[3 * x + 1] = pixels[x].y;
+			row[3 * x + 2] = pixels[x].z;
+		}
+		std::memcpy(&file[header.size() + (m_Props.Height - 1 - y) * rowSize],
+			row.data(), rowSize);
+	}
+	return true;
+}
+
+void Image::EncodePNG(std::vector<cl_uchar> &file) const
+{
+	std::vector<cl_uchar> rgb;
+	GetRGB8(rgb);
+
+	PNGEncoder encoder(std::max(1u, std::thread::hardware_concurrency()));
+	encoder.Encode(rgb, m_OutputRegion.Width, m_OutputRegion.Height, file,
+		m_OutputRegion.x, m_OutputRegion.y);
+}
+
+cl_float Image::CalcRMSE(const std::vector<cl_float3> &reference) const
+{
+	double sumSquaredError = 0.0;
+	for (size_t i = 0; i < m_Pixels.size(); i++)
+	{
+		double dx = m_Pixels[i].x - reference[i].x;
+		double dy = m_Pixels[i].y - reference[i].y;
+		double dz = m_Pixels[i].z - reference[i].z;
+		sumSquaredError += dx * dx + dy * dy + dz * dz;
+	}
+	return (cl_float)sqrt(
+		sumSquaredError / (3.0 * m_Props.Width * m_Props.Height));
+}
+
+void Image::CalcTileRegion(cl_uint xOffset, cl_uint yOffset, cl_uint &width,
+	cl_uint &height) const
+{
+	width = std::min(m_Props.TileWidth, m_Props.Width - xOffset);
+	height = std::min(m_Props.TileHeight, m_Props.Height - yOffset);
+}
+
+void Image::CalcTileRowsAndColumns(cl_uint &nRows, cl_uint &nColumns) const
+{
+	nRows = m_Props.Width / m_Props.TileWidth;
+	nColumns = m_Props.Height / m_Props.TileHeight;
+	if (m_Props.Width % m_Props.TileWidth != 0)
+		nRows++;
+	if (m_Props.Height % m_Props.TileHeight != 0)
+		nColumns++;
+}
+
+void Image::SetTileRowsAndColumns(cl_uint nRows, cl_uint nColumns)
+{
+	m_Props.nRows = nRows;
+	m_Props.nColumns = nColumns;
+}
+
+void Image::SetTileSize(cl_uint tileWidth, cl_uint tileHeight)
+{
+	m_Props.TileWidth = tileWidth;
+	m_Props.TileHeight = tileHeight;
+
+	cl_uint nRows = 0;
+	cl_uint nColumns = 0;
+	CalcTileRowsAndColumns(nRows, nColumns);
+	SetTileRowsAndColumns(nRows, nColumns);
+}
+
+Image::Props Image::GetProps() const
+{
+	return m_Props;
+}
+
+void Image::SetOutputRegion(const Region &region)
+{
+	m_OutputRegion = region;
+}
+
+Image::Region Image::GetOutputRegion() const
+{
+	return m_OutputRegion;
+}
+
+bool Image::IsCropped() const
+{
+	return m_OutputRegion.x != 0 || m_OutputRegion.y != 0 ||
+		m_OutputRegion.Width != m_Props.Width ||
+		m_OutputRegion.Height != m_Props.Height;
+}
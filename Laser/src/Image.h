@@ -1,58 +1,91 @@
-#pragma once
-
-#include <vector>
-
-#include <CL/cl.hpp>
-
-class Image
-{
-public:
-	enum class Format
-	{
-		ppm = 0
-	};
-
-	struct Props
-	{
-		cl_uint Width;
-		cl_uint Height;
-		cl_float AspectRatio;
-		cl_uint TileWidth;
-		cl_uint TileHeight;
-		cl_uint nRows;
-		cl_uint nColumns;
-		Format Format;
-	};
-
-	struct Tile
-	{
-		Tile(cl_uint width, cl_uint height) : Width(width), Height(height)
-		{
-			// Create empty tile of pixels
-			Pixels.resize(Height * Width);
-		}
-		cl_uint Width;
-		cl_uint Height;
-		std::vector<cl_float3> Pixels;
-	};
-
-	Image(cl_uint width, cl_uint height, cl_uint tileWidth, cl_uint tileHeight,
-		Format format);
-
-	bool WriteToFile(const std::string &filepath) const;
-
-	void CalcTileRowsAndColumns(cl_uint &nRows, cl_uint &nColumns) const;
-	void SetTileRowsAndColumns(cl_uint nRows, cl_uint nColumns);
-
-	Props GetProps() const;
-
-	std::vector<std::vector<cl_float3>> m_Pixels;
-
-private:
-	inline cl_float clamp(cl_float x) const
-	{
-		return x < 0.0f ? 0.0f : x > 1.0f ? 1.0f : x;
-	}
-
-	Props m_Props;
-};
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <CL/cl.hpp>
+
+class Image
+{
+public:
+	// Binary 8-bit PPM (P6), little endian float PFM or PNG
+	enum class Format
+	{
+		ppm = 0,
+		pfm = 1,
+		png = 2
+	};
+
+	struct Props
+	{
+		cl_uint Width;
+		cl_uint Height;
+		cl_float AspectRatio;
+		cl_uint TileWidth;
+		cl_uint TileHeight;
+		cl_uint nRows;
+		cl_uint nColumns;
+		Format Format;
+	};
+
+	// Rectangle of pixels
+	struct Region
+	{
+		cl_uint x;
+		cl_uint y;
+		cl_uint Width;
+		cl_uint Height;
+	};
+
+	// Images of streamed renders aren't held in memory, leaving m_Pixels empty
+	Image(cl_uint width, cl_uint height, cl_uint tileWidth, cl_uint tileHeight,
+		Format format, bool inMemory = true);
+
+	// Writes the output region, whose offset in the full image is recorded in
+	// a comment of PPM headers and the oFFs chunk of PNGs
+	bool WriteToFile(const std::string &filepath) const;
+	const char *GetFileExtension() const;
+
+	// Root mean square error of pixel values against a reference image of the
+	// same size
+	cl_float CalcRMSE(const std::vector<cl_float3> &reference) const;
+
+	// Size of the tile at an offset, clipped to the image bounds
+	void CalcTileRegion(cl_uint xOffset, cl_uint yOffset, cl_uint &width,
+		cl_uint &height) const;
+
+	void CalcTileRowsAndColumns(cl_uint &nRows, cl_uint &nColumns) const;
+	void SetTileRowsAndColumns(cl_uint nRows, cl_uint nColumns);
+	void SetTileSize(cl_uint tileWidth, cl_uint tileHeight);
+
+	Props GetProps() const;
+
+	// Restrict output to a crop of the image, the whole image by default
+	void SetOutputRegion(const Region &region);
+	Region GetOutputRegion() const;
+	bool IsCropped() const;
+
+	// Framebuffer of Height rows of Width pixels, contiguous so tiles can be
+	// read from the device straight into place
+	std::vector<cl_float3> m_Pixels;
+
+	// 8-bit RGBA pixels tonemapped on the device, written instead of m_Pixels
+	// if present
+	std::vector<cl_uchar4> m_LDRPixels;
+
+private:
+	// 3 bytes per pixel in row order
+	void GetRGB8(std::vector<cl_uchar> &rgb) const;
+
+	void EncodePPM(std::vector<cl_uchar> &file) const;
+	bool EncodePFM(std::vector<cl_uchar> &file) const;
+	void EncodePNG(std::vector<cl_uchar> &file) const;
+
+	inline cl_float clamp(cl_float x) const
+	{
+		return x < 0.0f ? 0.0f : x > 1.0f ? 1.0f : x;
+	}
+
+	Props m_Props;
+	Region m_OutputRegion;
+};
@@ -0,0 +1,314 @@
+#include "JobQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+const char MAGIC[8] = {'L', 'A', 'S', 'E', 'R', 'J', 'Q', '2'};
+
+// Task index of a file name, which may be followed by a worker ID
+bool parseTask(const fs::path &path, cl_uint &task)
+{
+	std::string name = path.filename().string();
+	size_t end = name.find('.');
+	if (end == 0 || name.find_first_not_of("0123456789") < end)
+		return false;
+	task = (cl_uint)std::stoul(name.substr(0, end));
+	return true;
+}
+
+// Header of a result file
+struct Result
+{
+	cl_ulong FrameID;
+	cl_uint nPixels;
+};
+
+// Write to a temporary file first, so readers never see part of a file
+bool writeFile(const fs::path &path, const fs::path &temporary,
+	const void *header, size_t headerSize, const void *data, size_t size)
+{
+	std::ofstream file(temporary, std::ios::binary);
+	file.write(MAGIC, sizeof(MAGIC));
+	file.write((const char *)header, headerSize);
+	file.write((const char *)data, size);
+	file.close();
+
+	std::error_code error;
+	if (file.fail() || (fs::rename(temporary, path, error), error))
+	{
+		std::cout << "Failed to write file " << path.string() << "."
+				  << std::endl;
+		return false;
+	}
+	return true;
+}
+} // namespace
+
+JobQueue::JobQueue(const std::string &directory) : m_Directory(directory)
+{
+	// Unique between processes on every host sharing the directory
+	std::random_device device;
+	std::ostringstream id;
+	id << std::hex << device() << device();
+	m_WorkerID = id.str();
+}
+
+bool JobQueue::Create(Frame &frame)
+{
+	std::random_device device;
+	frame.ID = ((cl_ulong)device() << 32) | device();
+
+	// Remove the last frame's files, starting with the marker that would stop
+	// workers
+	std::error_code error;
+	fs::remove(m_Directory / "done", error);
+	fs::remove(m_Directory / "frame", error);
+	for (const char *subdirectory : {"tasks", "claimed", "results"})
+	{
+		fs::remove_all(m_Directory / subdirectory, error);
+		fs::create_directories(m_Directory / subdirectory, error);
+		if (error)
+		{
+			std::cout << "Failed to create directory "
+					  << (m_Directory / subdirectory).string() << "."
+					  << std::endl;
+			return false;
+		}
+	}
+
+	for (cl_uint task = 0; task < frame.nTasks; task++)
+	{
+		fs::path path = m_Directory / "tasks" / std::to_string(task);
+		if (!std::ofstream(path))
+		{
+			std::cout << "Failed to write file " << path.string() << "."
+					  << std::endl;
+			return false;
+		}
+	}
+
+	// Workers wait for the frame, so it comes last
+	if (!writeFile(m_Directory / "frame", m_Directory / "frame.tmp", &frame,
+			sizeof(frame), nullptr, 0))
+		return false;
+
+	std::cout << "Queued " << frame.nTasks << " tasks in "
+			  << m_Directory.string() << "." << std::endl;
+	return true;
+}
+
+bool JobQueue::ListResults(std::vector<cl_uint> &tasks) const
+{
+	tasks.clear();
+	std::error_code error;
+	for (const fs::directory_entry &entry :
+		fs::directory_iterator(m_Directory / "results", error))
+	{
+		cl_uint task = 0;
+		if (entry.path().extension().empty() && parseTask(entry.path(), task))
+			tasks.push_back(task);
+	}
+	if (error)
+	{
+		std::cout << "Failed to list results in " << m_Directory.string()
+				  << "." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool JobQueue::ReadResult(cl_uint task, cl_ulong frameID,
+	std::vector<cl_float3> &pixels, bool &current) const
+{
+	fs::path path = m_Directory / "results" / std::to_string(task);
+	std::ifstream file(path, std::ios::binary);
+	char magic[sizeof(MAGIC)];
+	Result result = {};
+	file.read(magic, sizeof(magic));
+	file.read((char *)&result, sizeof(result));
+	current = false;
+	if (file && std::equal(magic, magic + sizeof(MAGIC), MAGIC))
+	{
+		current = result.FrameID == frameID;
+		if (!current)
+			return true;
+		pixels.resize(result.nPixels);
+		file.read((char *)pixels.data(), result.nPixels * sizeof(cl_float3));
+	}
+	if (!file)
+	{
+		std::cout << "Invalid result " << path.string() << "." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool JobQueue::Requeue(cl_uint task)
+{
+	std::string name = std::to_string(task);
+	std::error_code error;
+	fs::remove(m_Directory / "results" / name, error);
+	fs::path path = m_Directory / "tasks" / name;
+	if (error || !std::ofstream(path))
+	{
+		std::cout << "Failed to requeue task " << task << " in "
+				  << m_Directory.string() << "." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool JobQueue::RequeueStalled(cl_float stallSeconds)
+{
+	fs::file_time_type now = fs::file_time_type::clock::now();
+	std::error_code error;
+	for (const fs::directory_entry &entry :
+		fs::directory_iterator(m_Directory / "claimed", error))
+	{
+		cl_uint task = 0;
+		if (!parseTask(entry.path(), task))
+			continue;
+
+		// A worker removes its claim after publishing, but may not get to
+		std::string name = std::to_string(task);
+		std::error_code fileError;
+		if (fs::exists(m_Directory / "results" / name, fileError))
+		{
+			fs::remove(entry.path(), fileError);
+			continue;
+		}
+
+		std::chrono::duration<float> age =
+			now - fs::last_write_time(entry.path(), fileError);
+		if (fileError || age.count() < stallSeconds)
+			continue;
+
+		// Fails harmlessly if the worker publishes meanwhile
+		fs::rename(entry.path(), m_Directory / "tasks" / name, fileError);
+		if (!fileError)
+			std::cout << "Requeued task " << task << " of stalled worker "
+					  << entry.path().extension().string().substr(1) << "."
+					  << std::endl;
+	}
+	if (error)
+	{
+		std::cout << "Failed to list claims in " << m_Directory.string()
+				  << "." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool JobQueue::Finish(cl_ulong frameID)
+{
+	return writeFile(m_Directory / "done", m_Directory / "done.tmp", &frameID,
+		sizeof(frameID), nullptr, 0);
+}
+
+bool JobQueue::LoadFrame(Frame &frame, bool &found) const
+{
+	found = false;
+	std::ifstream file(m_Directory / "frame", std::ios::binary);
+	if (!file.good())
+		return true;
+
+	char magic[sizeof(MAGIC)];
+	file.read(magic, sizeof(magic));
+	file.read((char *)&frame, sizeof(frame));
+	if (!file || !std::equal(magic, magic + sizeof(MAGIC), MAGIC))
+	{
+		std::cout << "Invalid frame in " << m_Directory.string() << "."
+				  << std::endl;
+		return false;
+	}
+	found = true;
+	return true;
+}
+
+bool JobQueue::Claim(cl_uint &task, bool &claimed)
+{
+	claimed = false;
+	std::error_code error;
+	for (const fs::directory_entry &entry :
+		fs::directory_iterator(m_Directory / "tasks", error))
+	{
+		if (!parseTask(entry.path(), task))
+			continue;
+
+		// A task requeued as stalled may have been published since
+		std::error_code fileError;
+		if (fs::exists(m_Directory / "results" / std::to_string(task),
+				fileError))
+		{
+			fs::remove(entry.path(), fileError);
+			continue;
+		}
+
+		// Another worker may rename it first, then try the next
+		fs::path claim = m_Directory / "claimed" /
+			(std::to_string(task) + "." + m_WorkerID);
+		fs::rename(entry.path(), claim, fileError);
+		if (fileError)
+			continue;
+
+		// Renaming keeps the time the task was queued, so restart the clock
+		// of stalled claims
+		fs::last_write_time(claim, fs::file_time_type::clock::now(),
+			fileError);
+		claimed = true;
+		return true;
+	}
+	if (error)
+	{
+		std::cout << "Failed to list tasks in " << m_Directory.string() << "."
+				  << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void JobQueue::Touch(cl_uint task)
+{
+	// Fails harmlessly if the claim was requeued meanwhile
+	std::error_code error;
+	fs::last_write_time(
+		m_Directory / "claimed" / (std::to_string(task) + "." + m_WorkerID),
+		fs::file_time_type::clock::now(), error);
+}
+
+bool JobQueue::Publish(cl_uint task, cl_ulong frameID,
+	const std::vector<cl_float3> &pixels)
+{
+	// Results of requeued tasks are published even if another worker renders
+	// the tiles again, as both are the same
+	std::string name = std::to_string(task);
+	Result result = {frameID, (cl_uint)pixels.size()};
+	if (!writeFile(m_Directory / "results" / name,
+			m_Directory / "results" / (name + "." + m_WorkerID), &result,
+			sizeof(result), pixels.data(), pixels.size() * sizeof(cl_float3)))
+		return false;
+
+	std::error_code error;
+	fs::remove(m_Directory / "claimed" / (name + "." + m_WorkerID), error);
+	return true;
+}
+
+bool JobQueue::IsFinished(cl_ulong frameID) const
+{
+	// The marker may be left by an earlier frame
+	std::ifstream file(m_Directory / "done", std::ios::binary);
+	char magic[sizeof(MAGIC)];
+	cl_ulong doneID = 0;
+	file.read(magic, sizeof(magic));
+	file.read((char *)&doneID, sizeof(doneID));
+	return file && std::equal(magic, magic + sizeof(MAGIC), MAGIC) &&
+		doneID == frameID;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <CL/cl.hpp>
+
+#include "Checkpoint.h"
+
+// Splits a frame between Laser processes through a directory they share, which
+// may be on a network share. The coordinator queues a file per task in tasks/,
+// a worker claims a task by renaming its file into claimed/, which only one
+// rename can do, and publishes the task's pixels in results/ the same way.
+// Claims whose worker stops touching them are moved back into tasks/ for
+// another worker, and duplicate results of the same tiles are identical.
+// Every frame has a random ID, written into its done marker and results, so
+// files of an earlier frame are never taken for the current one's.
+class JobQueue
+{
+public:
+	// Written by the coordinator once the tasks are queued. Task n covers
+	// TilesPerTask tiles from tile n * TilesPerTask in the coordinator's grid.
+	struct Frame
+	{
+		cl_ulong ID;			   // Set by Create
+		Checkpoint::Header Render; // Scene and settings
+		cl_uint TileWidth;
+		cl_uint TileHeight;
+		cl_uint TilesPerTask;
+		cl_uint nTasks;
+	};
+
+	explicit JobQueue(const std::string &directory);
+
+	// Replace any previous frame in the directory with a new one, giving it
+	// a new ID
+	bool Create(Frame &frame);
+
+	// Tasks with a result, in no particular order. current is false for a
+	// result published for another frame.
+	bool ListResults(std::vector<cl_uint> &tasks) const;
+	bool ReadResult(cl_uint task, cl_ulong frameID,
+		std::vector<cl_float3> &pixels, bool &current) const;
+
+	// Discard a task's result and queue the task again
+	bool Requeue(cl_uint task);
+
+	// Move claims not touched for stallSeconds without a result back into
+	// tasks/
+	bool RequeueStalled(cl_float stallSeconds);
+
+	// Tell workers the frame is complete
+	bool Finish(cl_ulong frameID);
+
+	// found is false until the coordinator has created a frame
+	bool LoadFrame(Frame &frame, bool &found) const;
+
+	// claimed is false if no task without a result is waiting
+	bool Claim(cl_uint &task, bool &claimed);
+
+	// Restart the stall clock of a task this worker still claims
+	void Touch(cl_uint task);
+
+	bool Publish(cl_uint task, cl_ulong frameID,
+		const std::vector<cl_float3> &pixels);
+	bool IsFinished(cl_ulong frameID) const;
+
+private:
+	std::filesystem::path m_Directory;
+	std::string m_WorkerID;
+};
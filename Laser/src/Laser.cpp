@@ -1,18 +1,52 @@
-#include "Application.h"
-
-#define VERIFY(x) \
-	if (!x)       \
-	return -1
-
-int main()
-{
-	Application application;
-
-	VERIFY(application.Init());
-	VERIFY(application.GenBuffers());
-	VERIFY(application.SetKernelArgs());
-	VERIFY(application.Render());
-	VERIFY(application.WriteOutput());
-
-	return 0;
-}
+#include "Application.h"
+
+#include <iostream>
+#include <string>
+
+// Wrapped in a statement so an else after it can't bind to its if
+#define VERIFY(x)      \
+	do                 \
+	{                  \
+		if (!(x))      \
+			return -1; \
+	} while (0)
+
+int main(int argc, char **argv)
+{
+	Application application;
+
+	// Backend can be chosen at runtime, by default OpenCL is used if a GPU is
+	// available and the CPU backend otherwise. A spool directory runs a server
+	// rendering the jobs written there instead of a single image.
+	std::string spoolDirectory;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--cpu")
+			application.SetBackend(Application::Backend::CPU);
+		else if (arg == "--opencl")
+			application.SetBackend(Application::Backend::OpenCL);
+		else if (arg == "--serve" && i + 1 < argc)
+			spoolDirectory = argv[++i];
+		else
+		{
+			std::cout << "Usage: Laser [--cpu | --opencl] [--serve <spool "
+						 "directory>]"
+					  << std::endl;
+			return -1;
+		}
+	}
+
+	VERIFY(application.Init());
+	VERIFY(application.GenBuffers());
+	VERIFY(application.SetKernelArgs());
+	if (!spoolDirectory.empty())
+	{
+		VERIFY(application.Serve(spoolDirectory));
+		return 0;
+	}
+	VERIFY(application.Render());
+	VERIFY(application.WriteOutput());
+
+	return 0;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <CL/cl.hpp>
+
+struct Light
+{
+	cl_uint TriangleIndex; // Index into BVH-ordered triangles
+	cl_float Area;		   // World space area
+	cl_float CDF;		   // Cumulative selection probability
+	cl_uint BitTrail;	   // Path from light BVH root to leaf (0 = left)
+};
+
+struct LightAliasEntry
+{
+	cl_float Probability; // Probability of keeping this entry
+	cl_uint Alias;		  // Light chosen otherwise
+	cl_float Pmf;		  // Power-proportional selection probability
+	cl_float dummy;
+};
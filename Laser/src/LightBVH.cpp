@@ -0,0 +1,163 @@
+#include "LightBVH.h"
+
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Util.h"
+
+/********** LIGHT BOUNDS **********/
+
+LightBVH::LightBounds::LightBounds()
+	: Axis(0.0f, 0.0f, 1.0f), ThetaO(0.0f), ThetaE(0.0f), Power(0.0f),
+	  IsEmpty(true)
+{
+}
+
+void LightBVH::LightBounds::Join(const LightBounds &b)
+{
+	if (b.IsEmpty)
+		return;
+	if (IsEmpty)
+	{
+		*this = b;
+		return;
+	}
+
+	Bounds.Join(b.Bounds);
+	Power += b.Power;
+	ThetaE = std::max(ThetaE, b.ThetaE);
+
+	// Lights are two-sided, so cones bound normal lines rather than normals
+	// and the other axis can be flipped to whichever side is closer
+	glm::vec3 bAxis = glm::dot(Axis, b.Axis) < 0.0f ? -b.Axis : b.Axis;
+	float thetaD = acos(std::clamp(glm::dot(Axis, bAxis), -1.0f, 1.0f));
+
+	// If one cone already contains the other
+	if (std::min(thetaD + b.ThetaO, PI) <= ThetaO)
+		return;
+	if (std::min(thetaD + ThetaO, PI) <= b.ThetaO)
+	{
+		Axis = bAxis;
+		ThetaO = b.ThetaO;
+		return;
+	}
+
+	// Otherwise find the smallest cone containing both
+	float thetaO = (ThetaO + thetaD + b.ThetaO) * 0.5f;
+	glm::vec3 rotationAxis = glm::cross(Axis, bAxis);
+	if (thetaO >= PI || glm::dot(rotationAxis, rotationAxis) == 0.0f)
+	{
+		ThetaO = PI;
+		return;
+	}
+
+	// Rotate axis towards the other axis to the center of the new cone
+	glm::mat4 rotation =
+		glm::rotate(glm::mat4(1.0f), thetaO - ThetaO, rotationAxis);
+	Axis = glm::normalize(glm::vec3(rotation * glm::vec4(Axis, 0.0f)));
+	ThetaO = thetaO;
+}
+
+/********** LIGHT BVH **********/
+
+LightBVH::LightBVH() {}
+
+LightBVH::LightBVH(const BVH &bvh, const std::vector<Material> &materials,
+	LightList &lightList)
+{
+	// Ensure at least one light in the scene
+	if (lightList.m_Lights.empty())
+		return;
+
+	// Calculate bounds, orientation and power of each light
+	std::vector<LightBVHItem> items;
+	items.reserve(lightList.m_Lights.size());
+	for (cl_uint i = 0; i < lightList.m_Lights.size(); i++)
+	{
+		glm::vec3 v0, v1, v2;
+		bvh.CalcWorldVertices(lightList.m_Lights[i].TriangleIndex, v0, v1, v2);
+
+		LightBVHItem item;
+		item.LightIndex = i;
+		item.LightBounds.Bounds = ::Bounds({v0.x, v0.y, v0.z},
+			{v1.x, v1.y, v1.z}, {v2.x, v2.y, v2.z});
+		item.LightBounds.Axis = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+		item.LightBounds.ThetaO = 0.0f;
+		item.LightBounds.ThetaE = PI / 2.0f; // Diffuse emission
+		item.LightBounds.Power = lightList.CalcPower(i, bvh, materials);
+		item.LightBounds.IsEmpty = false;
+
+		glm::vec3 centroid = (v0 + v1 + v2) / 3.0f;
+		item.Centroid = {centroid.x, centroid.y, centroid.z};
+
+		items.push_back(item);
+	}
+
+	// Build depth-first so the first child is always the next node, with the
+	// bit trail recording the path to each light for evaluating its pmf
+	m_Nodes.reserve(2 * items.size() - 1);
+	Build(items, 0, items.size(), 0, 0, lightList);
+}
+
+cl_uint LightBVH::Build(std::vector<LightBVHItem> &items, cl_uint start,
+	cl_uint end, cl_uint bitTrail, cl_uint depth, LightList &lightList)
+{
+	cl_uint nodeIndex = m_Nodes.size();
+	m_Nodes.emplace_back();
+
+	// If 1 light in node, create leaf
+	if (end - start == 1)
+	{
+		SetNode(nodeIndex, items[start].LightBounds);
+		m_Nodes[nodeIndex].IsLeaf = 1;
+		m_Nodes[nodeIndex].LightIndex = items[start].LightIndex;
+		lightList.m_Lights[items[start].LightIndex].BitTrail = bitTrail;
+		return nodeIndex;
+	}
+
+	// Choose split dimension
+	Bounds centroidBounds;
+	for (cl_uint i = start; i < end; i++)
+		centroidBounds.Extend(items[i].Centroid);
+	cl_uint dimension = centroidBounds.GetLargestDimension();
+
+	// Partition lights into equal subsets so the tree depth (and the bit
+	// trail length) is at most log2 of the number of lights
+	cl_uint mid = (start + end) / 2;
+	std::nth_element(items.begin() + start, items.begin() + mid,
+		items.begin() + end,
+		[dimension](const LightBVHItem &a, const LightBVHItem &b)
+		{
+			cl_float aCentroidDim = dimension == 0 ? a.Centroid.x
+				: dimension == 1				   ? a.Centroid.y
+												   : a.Centroid.z;
+			cl_float bCentroidDim = dimension == 0 ? b.Centroid.x
+				: dimension == 1				   ? b.Centroid.y
+												   : b.Centroid.z;
+			return aCentroidDim < bCentroidDim;
+		});
+
+	// Create children, second child path is marked with a set bit
+	Build(items, start, mid, bitTrail, depth + 1, lightList);
+	cl_uint secondChild =
+		Build(items, mid, end, bitTrail | (1u << depth), depth + 1, lightList);
+
+	LightBounds nodeBounds;
+	for (cl_uint i = start; i < end; i++)
+		nodeBounds.Join(items[i].LightBounds);
+
+	SetNode(nodeIndex, nodeBounds);
+	m_Nodes[nodeIndex].IsLeaf = 0;
+	m_Nodes[nodeIndex].SecondChildOffset = secondChild;
+	return nodeIndex;
+}
+
+void LightBVH::SetNode(cl_uint node, const LightBounds &bounds)
+{
+	m_Nodes[node].Bounds = bounds.Bounds;
+	m_Nodes[node].Axis = {bounds.Axis.x, bounds.Axis.y, bounds.Axis.z};
+	m_Nodes[node].CosThetaO = cos(bounds.ThetaO);
+	m_Nodes[node].CosThetaE = cos(bounds.ThetaE);
+	m_Nodes[node].Power = bounds.Power;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include <CL/cl.hpp>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "BVH.h"
+#include "LightList.h"
+#include "Material.h"
+
+class LightBVH
+{
+public:
+	/********** LIGHT BOUNDS **********/
+	struct LightBounds
+	{
+	public:
+		LightBounds();
+
+		// Merge bounds, power and orientation cone of another light or node
+		void Join(const LightBounds &b);
+
+	public:
+		Bounds Bounds;
+		glm::vec3 Axis;	  // Axis of cone of normal lines (two-sided)
+		float ThetaO;	  // Angle of cone of normals around axis
+		float ThetaE;	  // Angle of emission around each normal
+		float Power;
+		bool IsEmpty;
+	};
+
+	/********** LIGHT BVH BUILD ITEM **********/
+	struct LightBVHItem
+	{
+		cl_uint LightIndex;
+		LightBounds LightBounds;
+		cl_float3 Centroid;
+	};
+
+	/********** LIGHT BVH LINEAR NODE **********/
+	struct LightBVHNode
+	{
+		Bounds Bounds;
+		cl_float3 Axis;
+		cl_float CosThetaO;
+		cl_float CosThetaE;
+		cl_float Power;
+		cl_uint SecondChildOffset; // First child is next node in array
+		cl_uint LightIndex;
+		cl_uint IsLeaf;
+		cl_uint dummy[2];
+	};
+
+	/********** LIGHT BVH **********/
+public:
+	LightBVH();
+	LightBVH(const BVH &bvh, const std::vector<Material> &materials,
+		LightList &lightList);
+
+private:
+	cl_uint Build(std::vector<LightBVHItem> &items, cl_uint start,
+		cl_uint end, cl_uint bitTrail, cl_uint depth, LightList &lightList);
+
+	void SetNode(cl_uint node, const LightBounds &bounds);
+
+public:
+	std::vector<LightBVHNode> m_Nodes;
+};
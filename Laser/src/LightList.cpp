@@ -0,0 +1,123 @@
+#include "LightList.h"
+
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+LightList::LightList() : m_TotalArea(0.0f) {}
+
+LightList::LightList(const BVH &bvh, const std::vector<Material> &materials)
+	: m_TotalArea(0.0f)
+{
+	m_TriangleLights.resize(bvh.m_Triangles.size(), NO_LIGHT);
+
+	// Collect emissive triangles (indices refer to BVH-ordered triangles so
+	// they can be used directly on the device)
+	for (cl_uint i = 0; i < bvh.m_Triangles.size(); i++)
+	{
+		const Material &material = materials[bvh.m_Triangles[i].Material];
+		if (material.Emission.x <= 0.0f && material.Emission.y <= 0.0f &&
+			material.Emission.z <= 0.0f)
+			continue;
+
+		cl_float area = CalcTriangleArea(bvh, i);
+		if (area <= 0.0f)
+			continue;
+
+		m_TriangleLights[i] = m_Lights.size();
+		m_Lights.push_back({i, area, 0.0f, 0});
+		m_TotalArea += area;
+	}
+
+	// Build CDF for area-weighted light selection
+	cl_float cumulativeArea = 0.0f;
+	for (Light &light : m_Lights)
+	{
+		cumulativeArea += light.Area;
+		light.CDF = cumulativeArea / m_TotalArea;
+	}
+
+	// Guard against floating point error in binary search on the device
+	if (!m_Lights.empty())
+		m_Lights.back().CDF = 1.0f;
+
+	BuildAliasTable(bvh, materials);
+}
+
+cl_float LightList::CalcPower(cl_uint light, const BVH &bvh,
+	const std::vector<Material> &materials) const
+{
+	cl_uint triangle = m_Lights[light].TriangleIndex;
+	cl_float3 emission = materials[bvh.m_Triangles[triangle].Material].Emission;
+
+	// Luminance of emitted radiance over the area of the light
+	cl_float luminance = 0.2126f * emission.x + 0.7152f * emission.y +
+		0.0722f * emission.z;
+	return luminance * m_Lights[light].Area;
+}
+
+cl_float LightList::CalcTriangleArea(const BVH &bvh, cl_uint tri) const
+{
+	// Area must be computed in world space to match sampled points
+	glm::vec3 v0, v1, v2;
+	bvh.CalcWorldVertices(tri, v0, v1, v2);
+
+	return 0.5f * glm::length(glm::cross(v1 - v0, v2 - v0));
+}
+
+void LightList::BuildAliasTable(const BVH &bvh,
+	const std::vector<Material> &materials)
+{
+	size_t n = m_Lights.size();
+	m_AliasTable.resize(n);
+	if (n == 0)
+		return;
+
+	// Normalized power of each light, falling back to uniform selection if
+	// no light has positive power
+	std::vector<cl_float> pmf(n);
+	cl_float totalPower = 0.0f;
+	for (cl_uint i = 0; i < n; i++)
+	{
+		pmf[i] = std::max(CalcPower(i, bvh, materials), 0.0f);
+		totalPower += pmf[i];
+	}
+	for (cl_uint i = 0; i < n; i++)
+		pmf[i] = totalPower > 0.0f ? pmf[i] / totalPower : 1.0f / n;
+
+	// Vose's alias method: split lights into those with less and more than
+	// the average probability, then pair each small entry with a large one
+	std::vector<cl_float> scaled(n);
+	std::vector<cl_uint> small;
+	std::vector<cl_uint> large;
+	for (cl_uint i = 0; i < n; i++)
+	{
+		scaled[i] = pmf[i] * n;
+		if (scaled[i] < 1.0f)
+			small.push_back(i);
+		else
+			large.push_back(i);
+	}
+
+	while (!small.empty() && !large.empty())
+	{
+		cl_uint s = small.back();
+		small.pop_back();
+		cl_uint l = large.back();
+		large.pop_back();
+
+		m_AliasTable[s] = {scaled[s], l, pmf[s], 0.0f};
+
+		scaled[l] = (scaled[l] + scaled[s]) - 1.0f;
+		if (scaled[l] < 1.0f)
+			small.push_back(l);
+		else
+			large.push_back(l);
+	}
+
+	// Remaining entries are (up to floating point error) exactly average
+	for (cl_uint i : large)
+		m_AliasTable[i] = {1.0f, i, pmf[i], 0.0f};
+	for (cl_uint i : small)
+		m_AliasTable[i] = {1.0f, i, pmf[i], 0.0f};
+}
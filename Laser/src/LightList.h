@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+#include <CL/cl.hpp>
+
+#include "Light.h"
+#include "Material.h"
+#include "BVH.h"
+
+class LightList
+{
+public:
+	LightList();
+	LightList(const BVH &bvh, const std::vector<Material> &materials);
+
+	// Emitted power of a light (relative, used for light selection)
+	cl_float CalcPower(cl_uint light, const BVH &bvh,
+		const std::vector<Material> &materials) const;
+
+private:
+	cl_float CalcTriangleArea(const BVH &bvh, cl_uint triangle) const;
+	void BuildAliasTable(const BVH &bvh,
+		const std::vector<Material> &materials);
+
+public:
+	std::vector<Light> m_Lights;
+	cl_float m_TotalArea;
+
+	// Power-proportional selection in constant time
+	std::vector<LightAliasEntry> m_AliasTable;
+
+	// Light index of each BVH-ordered triangle, NO_LIGHT if not emissive
+	std::vector<cl_uint> m_TriangleLights;
+	static const cl_uint NO_LIGHT = 0xFFFFFFFF;
+};
@@ -1,240 +1,583 @@
-#include "OpenCLContext.h"
-
-#include <iostream>
-#include <fstream>
-#include <vector>
-
-bool OpenCLContext::Init()
-{
-	// Platform
-	std::vector<cl::Platform> platforms;
-	cl::Platform::get(&platforms);
-
-	if (platforms.empty())
-	{
-		std::cout << "No OpenCL platform available." << std::endl;
-		return false;
-	}
-
-	m_Platform = platforms[0];
-
-	// Device
-	std::vector<cl::Device> devices;
-	m_Platform.getDevices(CL_DEVICE_TYPE_GPU, &devices);
-
-	if (devices.empty())
-	{
-		std::cout << "No OpenCL GPU device available." << std::endl;
-		return false;
-	}
-
-	m_Device = devices[0];
-
-	// Context
-	m_Context = cl::Context(m_Device);
-
-	// Command queue
-	m_CommandQueue = cl::CommandQueue(m_Context, m_Device);
-
-	PrintContextInfo();
-	return true;
-}
-
-bool OpenCLContext::LoadKernel(const std::string &filepath,
-	const std::string &kernelName)
-{
-	// Read kernel source
-	std::string kernelSrc;
-	std::string line;
-	std::ifstream kernelFile(filepath);
-
-	if (!kernelFile.good())
-	{
-		std::cout << "Failed to open file at " << filepath << std::endl;
-		return false;
-	}
-
-	while (std::getline(kernelFile, line))
-	{
-		kernelSrc += line + '\n';
-	}
-
-	kernelFile.close();
-
-	// Build program
-	m_Program = cl::Program(m_Context, kernelSrc.c_str());
-
-	cl_int buildError = m_Program.build({m_Device}, "-I cl");
-	if (buildError)
-	{
-		std::cout << std::endl
-				  << "OpenCL program compilation error: " << buildError
-				  << std::endl;
-		std::string buildLog =
-			m_Program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(m_Device);
-		std::cout << "Build log:" << std::endl << buildLog << std::endl;
-		return false;
-	}
-
-	// Kernel object
-	m_Kernel = cl::Kernel(m_Program, kernelName.c_str());
-	return true;
-}
-
-bool OpenCLContext::AddBuffer(const std::string &bufferKey,
-	cl_mem_flags clMemFlag, size_t size)
-{
-	if (m_Buffers.find(bufferKey) != m_Buffers.end())
-	{
-		std::cout << "Buffer with name " << bufferKey << " already exists."
-				  << std::endl;
-		return false;
-	}
-
-	if (size < 0)
-		return false;
-
-	m_Buffers[bufferKey] = cl::Buffer(m_Context, clMemFlag, size);
-	return true;
-}
-
-bool OpenCLContext::SetKernelArg(cl_uint index, const std::string &bufferKey)
-{
-	if (m_Buffers.find(bufferKey) == m_Buffers.end())
-	{
-		std::cout << "No buffer with name \"" << bufferKey << "\" found."
-				  << std::endl;
-		return false;
-	}
-
-	cl_int kernelError = m_Kernel.setArg(index, m_Buffers[bufferKey]);
-	if (kernelError)
-	{
-		std::cout << "OpenCL kernel error: " << kernelError << std::endl;
-		return false;
-	}
-	return true;
-}
-
-bool OpenCLContext::SetKernelArg(cl_uint index, cl_int value)
-{
-	cl_int kernelError = m_Kernel.setArg(index, value);
-	if (kernelError)
-	{
-		std::cout << "OpenCL kernel error: " << kernelError << std::endl;
-		return false;
-	}
-	return true;
-}
-
-bool OpenCLContext::SetKernelArg(cl_uint index, cl_uint value)
-{
-	cl_int kernelError = m_Kernel.setArg(index, value);
-	if (kernelError)
-	{
-		std::cout << "OpenCL kernel error: " << kernelError << std::endl;
-		return false;
-	}
-	return true;
-}
-
-bool OpenCLContext::SetKernelArg(cl_uint index, cl_float value)
-{
-	cl_int kernelError = m_Kernel.setArg(index, value);
-	if (kernelError)
-	{
-		std::cout << "OpenCL kernel error: " << kernelError << std::endl;
-		return false;
-	}
-	return true;
-}
-
-bool OpenCLContext::SetKernelArg(cl_uint index, const cl_float3 &value)
-{
-	cl_int kernelError = m_Kernel.setArg(index, value);
-	if (kernelError)
-	{
-		std::cout << "OpenCL kernel error: " << kernelError << std::endl;
-		return false;
-	}
-	return true;
-}
-
-bool OpenCLContext::QueueWrite(const std::string &bufferKey, cl_bool blocking,
-	size_t offset, size_t size, const void *data)
-{
-	cl::Buffer buffer;
-	if (!GetBuffer(bufferKey, buffer))
-	{
-		std::cout << "Could not write to non-existent buffer \"" << bufferKey
-				  << "\"." << std::endl;
-		return false;
-	}
-
-	cl_int queueError =
-		m_CommandQueue.enqueueWriteBuffer(buffer, blocking, offset, size, data);
-	if (queueError)
-	{
-		std::cout << "OpenCL command queue error: " << queueError << std::endl;
-		return false;
-	}
-	return true;
-}
-
-bool OpenCLContext::QueueRead(const std::string &bufferKey, cl_bool blocking,
-	size_t offset, size_t size, void *data)
-{
-	cl::Buffer buffer;
-	if (!GetBuffer(bufferKey, buffer))
-	{
-		std::cout << "Could not read from non-existent buffer \"" << bufferKey
-				  << "\"." << std::endl;
-		return false;
-	}
-
-	cl_int queueError =
-		m_CommandQueue.enqueueReadBuffer(buffer, blocking, offset, size, data);
-	if (queueError)
-	{
-		std::cout << "OpenCL command queue error: " << queueError << std::endl;
-		return false;
-	}
-	return true;
-}
-
-bool OpenCLContext::QueueKernel(const cl::NDRange &offset,
-	const cl::NDRange &global, const cl::NDRange &local)
-{
-	cl_int queueError =
-		m_CommandQueue.enqueueNDRangeKernel(m_Kernel, offset, global, local);
-	if (queueError)
-	{
-		std::cout << "OpenCL command queue error: " << queueError << std::endl;
-		return false;
-	}
-	return true;
-}
-
-void OpenCLContext::PrintContextInfo()
-{
-	std::cout << "OpenCL platform: " << m_Platform.getInfo<CL_PLATFORM_NAME>()
-			  << std::endl;
-	std::cout << "OpenCL device: " << m_Device.getInfo<CL_DEVICE_NAME>()
-			  << std::endl;
-	std::cout << "OpenCL version: " << m_Device.getInfo<CL_DEVICE_VERSION>()
-			  << std::endl
-			  << std::endl;
-}
-
-bool OpenCLContext::GetBuffer(const std::string &bufferKey, cl::Buffer &buffer)
-{
-	if (m_Buffers.find(bufferKey) != m_Buffers.end())
-	{
-		buffer = m_Buffers[bufferKey];
-		return true;
-	}
-
-	std::cout << "No buffer with name \"" << bufferKey << "\" found."
-			  << std::endl;
-	return false;
-}
+#include "OpenCLContext.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+bool OpenCLContext::Init()
+{
+	// Platform
+	std::vector<cl::Platform> platforms;
+	cl::Platform::get(&platforms);
+
+	if (platforms.empty())
+	{
+		std::cout << "No OpenCL platform available." << std::endl;
+		return false;
+	}
+
+	// Device
+	std::vector<cl::Device> devices;
+	platforms[0].getDevices(CL_DEVICE_TYPE_GPU, &devices);
+
+	if (devices.empty())
+	{
+		std::cout << "No OpenCL GPU device available." << std::endl;
+		return false;
+	}
+
+	return Init(devices[0]);
+}
+
+bool OpenCLContext::Init(const cl::Device &device)
+{
+	m_Device = device;
+	m_Platform = cl::Platform(m_Device.getInfo<CL_DEVICE_PLATFORM>());
+
+	// Context
+	m_Context = cl::Context(m_Device);
+
+	// Default in-order command queue
+	m_CommandQueues[DEFAULT_QUEUE] = cl::CommandQueue(m_Context, m_Device);
+
+	PrintContextInfo();
+	return true;
+}
+
+bool OpenCLContext::GetDevices(std::vector<cl::Device> &devices,
+	cl_uint cpuSubDevices)
+{
+	devices.clear();
+
+	std::vector<cl::Platform> platforms;
+	cl::Platform::get(&platforms);
+
+	for (const cl::Platform &platform : platforms)
+	{
+		std::vector<cl::Device> platformDevices;
+		platform.getDevices(CL_DEVICE_TYPE_ALL, &platformDevices);
+
+		for (cl::Device &device : platformDevices)
+		{
+			cl_uint computeUnits =
+				device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+			if (device.getInfo<CL_DEVICE_TYPE>() != CL_DEVICE_TYPE_CPU ||
+				cpuSubDevices < 2 || computeUnits < 2)
+			{
+				devices.push_back(device);
+				continue;
+			}
+
+			// Sub-devices share the CPU's memory, so only the parent device is
+			// used if partitioning isn't supported
+			cl_device_partition_property properties[] = {
+				CL_DEVICE_PARTITION_EQUALLY,
+				(cl_device_partition_property)std::max<cl_uint>(
+					computeUnits / cpuSubDevices, 1),
+				0};
+			std::vector<cl::Device> subDevices;
+			cl_int error = device.createSubDevices(properties, &subDevices);
+			if (error != CL_SUCCESS || subDevices.empty())
+			{
+				std::cout << "Failed to partition CPU device, using it whole."
+						  << std::endl;
+				devices.push_back(device);
+				continue;
+			}
+			devices.insert(devices.end(), subDevices.begin(),
+				subDevices.end());
+		}
+	}
+
+	if (devices.empty())
+	{
+		std::cout << "No OpenCL device available." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool OpenCLContext::LoadProgram(const std::string &programName,
+	const std::string &filepath, const std::string &options)
+{
+	if (m_Programs.find(programName) != m_Programs.end())
+	{
+		std::cout << "Program with name " << programName << " already exists."
+				  << std::endl;
+		return false;
+	}
+
+	// Read kernel source
+	std::string kernelSrc;
+	std::string line;
+	std::ifstream kernelFile(filepath);
+
+	if (!kernelFile.good())
+	{
+		std::cout << "Failed to open file at " << filepath << std::endl;
+		return false;
+	}
+
+	while (std::getline(kernelFile, line))
+	{
+		kernelSrc += line + '\n';
+	}
+
+	kernelFile.close();
+
+	// Build program
+	cl::Program program(m_Context, kernelSrc.c_str());
+
+	cl_int buildError = program.build({m_Device}, options.c_str());
+	if (buildError)
+	{
+		std::cout << std::endl
+				  << "OpenCL program compilation error: " << buildError
+				  << std::endl;
+		std::string buildLog =
+			program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(m_Device);
+		std::cout << "Build log:" << std::endl << buildLog << std::endl;
+		return false;
+	}
+
+	m_Programs[programName] = program;
+	return true;
+}
+
+bool OpenCLContext::CreateKernels(const std::string &programName,
+	const std::vector<std::string> &kernelNames)
+{
+	if (m_Programs.find(programName) == m_Programs.end())
+	{
+		std::cout << "No program with name \"" << programName << "\" found."
+				  << std::endl;
+		return false;
+	}
+
+	// Kernel objects, named uniquely across all programs
+	for (const std::string &kernelName : kernelNames)
+	{
+		if (m_Kernels.find(kernelName) != m_Kernels.end())
+		{
+			std::cout << "Kernel with name " << kernelName
+					  << " already exists." << std::endl;
+			return false;
+		}
+
+		cl_int kernelError;
+		m_Kernels[kernelName] = cl::Kernel(m_Programs[programName],
+			kernelName.c_str(), &kernelError);
+		if (kernelError)
+		{
+			std::cout << "Failed to create kernel \"" << kernelName
+					  << "\", OpenCL kernel error: " << kernelError
+					  << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool OpenCLContext::AddQueue(const std::string &queueName, bool outOfOrder)
+{
+	if (m_CommandQueues.find(queueName) != m_CommandQueues.end())
+	{
+		std::cout << "Queue with name " << queueName << " already exists."
+				  << std::endl;
+		return false;
+	}
+
+	cl_command_queue_properties properties = 0;
+	if (outOfOrder)
+	{
+		// Fall back to in-order execution if unsupported, which is always
+		// valid as it only adds ordering constraints
+		cl_command_queue_properties supported =
+			m_Device.getInfo<CL_DEVICE_QUEUE_PROPERTIES>();
+		if (supported & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)
+			properties = CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+		else
+			std::cout << "Out-of-order queues not supported, queue "
+					  << queueName << " is in-order." << std::endl;
+	}
+
+	cl_int queueError;
+	m_CommandQueues[queueName] =
+		cl::CommandQueue(m_Context, m_Device, properties, &queueError);
+	if (queueError)
+	{
+		std::cout << "OpenCL command queue error: " << queueError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::AddBuffer(const std::string &bufferKey,
+	cl_mem_flags clMemFlag, size_t size)
+{
+	if (m_Buffers.find(bufferKey) != m_Buffers.end())
+	{
+		std::cout << "Buffer with name " << bufferKey << " already exists."
+				  << std::endl;
+		return false;
+	}
+
+	if (size < 0)
+		return false;
+
+	m_Buffers[bufferKey] = cl::Buffer(m_Context, clMemFlag, size);
+	m_BufferVersions.erase(bufferKey);
+	return true;
+}
+
+cl_ulong OpenCLContext::GetBufferVersion(const std::string &bufferKey) const
+{
+	auto it = m_BufferVersions.find(bufferKey);
+	return it == m_BufferVersions.end() ? 0 : it->second;
+}
+
+void OpenCLContext::SetBufferVersion(const std::string &bufferKey,
+	cl_ulong version)
+{
+	m_BufferVersions[bufferKey] = version;
+}
+
+bool OpenCLContext::SetKernelArg(const std::string &kernelName, cl_uint index,
+	const std::string &bufferKey)
+{
+	cl::Kernel kernel;
+	if (!GetKernel(kernelName, kernel))
+		return false;
+
+	if (m_Buffers.find(bufferKey) == m_Buffers.end())
+	{
+		std::cout << "No buffer with name \"" << bufferKey << "\" found."
+				  << std::endl;
+		return false;
+	}
+
+	cl_int kernelError = kernel.setArg(index, m_Buffers[bufferKey]);
+	if (kernelError)
+	{
+		std::cout << "OpenCL kernel error: " << kernelError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::SetKernelArg(const std::string &kernelName, cl_uint index,
+	cl_int value)
+{
+	cl::Kernel kernel;
+	if (!GetKernel(kernelName, kernel))
+		return false;
+
+	cl_int kernelError = kernel.setArg(index, value);
+	if (kernelError)
+	{
+		std::cout << "OpenCL kernel error: " << kernelError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::SetKernelArg(const std::string &kernelName, cl_uint index,
+	cl_uint value)
+{
+	cl::Kernel kernel;
+	if (!GetKernel(kernelName, kernel))
+		return false;
+
+	cl_int kernelError = kernel.setArg(index, value);
+	if (kernelError)
+	{
+		std::cout << "OpenCL kernel error: " << kernelError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::SetKernelArg(const std::string &kernelName, cl_uint index,
+	cl_float value)
+{
+	cl::Kernel kernel;
+	if (!GetKernel(kernelName, kernel))
+		return false;
+
+	cl_int kernelError = kernel.setArg(index, value);
+	if (kernelError)
+	{
+		std::cout << "OpenCL kernel error: " << kernelError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::SetKernelArg(const std::string &kernelName, cl_uint index,
+	const cl_float3 &value)
+{
+	cl::Kernel kernel;
+	if (!GetKernel(kernelName, kernel))
+		return false;
+
+	cl_int kernelError = kernel.setArg(index, value);
+	if (kernelError)
+	{
+		std::cout << "OpenCL kernel error: " << kernelError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::SetLocalKernelArg(const std::string &kernelName,
+	cl_uint index, size_t size)
+{
+	cl::Kernel kernel;
+	if (!GetKernel(kernelName, kernel))
+		return false;
+
+	cl_int kernelError = kernel.setArg(index, cl::Local(size));
+	if (kernelError)
+	{
+		std::cout << "OpenCL kernel error: " << kernelError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::QueueWrite(const std::string &bufferKey, cl_bool blocking,
+	size_t offset, size_t size, const void *data,
+	const std::vector<cl::Event> *waitEvents, cl::Event *event,
+	const std::string &queueName)
+{
+	cl::Buffer buffer;
+	if (!GetBuffer(bufferKey, buffer))
+	{
+		std::cout << "Could not write to non-existent buffer \"" << bufferKey
+				  << "\"." << std::endl;
+		return false;
+	}
+
+	cl::CommandQueue queue;
+	if (!GetQueue(queueName, queue))
+		return false;
+
+	cl_int queueError = queue.enqueueWriteBuffer(buffer, blocking, offset,
+		size, data, waitEvents, event);
+	if (queueError)
+	{
+		std::cout << "OpenCL command queue error: " << queueError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::QueueRead(const std::string &bufferKey, cl_bool blocking,
+	size_t offset, size_t size, void *data,
+	const std::vector<cl::Event> *waitEvents, cl::Event *event,
+	const std::string &queueName)
+{
+	cl::Buffer buffer;
+	if (!GetBuffer(bufferKey, buffer))
+	{
+		std::cout << "Could not read from non-existent buffer \"" << bufferKey
+				  << "\"." << std::endl;
+		return false;
+	}
+
+	cl::CommandQueue queue;
+	if (!GetQueue(queueName, queue))
+		return false;
+
+	cl_int queueError = queue.enqueueReadBuffer(buffer, blocking, offset, size,
+		data, waitEvents, event);
+	if (queueError)
+	{
+		std::cout << "OpenCL command queue error: " << queueError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::QueueReadRect(const std::string &bufferKey,
+	cl_bool blocking, size_t rowSize, size_t nRows, size_t bufferRowPitch,
+	size_t hostRowPitch, void *data, const std::vector<cl::Event> *waitEvents,
+	cl::Event *event, const std::string &queueName)
+{
+	cl::Buffer buffer;
+	if (!GetBuffer(bufferKey, buffer))
+	{
+		std::cout << "Could not read from non-existent buffer \"" << bufferKey
+				  << "\"." << std::endl;
+		return false;
+	}
+
+	cl::CommandQueue queue;
+	if (!GetQueue(queueName, queue))
+		return false;
+
+	// Origins are zero as data already points at the first host row
+	cl::size_t<3> origin;
+	origin[0] = 0;
+	origin[1] = 0;
+	origin[2] = 0;
+	cl::size_t<3> region;
+	region[0] = rowSize;
+	region[1] = nRows;
+	region[2] = 1;
+
+	cl_int queueError = queue.enqueueReadBufferRect(buffer, blocking, origin,
+		origin, region, bufferRowPitch, 0, hostRowPitch, 0, data, waitEvents,
+		event);
+	if (queueError)
+	{
+		std::cout << "OpenCL command queue error: " << queueError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::QueueKernel(const std::string &kernelName,
+	const cl::NDRange &offset, const cl::NDRange &global,
+	const cl::NDRange &local, const std::vector<cl::Event> *waitEvents,
+	cl::Event *event, const std::string &queueName)
+{
+	cl::Kernel kernel;
+	if (!GetKernel(kernelName, kernel))
+		return false;
+
+	cl::CommandQueue queue;
+	if (!GetQueue(queueName, queue))
+		return false;
+
+	cl_int queueError = queue.enqueueNDRangeKernel(kernel, offset, global,
+		local, waitEvents, event);
+	if (queueError)
+	{
+		std::cout << "OpenCL command queue error: " << queueError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::Flush(const std::string &queueName)
+{
+	cl::CommandQueue queue;
+	if (!GetQueue(queueName, queue))
+		return false;
+
+	cl_int queueError = queue.flush();
+	if (queueError)
+	{
+		std::cout << "OpenCL command queue error: " << queueError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::Finish(const std::string &queueName)
+{
+	cl::CommandQueue queue;
+	if (!GetQueue(queueName, queue))
+		return false;
+
+	cl_int queueError = queue.finish();
+	if (queueError)
+	{
+		std::cout << "OpenCL command queue error: " << queueError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenCLContext::WaitForEvents(const std::vector<cl::Event> &events)
+{
+	if (events.empty())
+		return true;
+
+	cl_int eventError = cl::Event::waitForEvents(events);
+	if (eventError)
+	{
+		std::cout << "OpenCL event error: " << eventError << std::endl;
+		return false;
+	}
+	return true;
+}
+
+cl_uint OpenCLContext::GetComputeUnits() const
+{
+	return m_Device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+}
+
+std::string OpenCLContext::GetDeviceName() const
+{
+	return m_Device.getInfo<CL_DEVICE_NAME>();
+}
+
+bool OpenCLContext::GetKernelWorkGroupInfo(const std::string &kernelName,
+	size_t &maxWorkGroupSize, size_t &preferredMultiple)
+{
+	cl::Kernel kernel;
+	if (!GetKernel(kernelName, kernel))
+		return false;
+
+	maxWorkGroupSize =
+		kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(m_Device);
+	preferredMultiple = kernel.getWorkGroupInfo<
+		CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(m_Device);
+
+	return true;
+}
+
+void OpenCLContext::PrintContextInfo()
+{
+	std::cout << "OpenCL platform: " << m_Platform.getInfo<CL_PLATFORM_NAME>()
+			  << std::endl;
+	std::cout << "OpenCL device: " << m_Device.getInfo<CL_DEVICE_NAME>()
+			  << std::endl;
+	std::cout << "OpenCL version: " << m_Device.getInfo<CL_DEVICE_VERSION>()
+			  << std::endl
+			  << std::endl;
+}
+
+bool OpenCLContext::GetBuffer(const std::string &bufferKey, cl::Buffer &buffer)
+{
+	if (m_Buffers.find(bufferKey) != m_Buffers.end())
+	{
+		buffer = m_Buffers[bufferKey];
+		return true;
+	}
+
+	std::cout << "No buffer with name \"" << bufferKey << "\" found."
+			  << std::endl;
+	return false;
+}
+
+bool OpenCLContext::GetKernel(const std::string &kernelName, cl::Kernel &kernel)
+{
+	if (m_Kernels.find(kernelName) != m_Kernels.end())
+	{
+		kernel = m_Kernels[kernelName];
+		return true;
+	}
+
+	std::cout << "No kernel with name \"" << kernelName << "\" found."
+			  << std::endl;
+	return false;
+}
+
+bool OpenCLContext::GetQueue(const std::string &queueName,
+	cl::CommandQueue &queue)
+{
+	if (m_CommandQueues.find(queueName) != m_CommandQueues.end())
+	{
+		queue = m_CommandQueues[queueName];
+		return true;
+	}
+
+	std::cout << "No queue with name \"" << queueName << "\" found."
+			  << std::endl;
+	return false;
+}
@@ -1,40 +1,107 @@
-#pragma once
-
-#include <CL/cl.hpp>
-
-#include <unordered_map>
-
-class OpenCLContext
-{
-public:
-	bool Init();
-	bool LoadKernel(const std::string &filepath, const std::string &kernelName);
-
-	bool AddBuffer(const std::string &bufferKey, cl_mem_flags clMemFlag,
-		size_t size);
-
-	bool SetKernelArg(cl_uint index, const std::string &bufferKey);
-	bool SetKernelArg(cl_uint index, cl_int value);
-	bool SetKernelArg(cl_uint index, cl_uint value);
-	bool SetKernelArg(cl_uint index, cl_float value);
-	bool SetKernelArg(cl_uint index, const cl_float3 &value);
-
-	bool QueueWrite(const std::string &bufferKey, cl_bool blocking,
-		size_t offset, size_t size, const void *data);
-	bool QueueRead(const std::string &bufferKey, cl_bool blocking,
-		size_t offset, size_t size, void *data);
-	bool QueueKernel(const cl::NDRange &offset, const cl::NDRange &global,
-		const cl::NDRange &local = cl::NullRange);
-
-private:
-	void PrintContextInfo();
-	bool GetBuffer(const std::string &bufferKey, cl::Buffer &buffer);
-
-	cl::Platform m_Platform;
-	cl::Device m_Device;
-	cl::Context m_Context;
-	cl::Program m_Program;
-	cl::Kernel m_Kernel;
-	cl::CommandQueue m_CommandQueue;
-	std::unordered_map<std::string, cl::Buffer> m_Buffers;
-};
+#pragma once
+
+#include <CL/cl.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+class OpenCLContext
+{
+public:
+	// Queue created by Init, used when no queue is named
+	static constexpr const char *DEFAULT_QUEUE = "default";
+
+	// Every device of every platform, with CPU devices split into up to
+	// cpuSubDevices sub-devices with equal compute units
+	static bool GetDevices(std::vector<cl::Device> &devices,
+		cl_uint cpuSubDevices);
+
+	// Context and default queue on the first GPU, or on the given device
+	bool Init();
+	bool Init(const cl::Device &device);
+
+	// Build a program from source and create the named kernels from it
+	bool LoadProgram(const std::string &programName,
+		const std::string &filepath, const std::string &options = "-I cl");
+	bool CreateKernels(const std::string &programName,
+		const std::vector<std::string> &kernelNames);
+
+	// Additional command queue, out-of-order queues execute commands as soon
+	// as the events they wait on are complete
+	bool AddQueue(const std::string &queueName, bool outOfOrder);
+
+	bool AddBuffer(const std::string &bufferKey, cl_mem_flags clMemFlag,
+		size_t size);
+
+	// Version of the host data a buffer holds, 0 until one is set
+	cl_ulong GetBufferVersion(const std::string &bufferKey) const;
+	void SetBufferVersion(const std::string &bufferKey, cl_ulong version);
+
+	bool SetKernelArg(const std::string &kernelName, cl_uint index,
+		const std::string &bufferKey);
+	bool SetKernelArg(const std::string &kernelName, cl_uint index,
+		cl_int value);
+	bool SetKernelArg(const std::string &kernelName, cl_uint index,
+		cl_uint value);
+	bool SetKernelArg(const std::string &kernelName, cl_uint index,
+		cl_float value);
+	bool SetKernelArg(const std::string &kernelName, cl_uint index,
+		const cl_float3 &value);
+
+	// Allocate size bytes of local memory per work-group for a __local
+	// pointer argument
+	bool SetLocalKernelArg(const std::string &kernelName, cl_uint index,
+		size_t size);
+
+	// Commands wait for waitEvents (if any) and signal event (if given) on
+	// completion
+	bool QueueWrite(const std::string &bufferKey, cl_bool blocking,
+		size_t offset, size_t size, const void *data,
+		const std::vector<cl::Event> *waitEvents = nullptr,
+		cl::Event *event = nullptr,
+		const std::string &queueName = DEFAULT_QUEUE);
+	bool QueueRead(const std::string &bufferKey, cl_bool blocking,
+		size_t offset, size_t size, void *data,
+		const std::vector<cl::Event> *waitEvents = nullptr,
+		cl::Event *event = nullptr,
+		const std::string &queueName = DEFAULT_QUEUE);
+	// Read nRows rows of rowSize bytes from the start of a buffer, with rows
+	// bufferRowPitch bytes apart, into host rows hostRowPitch bytes apart
+	bool QueueReadRect(const std::string &bufferKey, cl_bool blocking,
+		size_t rowSize, size_t nRows, size_t bufferRowPitch,
+		size_t hostRowPitch, void *data,
+		const std::vector<cl::Event> *waitEvents = nullptr,
+		cl::Event *event = nullptr,
+		const std::string &queueName = DEFAULT_QUEUE);
+	bool QueueKernel(const std::string &kernelName, const cl::NDRange &offset,
+		const cl::NDRange &global, const cl::NDRange &local = cl::NullRange,
+		const std::vector<cl::Event> *waitEvents = nullptr,
+		cl::Event *event = nullptr,
+		const std::string &queueName = DEFAULT_QUEUE);
+
+	bool Flush(const std::string &queueName = DEFAULT_QUEUE);
+	bool Finish(const std::string &queueName = DEFAULT_QUEUE);
+	bool WaitForEvents(const std::vector<cl::Event> &events);
+
+	cl_uint GetComputeUnits() const;
+	std::string GetDeviceName() const;
+
+	// Work-group limits of a compiled kernel on this device
+	bool GetKernelWorkGroupInfo(const std::string &kernelName,
+		size_t &maxWorkGroupSize, size_t &preferredMultiple);
+
+private:
+	void PrintContextInfo();
+	bool GetBuffer(const std::string &bufferKey, cl::Buffer &buffer);
+	bool GetKernel(const std::string &kernelName, cl::Kernel &kernel);
+	bool GetQueue(const std::string &queueName, cl::CommandQueue &queue);
+
+	cl::Platform m_Platform;
+	cl::Device m_Device;
+	cl::Context m_Context;
+	std::unordered_map<std::string, cl::Program> m_Programs;
+	std::unordered_map<std::string, cl::CommandQueue> m_CommandQueues;
+	std::unordered_map<std::string, cl::Kernel> m_Kernels;
+	std::unordered_map<std::string, cl::Buffer> m_Buffers;
+	std::unordered_map<std::string, cl_ulong> m_BufferVersions;
+};
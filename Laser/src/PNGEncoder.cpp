@@ -0,0 +1,423 @@
+#include "PNGEncoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+// Base values and extra bits of the deflate length and distance codes
+const cl_ushort LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17,
+	19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const cl_uchar LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2,
+	2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const cl_ushort DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49,
+	65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577};
+const cl_uchar DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5,
+	6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+const cl_uint WINDOW_SIZE = 32768;
+const cl_uint MIN_MATCH = 3;
+const cl_uint MAX_MATCH = 258;
+const cl_uint HASH_BITS = 15;
+
+// Smallest band of rows compressed by one task
+const cl_uint MIN_BAND_ROWS = 16;
+
+cl_uint reverseBits(cl_uint code, cl_uint nBits)
+{
+	cl_uint reversed = 0;
+	for (cl_uint i = 0; i < nBits; i++)
+		reversed |= ((code >> i) & 1) << (nBits - 1 - i);
+	return reversed;
+}
+
+// Fixed Huffman codes, bit-reversed as deflate writes codes from their most
+// significant bit into a stream filled from the least, and the code of each
+// match length and distance
+struct DeflateTables
+{
+	DeflateTables() : DistanceSymbols(WINDOW_SIZE + 1)
+	{
+		for (cl_uint i = 0; i < 288; i++)
+		{
+			cl_uint code, nBits;
+			if (i < 144)
+				code = 0x30 + i, nBits = 8;
+			else if (i < 256)
+				code = 0x190 + i - 144, nBits = 9;
+			else if (i < 280)
+				code = i - 256, nBits = 7;
+			else
+				code = 0xC0 + i - 280, nBits = 8;
+			LiteralCodes[i] = reverseBits(code, nBits);
+			LiteralBits[i] = nBits;
+		}
+
+		for (cl_uint i = 0; i < 30; i++)
+			DistanceCodes[i] = reverseBits(i, 5);
+
+		for (cl_uint i = 0; i < 29; i++)
+		{
+			cl_uint end = i + 1 < 29 ? LENGTH_BASE[i + 1] : MAX_MATCH + 1;
+			for (cl_uint length = LENGTH_BASE[i]; length < end; length++)
+				LengthSymbols[length] = i;
+		}
+
+		for (cl_uint i = 0; i < 30; i++)
+		{
+			cl_uint end = i + 1 < 30 ? DISTANCE_BASE[i + 1] : WINDOW_SIZE + 1;
+			for (cl_uint distance = DISTANCE_BASE[i]; distance < end;
+				 distance++)
+				DistanceSymbols[distance] = i;
+		}
+	}
+
+	cl_ushort LiteralCodes[288];
+	cl_uchar LiteralBits[288];
+	cl_uchar DistanceCodes[30];
+	cl_uchar LengthSymbols[MAX_MATCH + 1];
+	std::vector<cl_uchar> DistanceSymbols;
+};
+
+const DeflateTables &getDeflateTables()
+{
+	static const DeflateTables tables;
+	return tables;
+}
+
+// Writes bits least significant first, as deflate packs them into bytes
+class BitWriter
+{
+public:
+	explicit BitWriter(std::vector<cl_uchar> &out)
+		: m_Out(out), m_Bits(0), m_nBits(0)
+	{
+	}
+
+	void Write(cl_uint value, cl_uint nBits)
+	{
+		m_Bits |= (cl_ulong)value << m_nBits;
+		m_nBits += nBits;
+		while (m_nBits >= 8)
+		{
+			m_Out.push_back((cl_uchar)m_Bits);
+			m_Bits >>= 8;
+			m_nBits -= 8;
+		}
+	}
+
+	// Pad with zero bits to the next byte boundary
+	void Align()
+	{
+		if (m_nBits > 0)
+			Write(0, 8 - m_nBits);
+	}
+
+private:
+	std::vector<cl_uchar> &m_Out;
+	cl_ulong m_Bits;
+	cl_uint m_nBits;
+};
+
+cl_uint hashBytes(const cl_uchar *p)
+{
+	cl_uint bytes = p[0] | (p[1] << 8) | (p[2] << 16);
+	return (bytes * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Compress data into a single fixed Huffman block with greedy matching
+// against the last position of each hashed 3 byte sequence. Streams that
+// aren't final end with an empty stored block, which leaves them byte
+// aligned so the next can be appended.
+void deflateFixed(const std::vector<cl_uchar> &data, bool final,
+	std::vector<cl_uchar> &out)
+{
+	const DeflateTables &tables = getDeflateTables();
+	BitWriter writer(out);
+	writer.Write(final ? 1 : 0, 1);
+	writer.Write(1, 2);
+
+	std::vector<cl_int> head(1 << HASH_BITS, -1);
+	size_t n = data.size();
+	size_t i = 0;
+	while (i < n)
+	{
+		size_t matchLength = 0;
+		size_t matchDistance = 0;
+		if (i + MIN_MATCH <= n)
+		{
+			cl_uint hash = hashBytes(&data[i]);
+			cl_int candidate = head[hash];
+			head[hash] = (cl_int)i;
+			if (candidate >= 0 && i - candidate <= WINDOW_SIZE)
+			{
+				size_t maxLength = std::min<size_t>(MAX_MATCH, n - i);
+				size_t length = 0;
+				while (length < maxLength &&
+					data[candidate + length] == data[i + length])
+					length++;
+				if (length >= MIN_MATCH)
+				{
+					matchLength = length;
+					matchDistance = i - candidate;
+				}
+			}
+		}
+
+		if (matchLength == 0)
+		{
+			writer.Write(tables.LiteralCodes[data[i]],
+				tables.LiteralBits[data[i]]);
+			i++;
+			continue;
+		}
+
+		cl_uint lengthSymbol = tables.LengthSymbols[matchLength];
+		writer.Write(tables.LiteralCodes[257 + lengthSymbol],
+			tables.LiteralBits[257 + lengthSymbol]);
+		writer.Write((cl_uint)matchLength - LENGTH_BASE[lengthSymbol],
+			LENGTH_EXTRA[lengthSymbol]);
+
+		cl_uint distanceSymbol = tables.DistanceSymbols[matchDistance];
+		writer.Write(tables.DistanceCodes[distanceSymbol], 5);
+		writer.Write((cl_uint)matchDistance - DISTANCE_BASE[distanceSymbol],
+			DISTANCE_EXTRA[distanceSymbol]);
+
+		// Hash the positions inside the match so later data can refer to them
+		for (size_t j = i + 1; j < i + matchLength && j + MIN_MATCH <= n; j++)
+			head[hashBytes(&data[j])] = (cl_int)j;
+		i += matchLength;
+	}
+
+	// End of block
+	writer.Write(tables.LiteralCodes[256], tables.LiteralBits[256]);
+
+	if (!final)
+	{
+		writer.Write(0, 3);
+		writer.Align();
+		out.insert(out.end(), {0x00, 0x00, 0xFF, 0xFF});
+	}
+	else
+		writer.Align();
+}
+
+cl_uint calcAdler32(const cl_uchar *data, size_t size)
+{
+	const cl_uint BASE = 65521;
+	cl_uint a = 1;
+	cl_uint b = 0;
+
+	// Sums can't overflow within 5552 bytes, so reduce once per run
+	while (size > 0)
+	{
+		size_t run = std::min<size_t>(size, 5552);
+		for (size_t i = 0; i < run; i++)
+		{
+			a += data[i];
+			b += a;
+		}
+		a %= BASE;
+		b %= BASE;
+		data += run;
+		size -= run;
+	}
+	return (b << 16) | a;
+}
+
+// Adler-32 of two concatenated streams from the checksum of each
+cl_uint combineAdler32(cl_uint adler1, cl_uint adler2, size_t size2)
+{
+	const cl_uint BASE = 65521;
+	cl_uint remainder = (cl_uint)(size2 % BASE);
+	cl_uint a1 = adler1 & 0xFFFF;
+	cl_uint b1 = adler1 >> 16;
+	cl_uint a2 = adler2 & 0xFFFF;
+	cl_uint b2 = adler2 >> 16;
+
+	cl_uint a = (a1 + a2 + BASE - 1) % BASE;
+	cl_ulong b = (cl_ulong)remainder * a1 + b1 + b2 + BASE - remainder;
+	return (cl_uint)(b % BASE) << 16 | a;
+}
+
+cl_uint calcCRC32(const cl_uchar *data, size_t size)
+{
+	static const std::vector<cl_uint> table = []
+	{
+		std::vector<cl_uint> table(256);
+		for (cl_uint i = 0; i < 256; i++)
+		{
+			cl_uint c = i;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+		return table;
+	}();
+
+	cl_uint crc = ~0u;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+void appendUint32(std::vector<cl_uchar> &out, cl_uint value)
+{
+	out.insert(out.end(), {(cl_uchar)(value >> 24), (cl_uchar)(value >> 16),
+							  (cl_uchar)(value >> 8), (cl_uchar)value});
+}
+
+void appendChunk(std::vector<cl_uchar> &png, const char *type,
+	const cl_uchar *data, size_t size)
+{
+	appendUint32(png, (cl_uint)size);
+	size_t start = png.size();
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), data, data + size);
+	appendUint32(png, calcCRC32(&png[start], size + 4));
+}
+
+cl_uchar paethPredictor(cl_int a, cl_int b, cl_int c)
+{
+	cl_int p = a + b - c;
+	cl_int pa = std::abs(p - a);
+	cl_int pb = std::abs(p - b);
+	cl_int pc = std::abs(p - c);
+	if (pa <= pb && pa <= pc)
+		return (cl_uchar)a;
+	return (cl_uchar)(pb <= pc ? b : c);
+}
+
+// Write the filter type and filtered bytes of a row of 3 byte pixels, choosing
+// the filter with the smallest sum of absolute differences. The first row has
+// a row of zeros above it.
+void filterRow(const cl_uchar *row, const cl_uchar *previous, size_t rowSize,
+	cl_uchar *out, std::vector<cl_uchar> &scratch)
+{
+	scratch.resize(6 * rowSize);
+	cl_uchar *zeros = &scratch[5 * rowSize];
+	if (!previous)
+	{
+		std::memset(zeros, 0, rowSize);
+		previous = zeros;
+	}
+
+	// None, Sub, Up, Average and Paeth, each in its own loop
+	cl_uchar *filtered[5];
+	for (cl_uint filter = 0; filter < 5; filter++)
+		filtered[filter] = &scratch[filter * rowSize];
+
+	std::memcpy(filtered[0], row, rowSize);
+	for (size_t i = 0; i < rowSize; i++)
+	{
+		cl_uchar left = i >= 3 ? row[i - 3] : 0;
+		filtered[1][i] = (cl_uchar)(row[i] - left);
+		filtered[2][i] = (cl_uchar)(row[i] - previous[i]);
+		filtered[3][i] = (cl_uchar)(row[i] - (left + previous[i]) / 2);
+	}
+	for (size_t i = 0; i < rowSize; i++)
+	{
+		cl_int left = i >= 3 ? row[i - 3] : 0;
+		cl_int upLeft = i >= 3 ? previous[i - 3] : 0;
+		filtered[4][i] =
+			(cl_uchar)(row[i] - paethPredictor(left, previous[i], upLeft));
+	}
+
+	cl_ulong bestSum = ~0ull;
+	cl_uint bestFilter = 0;
+	for (cl_uint filter = 0; filter < 5; filter++)
+	{
+		cl_ulong sum = 0;
+		for (size_t i = 0; i < rowSize; i++)
+			sum += std::abs((cl_int)(cl_char)filtered[filter][i]);
+		if (sum < bestSum)
+		{
+			bestSum = sum;
+			bestFilter = filter;
+		}
+	}
+
+	out[0] = (cl_uchar)bestFilter;
+	std::memcpy(out + 1, filtered[bestFilter], rowSize);
+}
+} // namespace
+
+PNGEncoder::PNGEncoder(cl_uint nThreads)
+	: m_Pool(std::make_unique<ThreadPool>(nThreads))
+{
+}
+
+void PNGEncoder::Encode(const std::vector<cl_uchar> &rgb, cl_uint width,
+	cl_uint height, std::vector<cl_uchar> &png, cl_uint xOffset,
+	cl_uint yOffset)
+{
+	// A few bands per thread balance rows that compress at different speeds
+	cl_uint nBands = std::max(1u,
+		std::min(height / MIN_BAND_ROWS, m_Pool->GetThreadCount() * 4));
+	std::vector<Band> bands(nBands);
+	for (cl_uint i = 0; i < nBands; i++)
+	{
+		bands[i].FirstRow = height * i / nBands;
+		bands[i].nRows = height * (i + 1) / nBands - bands[i].FirstRow;
+		m_Pool->Submit([&, i]
+			{ EncodeBand(rgb, width, bands[i], i + 1 == nBands); });
+	}
+	m_Pool->Wait();
+
+	// zlib stream of the bands' deflate blocks, with the Adler-32 of all
+	// filtered rows
+	size_t filteredRowSize = 1 + 3 * (size_t)width;
+	std::vector<cl_uchar> stream = {0x78, 0x01};
+	cl_uint adler = 1;
+	for (const Band &band : bands)
+	{
+		stream.insert(stream.end(), band.Deflated.begin(),
+			band.Deflated.end());
+		adler = combineAdler32(adler, band.Adler, band.nRows * filteredRowSize);
+	}
+	appendUint32(stream, adler);
+
+	png.clear();
+	png.reserve(stream.size() + 64);
+	png.insert(png.end(), {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'});
+
+	// 8 bits per channel RGB, default compression and filtering, no interlace
+	std::vector<cl_uchar> header;
+	appendUint32(header, width);
+	appendUint32(header, height);
+	header.insert(header.end(), {8, 2, 0, 0, 0});
+	appendChunk(png, "IHDR", header.data(), header.size());
+
+	// Position in pixels, which must precede the image data
+	if (xOffset != 0 || yOffset != 0)
+	{
+		std::vector<cl_uchar> offset;
+		appendUint32(offset, xOffset);
+		appendUint32(offset, yOffset);
+		offset.push_back(0);
+		appendChunk(png, "oFFs", offset.data(), offset.size());
+	}
+	appendChunk(png, "IDAT", stream.data(), stream.size());
+	appendChunk(png, "IEND", nullptr, 0);
+}
+
+void PNGEncoder::EncodeBand(const std::vector<cl_uchar> &rgb, cl_uint width,
+	Band &band, bool final)
+{
+	size_t rowSize = 3 * (size_t)width;
+	std::vector<cl_uchar> filtered(band.nRows * (rowSize + 1));
+	std::vector<cl_uchar> scratch;
+	for (cl_uint j = 0; j < band.nRows; j++)
+	{
+		size_t y = band.FirstRow + j;
+		const cl_uchar *previous = y > 0 ? &rgb[(y - 1) * rowSize] : nullptr;
+		filterRow(&rgb[y * rowSize], previous, rowSize,
+			&filtered[j * (rowSize + 1)], scratch);
+	}
+
+	band.Adler = calcAdler32(filtered.data(), filtered.size());
+	band.Deflated.reserve(filtered.size() / 2);
+	deflateFixed(filtered, final, band.Deflated);
+}
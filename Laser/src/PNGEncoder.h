@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <CL/cl.hpp>
+
+#include "ThreadPool.h"
+
+// Encodes 8-bit RGB images as PNG. Bands of rows are filtered and deflated on
+// a thread pool, each into deflate blocks ending on a byte boundary, so the
+// bands' output is concatenated into a single zlib stream. Compression uses
+// greedy LZ77 matching and the fixed Huffman codes, trading some file size for
+// speed.
+class PNGEncoder
+{
+public:
+	explicit PNGEncoder(cl_uint nThreads);
+
+	// rgb holds height rows of width pixels of 3 bytes each. A nonzero offset
+	// of a crop in its full image is recorded in an oFFs chunk.
+	void Encode(const std::vector<cl_uchar> &rgb, cl_uint width,
+		cl_uint height, std::vector<cl_uchar> &png, cl_uint xOffset = 0,
+		cl_uint yOffset = 0);
+
+private:
+	struct Band
+	{
+		cl_uint FirstRow;
+		cl_uint nRows;
+		std::vector<cl_uchar> Deflated;
+		cl_uint Adler;
+	};
+
+	void EncodeBand(const std::vector<cl_uchar> &rgb, cl_uint width,
+		Band &band, bool final);
+
+	std::unique_ptr<ThreadPool> m_Pool;
+};
@@ -0,0 +1,90 @@
+#include "RenderJob.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+// Sampler types of cl/Sampler.cl
+const cl_uint SAMPLER_TYPES = 3;
+} // namespace
+
+bool RenderJob::Load(const std::string &filepath)
+{
+	std::ifstream file(filepath);
+	if (!file.good())
+	{
+		std::cout << "Failed to open file " << filepath << "." << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream fields(line);
+		std::string key;
+		fields >> key;
+		if (key == "output")
+			fields >> Output;
+		else if (key == "samples")
+		{
+			// A job without samples would output the last job's image
+			fields >> Samples;
+			if (Samples == 0)
+				fields.setstate(std::ios::failbit);
+		}
+		else if (key == "sampler")
+		{
+			fields >> Sampler;
+			if (Sampler >= SAMPLER_TYPES)
+				fields.setstate(std::ios::failbit);
+		}
+		else if (key == "position")
+			fields >> Position.x >> Position.y >> Position.z;
+		else if (key == "target")
+			fields >> Target.x >> Target.y >> Target.z;
+		else if (key == "fov")
+			fields >> VerticalFOV;
+		else if (key == "aperture")
+			fields >> Aperture;
+		else if (key == "albedo" || key == "emission")
+		{
+			size_t index = 0;
+			cl_float3 color = {};
+			fields >> index >> color.x >> color.y >> color.z;
+			if (index >= Materials.size())
+				fields.setstate(std::ios::failbit);
+			else if (key == "albedo")
+				Materials[index].Albedo = color;
+			else
+				Materials[index].Emission = color;
+		}
+		else if (key == "transform")
+		{
+			size_t index = 0;
+			glm::mat4 transform;
+			fields >> index;
+			for (int i = 0; i < 16; i++)
+				fields >> transform[i / 4][i % 4];
+			if (index >= Transforms.size())
+				fields.setstate(std::ios::failbit);
+			else
+				Transforms[index] = transform;
+		}
+		else
+			fields.setstate(std::ios::failbit);
+
+		if (!fields)
+		{
+			std::cout << "Invalid line in job " << filepath << ": " << line
+					  << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
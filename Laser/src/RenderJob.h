@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <CL/cl.hpp>
+#include <glm/glm.hpp>
+
+#include "Material.h"
+
+// Settings of a job for the render server, read from a text file of
+// "key value" lines:
+//   output <file>
+//   samples <samples per pixel, at least 1>
+//   sampler <sampler type, 0 to 2>
+//   position <x> <y> <z>
+//   target <x> <y> <z>
+//   fov <vertical field of view in degrees>
+//   aperture <lens aperture>
+//   albedo <material> <r> <g> <b>
+//   emission <material> <r> <g> <b>
+//   transform <transform> <16 matrix elements, column by column>
+// Keys missing from the file keep the values the settings had.
+struct RenderJob
+{
+	std::string Output;
+	cl_uint Samples;
+	cl_uint Sampler;
+	cl_float3 Position;
+	cl_float3 Target;
+	cl_float VerticalFOV;
+	cl_float Aperture;
+	std::vector<Material> Materials;
+	std::vector<glm::mat4> Transforms;
+
+	bool Load(const std::string &filepath);
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <CL/cl.hpp>
+
+// Reservoir of resampled direct lighting, only read and written on the device
+struct Reservoir
+{
+	cl_float3 LightPoint;
+	cl_float3 LightNormal;
+	cl_uint LightIndex;
+	cl_float WeightSum;
+	cl_float M;
+	cl_float W;
+};
+
+// Primary hit of a pixel used for reservoir reuse
+struct ReservoirSurface
+{
+	cl_float3 P;
+	cl_float3 N;
+	cl_uint Material;
+	cl_float Depth;
+	cl_uint IsValid;
+	cl_uint dummy;
+};
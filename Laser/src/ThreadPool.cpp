@@ -0,0 +1,110 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(cl_uint nThreads)
+	: m_NextWorker(0), m_nQueued(0), m_nPending(0), m_Stop(false)
+{
+	if (nThreads == 0)
+		nThreads = 1;
+
+	for (cl_uint i = 0; i < nThreads; i++)
+		m_Workers.push_back(std::make_unique<Worker>());
+	for (cl_uint i = 0; i < nThreads; i++)
+		m_Threads.emplace_back(&ThreadPool::Run, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_WorkAvailable.notify_all();
+	for (std::thread &thread : m_Threads)
+		thread.join();
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	// Count the task before it can be taken, so it can't finish first
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_nQueued++;
+		m_nPending++;
+	}
+
+	cl_uint worker = m_NextWorker++ % m_Workers.size();
+	{
+		std::lock_guard<std::mutex> lock(m_Workers[worker]->Mutex);
+		m_Workers[worker]->Tasks.push_back(std::move(task));
+	}
+	m_WorkAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Idle.wait(lock, [this]() { return m_nPending == 0; });
+}
+
+cl_uint ThreadPool::GetThreadCount() const
+{
+	return (cl_uint)m_Threads.size();
+}
+
+bool ThreadPool::PopTask(cl_uint worker, std::function<void()> &task)
+{
+	// Own deque first, oldest task first
+	{
+		Worker &own = *m_Workers[worker];
+		std::lock_guard<std::mutex> lock(own.Mutex);
+		if (!own.Tasks.empty())
+		{
+			task = std::move(own.Tasks.front());
+			own.Tasks.pop_front();
+			return true;
+		}
+	}
+
+	// Steal the newest task of another worker
+	for (cl_uint i = 1; i < m_Workers.size(); i++)
+	{
+		Worker &victim = *m_Workers[(worker + i) % m_Workers.size()];
+		std::lock_guard<std::mutex> lock(victim.Mutex);
+		if (!victim.Tasks.empty())
+		{
+			task = std::move(victim.Tasks.back());
+			victim.Tasks.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::Run(cl_uint worker)
+{
+	while (true)
+	{
+		std::function<void()> task;
+		if (PopTask(worker, task))
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_nQueued--;
+			}
+			task();
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (--m_nPending == 0)
+				m_Idle.notify_all();
+			continue;
+		}
+
+		// Sleep until a task is submitted
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_WorkAvailable.wait(lock,
+			[this]() { return m_Stop || m_nQueued > 0; });
+		if (m_Stop)
+			return;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <CL/cl.hpp>
+
+// Fixed set of worker threads, each with its own task deque. Workers take
+// tasks from the front of their own deque and steal from the back of others'
+// when it is empty, so uneven tasks are balanced without a shared queue.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(cl_uint nThreads);
+	~ThreadPool();
+
+	// Tasks are distributed round-robin between the workers' deques
+	void Submit(std::function<void()> task);
+
+	// Wait until all submitted tasks have finished
+	void Wait();
+
+	cl_uint GetThreadCount() const;
+
+private:
+	struct Worker
+	{
+		std::deque<std::function<void()>> Tasks;
+		std::mutex Mutex;
+	};
+
+	bool PopTask(cl_uint worker, std::function<void()> &task);
+	void Run(cl_uint worker);
+
+	std::vector<std::unique_ptr<Worker>> m_Workers;
+	std::vector<std::thread> m_Threads;
+	std::atomic<cl_uint> m_NextWorker;
+	cl_uint m_nQueued;	// Tasks not yet taken by a worker
+	cl_uint m_nPending; // Tasks not yet finished
+	bool m_Stop;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkAvailable;
+	std::condition_variable m_Idle;
+};
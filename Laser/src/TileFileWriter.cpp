@@ -0,0 +1,179 @@
+#include "TileFileWriter.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+TileFileWriter::TileFileWriter()
+	: m_Format(Image::Format::ppm), m_Width(0), m_Height(0), m_HeaderSize(0),
+	  m_PixelSize(0)
+{
+}
+
+bool TileFileWriter::Open(const std::string &filepath, Image::Format format,
+	cl_uint width, cl_uint height, bool existing)
+{
+	std::string header;
+	switch (format)
+	{
+	case Image::Format::ppm:
+		header = "P6\n" + std::to_string(width) + " " +
+			std::to_string(height) + "\n255\n";
+		m_PixelSize = 3;
+		break;
+	case Image::Format::pfm:
+		header = "PF\n" + std::to_string(width) + " " +
+			std::to_string(height) + "\n-1.0\n";
+		m_PixelSize = 3 * sizeof(cl_float);
+		break;
+	default:
+		std::cout << "Tiles can only be written into PPM or PFM files, as "
+					 "compressed formats don't have fixed offsets."
+				  << std::endl;
+		return false;
+	}
+
+	m_Filepath = filepath;
+	m_Format = format;
+	m_Width = width;
+	m_Height = height;
+	m_HeaderSize = header.size();
+	size_t fileSize = m_HeaderSize + (size_t)width * height * m_PixelSize;
+
+	if (existing)
+		return OpenExisting(header, fileSize);
+
+	// Write header and extend file to its full size so tiles can be written
+	// anywhere in it
+	m_File.open(filepath, std::ios::in | std::ios::out | std::ios::binary |
+			std::ios::trunc);
+	if (!m_File)
+	{
+		std::cout << "Failed to open file " << filepath << "." << std::endl;
+		return false;
+	}
+	m_File.write(header.data(), header.size());
+	m_File.seekp((std::streamoff)fileSize - 1);
+	m_File.put(0);
+	if (!m_File)
+	{
+		std::cout << "Failed to write file " << filepath << "." << std::endl;
+		return false;
+	}
+
+	std::cout << "Streaming tiles to file \"" << filepath << "\"..."
+			  << std::endl;
+	return true;
+}
+
+bool TileFileWriter::OpenExisting(const std::string &header, size_t fileSize)
+{
+	// Create the file if missing without truncating it, as other jobs may be
+	// writing into it
+	std::ofstream(m_Filepath, std::ios::binary | std::ios::app).close();
+	m_File.open(m_Filepath, std::ios::in | std::ios::out | std::ios::binary);
+	if (!m_File)
+	{
+		std::cout << "Failed to open file " << m_Filepath << "." << std::endl;
+		return false;
+	}
+
+	// A file that isn't new must have the same header and at most the full
+	// size, as another job may still be growing it
+	std::error_code error;
+	uintmax_t size = std::filesystem::file_size(m_Filepath, error);
+	std::string existingHeader(header.size(), '\0');
+	m_File.read(&existingHeader[0], existingHeader.size());
+	m_File.clear();
+	bool isNew = existingHeader.find_first_not_of('\0') == std::string::npos;
+	if (error || size > fileSize || (!isNew && existingHeader != header))
+	{
+		std::cout << "File " << m_Filepath << " isn't a " << m_Width << "x"
+				  << m_Height << " image to write tiles into." << std::endl;
+		return false;
+	}
+
+	// Growing the file only appends zeros, never overwriting tiles already
+	// written
+	if (size < fileSize)
+	{
+		std::filesystem::resize_file(m_Filepath, fileSize, error);
+		if (error)
+		{
+			std::cout << "Failed to resize file " << m_Filepath << "."
+					  << std::endl;
+			return false;
+		}
+	}
+	if (isNew)
+	{
+		m_File.seekp(0);
+		m_File.write(header.data(), header.size());
+	}
+	if (!m_File)
+	{
+		std::cout << "Failed to write file " << m_Filepath << "." << std::endl;
+		return false;
+	}
+
+	std::cout << "Writing tiles into file \"" << m_Filepath << "\"..."
+			  << std::endl;
+	return true;
+}
+
+bool TileFileWriter::WriteTile(const cl_float3 *tile, cl_uint rowPitch,
+	cl_uint xOffset, cl_uint yOffset, cl_uint width, cl_uint height)
+{
+	m_Row.resize(width * m_PixelSize);
+	for (cl_uint j = 0; j < height; j++)
+	{
+		const cl_float3 *pixels = &tile[j * rowPitch];
+		cl_uint y = yOffset + j;
+
+		// PPM clamps and truncates like Image::WriteToFile, PFM stores rows
+		// bottom to top
+		size_t row = y;
+		if (m_Format == Image::Format::ppm)
+		{
+			for (cl_uint i = 0; i < width; i++)
+			{
+				m_Row[3 * i] = (cl_uchar)(clamp(pixels[i].x) * 255);
+				m_Row[3 * i + 1] = (cl_uchar)(clamp(pixels[i].y) * 255);
+				m_Row[3 * i + 2] = (cl_uchar)(clamp(pixels[i].z) * 255);
+			}
+		}
+		else
+		{
+			row = m_Height - 1 - y;
+			for (cl_uint i = 0; i < width; i++)
+			{
+				cl_float rgb[3] = {pixels[i].x, pixels[i].y, pixels[i].z};
+				std::memcpy(&m_Row[i * m_PixelSize], rgb, m_PixelSize);
+			}
+		}
+
+		size_t offset = m_HeaderSize + (row * m_Width + xOffset) * m_PixelSize;
+		m_File.seekp((std::streamoff)offset);
+		m_File.write((const char *)m_Row.data(), m_Row.size());
+	}
+
+	if (!m_File)
+	{
+		std::cout << "Failed to write tile to file " << m_Filepath << "."
+				  << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool TileFileWriter::Close()
+{
+	m_File.close();
+	if (m_File.fail())
+	{
+		std::cout << "Failed to close file " << m_Filepath << "." << std::endl;
+		return false;
+	}
+	std::cout << "Finished writing to file." << std::endl;
+	return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <CL/cl.hpp>
+
+#include "Image.h"
+
+// Writes tiles straight into a binary PPM or PFM file as they complete, so a
+// render only holds the tiles in flight in memory whatever its resolution.
+// Rows of both formats are at fixed offsets after the header, so each row of
+// a tile is one write at its place in the file. Writing into an existing file
+// lets separate jobs fill in the tiles of one image.
+class TileFileWriter
+{
+public:
+	TileFileWriter();
+
+	// Create the file at its full size, or keep the pixels of an existing
+	// file of the same format and size
+	bool Open(const std::string &filepath, Image::Format format,
+		cl_uint width, cl_uint height, bool existing = false);
+
+	// Write width by height pixels at an offset in the image, from rows that
+	// are rowPitch pixels apart, as in a tile read back from an output buffer
+	bool WriteTile(const cl_float3 *tile, cl_uint rowPitch, cl_uint xOffset,
+		cl_uint yOffset, cl_uint width, cl_uint height);
+
+	bool Close();
+
+private:
+	bool OpenExisting(const std::string &header, size_t fileSize);
+
+	inline cl_float clamp(cl_float x) const
+	{
+		return x < 0.0f ? 0.0f : x > 1.0f ? 1.0f : x;
+	}
+
+	std::fstream m_File;
+	std::string m_Filepath;
+	Image::Format m_Format;
+	cl_uint m_Width;
+	cl_uint m_Height;
+	size_t m_HeaderSize;
+	size_t m_PixelSize; // Bytes per pixel in the file
+	std::vector<cl_uchar> m_Row;
+};
@@ -0,0 +1,103 @@
+#include "TuningCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+// First line of the file, bumped whenever entries written by earlier versions
+// can no longer be trusted; v1 sweeps timed renders that never ran
+static const std::string HEADER = "# Laser tuning cache v2";
+
+bool TuningCache::Load(const std::string &filepath)
+{
+	m_Entries.clear();
+
+	std::ifstream file(filepath);
+	if (!file.good())
+		return true;
+
+	// Outdated caches are discarded, so the next run calibrates again
+	std::string line;
+	if (!std::getline(file, line) || line != HEADER)
+	{
+		std::cout << "Discarding outdated tuning cache " << filepath << "."
+				  << std::endl;
+		return true;
+	}
+
+	// Device names contain spaces, so fields are separated by tabs
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream fields(line);
+		Entry entry;
+		std::string localWorkSize, tileWidth, tileHeight;
+		if (!std::getline(fields, entry.Device, '\t') ||
+			!std::getline(fields, entry.Kernel, '\t') ||
+			!std::getline(fields, localWorkSize, '\t') ||
+			!std::getline(fields, tileWidth, '\t') ||
+			!std::getline(fields, tileHeight, '\t'))
+		{
+			std::cout << "Invalid line in tuning cache " << filepath << ": "
+					  << line << std::endl;
+			return false;
+		}
+		entry.LocalWorkSize = std::stoul(localWorkSize);
+		entry.TileWidth = std::stoul(tileWidth);
+		entry.TileHeight = std::stoul(tileHeight);
+		m_Entries.push_back(entry);
+	}
+
+	return true;
+}
+
+bool TuningCache::Save(const std::string &filepath) const
+{
+	std::ofstream file(filepath);
+	if (!file.good())
+	{
+		std::cout << "Failed to open file " << filepath << "." << std::endl;
+		return false;
+	}
+
+	file << HEADER << std::endl;
+	file << "# device\tkernel\tlocal work size\ttile width\ttile height"
+		 << std::endl;
+	for (const Entry &entry : m_Entries)
+	{
+		file << entry.Device << '\t' << entry.Kernel << '\t'
+			 << entry.LocalWorkSize << '\t' << entry.TileWidth << '\t'
+			 << entry.TileHeight << std::endl;
+	}
+
+	return true;
+}
+
+bool TuningCache::Find(const std::string &device, const std::string &kernel,
+	Entry &entry) const
+{
+	for (const Entry &e : m_Entries)
+	{
+		if (e.Device == device && e.Kernel == kernel)
+		{
+			entry = e;
+			return true;
+		}
+	}
+	return false;
+}
+
+void TuningCache::Store(const Entry &entry)
+{
+	for (Entry &e : m_Entries)
+	{
+		if (e.Device == entry.Device && e.Kernel == entry.Kernel)
+		{
+			e = entry;
+			return;
+		}
+	}
+	m_Entries.push_back(entry);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <CL/cl.hpp>
+
+// Launch configurations chosen by auto-tuning, stored per device and kernel
+// in a tab-separated text file so later runs can skip the calibration sweep
+class TuningCache
+{
+public:
+	struct Entry
+	{
+		std::string Device;
+		std::string Kernel;
+		cl_uint LocalWorkSize;
+		cl_uint TileWidth;
+		cl_uint TileHeight;
+	};
+
+	// A missing file is an empty cache
+	bool Load(const std::string &filepath);
+	bool Save(const std::string &filepath) const;
+
+	bool Find(const std::string &device, const std::string &kernel,
+		Entry &entry) const;
+	void Store(const Entry &entry);
+
+private:
+	std::vector<Entry> m_Entries;
+};
@@ -1,3 +1,3 @@
-#pragma once
-
-#define PI 3.14159265359f
+#pragma once
+
+#define PI 3.14159265359f
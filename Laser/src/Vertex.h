@@ -1,9 +1,9 @@
-#pragma once
-
-#include <CL/cl.hpp>
-
-struct Vertex
-{
-	cl_float3 Position;
-	cl_float3 Normal;
-};
+#pragma once
+
+#include <CL/cl.hpp>
+
+struct Vertex
+{
+	cl_float3 Position;
+	cl_float3 Normal;
+};
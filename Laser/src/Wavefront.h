@@ -0,0 +1,38 @@
+#pragma once
+
+#include <CL/cl.hpp>
+
+// State of a path between wavefront kernels, only read and written on the
+// device
+struct PathState
+{
+	cl_float3 RayOrigin;
+	cl_float3 RayDirection;
+	cl_float3 Throughput;
+	cl_float3 Radiance;
+	cl_float3 PrevP;
+	cl_float3 PrevN;
+	cl_float3 IsectP;
+	cl_float3 IsectN;
+	cl_float IsectU;
+	cl_float IsectV;
+	cl_uint IsectTriangleIndex;
+	cl_uint dummy;
+	cl_float T;
+	cl_float BsdfPdf;
+	cl_uint Depth;
+	cl_uint SpecularBounce;
+};
+
+// Bounces of a path, MAX_DEPTH in cl/Laser.cl
+const cl_uint WAVEFRONT_MAX_DEPTH = 16;
+
+// Counters of the "queueCounts" buffer
+enum WavefrontQueue
+{
+	QUEUE_RAYS = 0,
+	QUEUE_DIFFUSE = 1,
+	QUEUE_SPECULAR = 2,
+	QUEUE_NEXT_RAYS = 3,
+	QUEUE_COUNT = 4
+};